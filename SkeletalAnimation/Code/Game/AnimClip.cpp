@@ -0,0 +1,666 @@
+#include "AnimClip.hpp"
+
+#include "AnimUtils.hpp"
+#include "BlockCompression.hpp"
+#include "BoneNames.hpp"
+#include "ClipStream.hpp"
+#include "CookedAsset.hpp"
+
+#include "Engine/Animation/Animation.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include "ThirdParty/assimp/Importer.hpp"
+#include "ThirdParty/assimp/config.h"
+#include "ThirdParty/assimp/scene.h"
+#include "ThirdParty/assimp/postprocess.h"
+
+#include <algorithm>
+#include <math.h>
+#include <unordered_map>
+
+constexpr int CLIP_IMPORT_REMOVED_COMPONENTS = aiComponent_MESHES | aiComponent_MATERIALS | aiComponent_TEXTURES | aiComponent_LIGHTS | aiComponent_CAMERAS;
+constexpr float CLIP_IMPORT_BIND_EPSILON = 1e-3f; // relative, node transforms against the skeleton's bind pose
+
+constexpr uint32_t SECTION_CLIP = MakeSectionId('C', 'L', 'I', 'P');
+constexpr uint32_t SECTION_CNAM = MakeSectionId('C', 'N', 'A', 'M');
+constexpr uint32_t SECTION_CKEY = MakeSectionId('C', 'K', 'E', 'Y');
+constexpr uint32_t CLIP_SECTION_VERSION = 2; // 2: keys at the source's rate instead of resampled to 60 fps
+
+struct CookedClipHeader
+{
+public:
+	float   m_tps         = 0.0f;
+	float   m_duration    = 0.0f;
+	int32_t m_frameCount  = 0;
+	int32_t m_boneCount   = 0;
+	int32_t m_blockFrames = CLIP_BLOCK_FRAMES;
+	int32_t m_reserved    = 0;
+};
+
+void AnimClip::BakeFrom(const Animation& animation, const Skeleton& skeleton, float tps)
+{
+	m_name = animation.m_name;
+	m_tps = tps;
+	m_duration = animation.GetDuration();
+	m_frameCount = (int)floorf(m_duration * m_tps) + 1;
+	m_boneCount = (int)skeleton.size();
+	m_attachedKeys = nullptr;
+	m_keys.resize((size_t)m_boneCount * m_frameCount);
+	m_source.reset();
+
+	Pose pose = skeleton.GetPose();
+	for (int frameIdx = 0; frameIdx < m_frameCount; frameIdx++)
+	{
+		pose = skeleton.GetPose();
+		AnimationFrame frame = animation.Sample((float)frameIdx / m_tps, pose);
+		frame.Apply(pose);
+
+		for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+			m_keys[GetKeyIndex((BoneId)boneIdx, frameIdx)] = pose.m_boneLocalPose[boneIdx];
+	}
+}
+
+struct ClipImportNode
+{
+public:
+	BoneNameHash  m_parentHash = 0;
+	const aiNode* m_node       = nullptr;
+};
+
+// node name hash to node and parent name hash for the whole hierarchy, one walk instead of a tree search per bone
+void CollectNodes(const aiNode* node, BoneNameHash parentHash, std::unordered_map<BoneNameHash, ClipImportNode>& outNodes)
+{
+	BoneNameHash hash = HashBoneName(node->mName.C_Str(), node->mName.length);
+	outNodes.emplace(hash, ClipImportNode{ parentHash, node });
+	for (unsigned int childIdx = 0; childIdx < node->mNumChildren; childIdx++)
+		CollectNodes(node->mChildren[childIdx], hash, outNodes);
+}
+
+bool IsMatchingVector(const aiVector3D& value, const Vec3& expected)
+{
+	Vec3 delta = Vec3(value.x, value.y, value.z) - expected;
+	return delta.GetLength() <= CLIP_IMPORT_BIND_EPSILON * std::max(expected.GetLength(), 1.0f);
+}
+
+// the skeleton went through AssimpRes and its space conventions, the clip reads assimp's nodes as they are,
+// so the node transforms must reproduce the bind pose or the two paths would disagree on the clip's space
+bool IsMatchingBind(const aiNode& node, const TransformQuat& bind)
+{
+	aiVector3D scale;
+	aiQuaternion rotation;
+	aiVector3D position;
+	node.mTransformation.Decompose(scale, rotation, position);
+
+	float dot = rotation.x * bind.m_rotation.x + rotation.y * bind.m_rotation.y + rotation.z * bind.m_rotation.z + rotation.w * bind.m_rotation.w;
+	return IsMatchingVector(position, bind.m_position) && IsMatchingVector(scale, bind.m_scale) && fabsf(dot) >= 1.0f - CLIP_IMPORT_BIND_EPSILON;
+}
+
+const char* FindSkeletonMismatch(const aiScene& scene, const Skeleton& skeleton, const BoneLookup& lookup)
+{
+	if (!scene.mRootNode)
+		return "no node hierarchy";
+
+	std::unordered_map<BoneNameHash, ClipImportNode> nodes;
+	CollectNodes(scene.mRootNode, 0, nodes);
+
+	Pose bindPose = skeleton.GetPose();
+	for (auto& bone : skeleton)
+	{
+		auto node = nodes.find(lookup.GetHash(bone.m_id));
+		if (node == nodes.end())
+			return "a bone is missing";
+
+		if (bone.m_parentId != INVALID_BONE_ID && node->second.m_parentHash != lookup.GetHash(bone.m_parentId))
+			return "a bone has another parent";
+
+		if (!IsMatchingBind(*node->second.m_node, bindPose.m_boneLocalPose[bone.m_id]))
+			return "a node transform differs from the bind pose";
+	}
+	return nullptr;
+}
+
+// index of the last key at or before time, keys are sorted by time
+// the search starts at the cursor and leaves it there, so a channel sampled at rising times is walked once
+template<typename KeyType>
+unsigned int FindKeyIndex(const KeyType* keys, unsigned int keyCount, double time, unsigned int& cursor)
+{
+	if (cursor >= keyCount || keys[cursor].mTime > time)
+		cursor = 0;
+	while (cursor + 1 < keyCount && keys[cursor + 1].mTime <= time)
+		cursor++;
+	return cursor;
+}
+
+Vec3 SampleVectorKeys(const aiVectorKey* keys, unsigned int keyCount, double time, const Vec3& fallback, unsigned int& cursor)
+{
+	if (keyCount == 0)
+		return fallback;
+
+	unsigned int index = FindKeyIndex(keys, keyCount, time, cursor);
+	const aiVectorKey& key0 = keys[index];
+	const aiVectorKey& key1 = keys[index + 1 < keyCount ? index + 1 : index];
+	double span = key1.mTime - key0.mTime;
+	float alpha = span > 0.0 ? (float)((time - key0.mTime) / span) : 0.0f;
+	alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+	aiVector3D value = key0.mValue + (key1.mValue - key0.mValue) * alpha;
+	return Vec3(value.x, value.y, value.z);
+}
+
+Quaternion SampleQuatKeys(const aiQuatKey* keys, unsigned int keyCount, double time, const Quaternion& fallback, unsigned int& cursor)
+{
+	if (keyCount == 0)
+		return fallback;
+
+	unsigned int index = FindKeyIndex(keys, keyCount, time, cursor);
+	const aiQuatKey& key0 = keys[index];
+	const aiQuatKey& key1 = keys[index + 1 < keyCount ? index + 1 : index];
+	double span = key1.mTime - key0.mTime;
+	float alpha = span > 0.0 ? (float)((time - key0.mTime) / span) : 0.0f;
+	alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+	aiQuaternion value;
+	aiQuaternion::Interpolate(value, key0.mValue, key1.mValue, alpha);
+
+	Quaternion result;
+	result.x = value.x;
+	result.y = value.y;
+	result.z = value.z;
+	result.w = value.w;
+	return result;
+}
+
+// keys per second of the densest channel of a skeleton bone, rounded to whole frames per second
+// channels of nodes outside the skeleton are dropped on import, so they do not count
+float FindSourceKeyRate(const aiAnimation& aiAnim, const BoneLookup& lookup)
+{
+	double maxRate = 0.0;
+	auto addKeys = [&maxRate, &aiAnim](double firstTime, double lastTime, unsigned int keyCount)
+	{
+		double span = (lastTime - firstTime) / aiAnim.mTicksPerSecond;
+		if (keyCount > 1 && span > 0.0)
+			maxRate = std::max(maxRate, (double)(keyCount - 1) / span);
+	};
+
+	for (unsigned int channelIdx = 0; channelIdx < aiAnim.mNumChannels; channelIdx++)
+	{
+		const aiNodeAnim* channel = aiAnim.mChannels[channelIdx];
+		if (lookup.Find(HashBoneName(channel->mNodeName.C_Str(), channel->mNodeName.length)) == INVALID_BONE_ID)
+			continue;
+
+		if (channel->mNumPositionKeys > 0)
+			addKeys(channel->mPositionKeys[0].mTime, channel->mPositionKeys[channel->mNumPositionKeys - 1].mTime, channel->mNumPositionKeys);
+		if (channel->mNumRotationKeys > 0)
+			addKeys(channel->mRotationKeys[0].mTime, channel->mRotationKeys[channel->mNumRotationKeys - 1].mTime, channel->mNumRotationKeys);
+		if (channel->mNumScalingKeys > 0)
+			addKeys(channel->mScalingKeys[0].mTime, channel->mScalingKeys[channel->mNumScalingKeys - 1].mTime, channel->mNumScalingKeys);
+	}
+
+	// a clip without any moving key still gets its first and last frame
+	float rate = roundf((float)maxRate);
+	return rate < 1.0f ? 1.0f : (rate > CLIP_MAX_TPS ? CLIP_MAX_TPS : rate);
+}
+
+bool AnimClip::ImportFrom(const char* filePath, const Skeleton& skeleton)
+{
+	Assimp::Importer importer;
+	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, CLIP_IMPORT_REMOVED_COMPONENTS);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_MATERIALS, false);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_TEXTURES, false);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_CAMERAS, false);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_LIGHTS, false);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_READ_ALL_GEOMETRY_LAYERS, false);
+	importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false); // one channel per bone, no pivot helper nodes
+
+	BoneLookup lookup;
+	lookup.Build(skeleton);
+
+	const aiScene* scene = importer.ReadFile(filePath, aiProcess_RemoveComponent);
+	if (!scene || scene->mNumAnimations == 0)
+		return false;
+
+	// every rejection is reported, the full import that follows is much slower
+	const char* mismatch = FindSkeletonMismatch(*scene, skeleton, lookup);
+	const aiAnimation* aiAnim = scene->mAnimations[0];
+	if (!mismatch && aiAnim->mTicksPerSecond <= 0.0)
+		mismatch = "the file has no ticks per second";
+	if (mismatch)
+	{
+		DebuggerPrintf(Stringf("[IMPORT] %s: animation only import skipped, %s\n", filePath, mismatch).c_str());
+		return false;
+	}
+
+	double ticksPerSecond = aiAnim->mTicksPerSecond;
+
+	m_name = aiAnim->mName.C_Str();
+	m_tps = FindSourceKeyRate(*aiAnim, lookup);
+	m_duration = (float)(aiAnim->mDuration / ticksPerSecond);
+	m_frameCount = (int)floorf(m_duration * m_tps) + 1;
+	m_boneCount = (int)skeleton.size();
+	m_attachedKeys = nullptr;
+	m_keys.resize((size_t)m_boneCount * m_frameCount);
+	m_source.reset();
+
+	// bones without a channel hold their bind pose
+	Pose restPose = skeleton.GetPose();
+	for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+	{
+		for (int frameIdx = 0; frameIdx < m_frameCount; frameIdx++)
+			m_keys[GetKeyIndex((BoneId)boneIdx, frameIdx)] = restPose.m_boneLocalPose[boneIdx];
+	}
+
+	for (unsigned int channelIdx = 0; channelIdx < aiAnim->mNumChannels; channelIdx++)
+	{
+		const aiNodeAnim* channel = aiAnim->mChannels[channelIdx];
+		BoneId boneId = lookup.Find(HashBoneName(channel->mNodeName.C_Str(), channel->mNodeName.length));
+		if (boneId == INVALID_BONE_ID)
+			continue;
+
+		const TransformQuat& rest = restPose.m_boneLocalPose[boneId];
+		unsigned int positionCursor = 0;
+		unsigned int rotationCursor = 0;
+		unsigned int scaleCursor = 0;
+		for (int frameIdx = 0; frameIdx < m_frameCount; frameIdx++)
+		{
+			double time = (double)frameIdx / m_tps * ticksPerSecond;
+			TransformQuat& key = m_keys[GetKeyIndex(boneId, frameIdx)];
+			key.m_position = SampleVectorKeys(channel->mPositionKeys, channel->mNumPositionKeys, time, rest.m_position, positionCursor);
+			key.m_rotation = SampleQuatKeys(channel->mRotationKeys, channel->mNumRotationKeys, time, rest.m_rotation, rotationCursor);
+			key.m_scale = SampleVectorKeys(channel->mScalingKeys, channel->mNumScalingKeys, time, rest.m_scale, scaleCursor);
+		}
+	}
+
+	return true;
+}
+
+void AnimClip::PackBlocks(std::vector<uint8_t>& out) const
+{
+	// one compressed block per time range, blocks of a streamed clip are written back as they are
+	const TransformQuat* keys = m_attachedKeys ? m_attachedKeys : m_keys.data();
+	size_t keyCount = (size_t)m_boneCount * m_frameCount;
+	if (IsStreamed())
+		out.assign(m_source->GetPackedData(), m_source->GetPackedData() + m_source->GetPackedSize());
+	else
+		CompressToBlocks(keys, keyCount * sizeof(TransformQuat), (uint32_t)(m_boneCount * CLIP_BLOCK_FRAMES * sizeof(TransformQuat)), out);
+}
+
+void AnimClip::WriteCooked(CookedAssetWriter& writer) const
+{
+	CookedClipHeader header;
+	header.m_tps = m_tps;
+	header.m_duration = m_duration;
+	header.m_frameCount = m_frameCount;
+	header.m_boneCount = m_boneCount;
+
+	std::vector<uint8_t> packed;
+	PackBlocks(packed);
+
+	// blocks are already compressed, the container stores them as they are
+	writer.AddSection(SECTION_CLIP, CLIP_SECTION_VERSION, &header, sizeof(header), 1);
+	writer.AddSection(SECTION_CNAM, CLIP_SECTION_VERSION, m_name);
+	writer.AddArray(SECTION_CKEY, CLIP_SECTION_VERSION, packed);
+}
+
+bool AnimClip::ReadCookedHeader(const CookedAssetView& view)
+{
+	// clips before 2 were resampled to 60 fps, they fail here and are imported again at the source's rate
+	if (view.GetSectionVersion(SECTION_CLIP) != CLIP_SECTION_VERSION)
+		return false;
+
+	size_t headerCount = 0;
+	const CookedClipHeader* header = view.GetArray<CookedClipHeader>(SECTION_CLIP, headerCount);
+	if (headerCount != 1 || header->m_blockFrames != CLIP_BLOCK_FRAMES || !view.ReadString(SECTION_CNAM, m_name))
+		return false;
+
+	m_tps = header->m_tps;
+	m_duration = header->m_duration;
+	m_frameCount = header->m_frameCount;
+	m_boneCount = header->m_boneCount;
+	return true;
+}
+
+bool AnimClip::ReadCooked(const CookedAssetView& view)
+{
+	std::vector<uint8_t> packed;
+	if (!ReadCookedHeader(view) || !view.ReadArray(SECTION_CKEY, packed))
+		return false;
+
+	return SetSource(std::make_shared<ClipBlockSource>(std::move(packed)));
+}
+
+bool AnimClip::ReadCooked(CookedAssetView&& view)
+{
+	// short clips are cheaper to copy than to keep a mapping open for
+	const CookedSection* section = view.FindSection(SECTION_CKEY);
+	if (!section || section->m_compression != CookedCompression::NONE || section->m_rawSize < CLIP_STREAM_MAP_MIN_BYTES)
+		return ReadCooked(static_cast<const CookedAssetView&>(view));
+
+	size_t packedSize = 0;
+	const uint8_t* packed = view.GetArray<uint8_t>(SECTION_CKEY, packedSize);
+	if (!ReadCookedHeader(view))
+		return false;
+
+	return SetSource(std::make_shared<ClipBlockSource>(std::move(view), packed, packedSize));
+}
+
+bool AnimClip::SetSource(const std::shared_ptr<ClipBlockSource>& source)
+{
+	m_keys.clear();
+	m_attachedKeys = nullptr;
+	m_source.reset();
+	if (!source->Initialize(m_boneCount, m_frameCount, CLIP_BLOCK_FRAMES))
+		return false;
+
+	m_source = source;
+	return true;
+}
+
+ClipBlockWindow& AnimClip::GetWindow(AnimClipPlayback& playback) const
+{
+	// a reloaded clip has a new source, the old window keeps the old one alive until it is replaced here
+	if (!playback.m_window || playback.m_window->GetSource() != m_source.get())
+		playback.m_window = std::make_shared<ClipBlockWindow>(m_source);
+	return *playback.m_window;
+}
+
+size_t AnimClipPlayback::GetResidentBytes() const
+{
+	return m_window ? m_window->GetResidentBytes() : 0;
+}
+
+void AnimClip::WriteBytes(ByteBuffer* buffer) const
+{
+	buffer->WriteString(m_name);
+	buffer->Write(m_tps);
+	buffer->Write(m_duration);
+	buffer->Write(m_frameCount);
+	buffer->Write(m_boneCount);
+
+	std::vector<uint8_t> packed;
+	PackBlocks(packed);
+	buffer->Write((uint64_t)packed.size());
+	buffer->Write(packed.size(), packed.data());
+}
+
+void AnimClip::ReadBytes(ByteBuffer* buffer)
+{
+	m_name = buffer->ReadString();
+	buffer->Read(m_tps);
+	buffer->Read(m_duration);
+	buffer->Read(m_frameCount);
+	buffer->Read(m_boneCount);
+
+	uint64_t packedSize = 0;
+	buffer->Read(packedSize);
+	std::vector<uint8_t> packed((size_t)packedSize);
+	buffer->Read(packed.size(), packed.data());
+
+	if (!SetSource(std::make_shared<ClipBlockSource>(std::move(packed))))
+		DebuggerPrintf(Stringf("Clip %s: block stream is corrupt\n", m_name.c_str()).c_str());
+}
+
+AnimClipCursor AnimClip::GetCursor(float time) const
+{
+	AnimClipCursor cursor;
+	if (m_frameCount == 0)
+		return cursor;
+
+	float localTime = m_duration > 0.0f ? fmodf(time, m_duration) : 0.0f;
+	if (localTime < 0.0f)
+		localTime += m_duration;
+
+	// uniform keys, the segment is found by index instead of a search per track
+	float framePos = localTime * m_tps;
+	cursor.m_frame0 = (int)framePos < m_frameCount ? (int)framePos : m_frameCount - 1;
+	cursor.m_frame1 = cursor.m_frame0 + 1 < m_frameCount ? cursor.m_frame0 + 1 : cursor.m_frame0;
+	cursor.m_alpha = framePos - (float)cursor.m_frame0;
+	return cursor;
+}
+
+int AnimClip::GetBlockFrameCount(int blockIdx) const
+{
+	int firstFrame = blockIdx * CLIP_BLOCK_FRAMES;
+	return m_frameCount - firstFrame < CLIP_BLOCK_FRAMES ? m_frameCount - firstFrame : CLIP_BLOCK_FRAMES;
+}
+
+size_t AnimClip::GetKeyIndex(BoneId boneId, int frame) const
+{
+	int blockIdx = frame / CLIP_BLOCK_FRAMES;
+	size_t blockStart = (size_t)blockIdx * m_boneCount * CLIP_BLOCK_FRAMES;
+	return blockStart + (size_t)boneId * GetBlockFrameCount(blockIdx) + frame % CLIP_BLOCK_FRAMES;
+}
+
+size_t AnimClip::GetResidentBytes() const
+{
+	return m_keys.size() * sizeof(TransformQuat) + (IsStreamed() ? m_source->GetResidentBytes() : 0);
+}
+
+bool AnimClip::IsMapped() const
+{
+	return IsStreamed() && m_source->IsMapped();
+}
+
+void AnimClip::CopyKeys(std::vector<TransformQuat>& out) const
+{
+	if (!IsStreamed())
+	{
+		const TransformQuat* keys = m_attachedKeys ? m_attachedKeys : m_keys.data();
+		out.assign(keys, keys + (size_t)m_boneCount * m_frameCount);
+		return;
+	}
+
+	// blocks already hold the unpacked layout, decode them in order without keeping them resident
+	out.clear();
+	out.reserve((size_t)m_boneCount * m_frameCount);
+	std::vector<TransformQuat> block;
+	for (int blockIdx = 0; blockIdx < GetBlockCount(); blockIdx++)
+	{
+		m_source->Decode(blockIdx, block);
+		out.insert(out.end(), block.begin(), block.end());
+	}
+}
+
+void AnimClip::AttachKeys(const TransformQuat* keys)
+{
+	m_attachedKeys = keys;
+	m_keys.clear();
+	m_source.reset();
+}
+
+const TransformQuat& AnimClip::GetKey(BoneId boneId, int frame) const
+{
+	ASSERT_OR_DIE(!IsStreamed(), "Streamed clips are sampled through an AnimClipPlayback");
+	if (m_attachedKeys)
+		return m_attachedKeys[GetKeyIndex(boneId, frame)];
+	return m_keys[GetKeyIndex(boneId, frame)];
+}
+
+void AnimClip::SampleBone(BoneId boneId, const AnimClipCursor& cursor, TransformQuat& out) const
+{
+	out = InterpolateTransform(GetKey(boneId, cursor.m_frame0), GetKey(boneId, cursor.m_frame1), cursor.m_alpha);
+}
+
+const TransformQuat& AnimClip::GetKey(BoneId boneId, int frame, AnimClipPlayback& playback) const
+{
+	if (!IsStreamed())
+		return GetKey(boneId, frame);
+
+	int blockIdx = frame / CLIP_BLOCK_FRAMES;
+	return GetWindow(playback).Acquire(blockIdx)[(size_t)boneId * GetBlockFrameCount(blockIdx) + frame % CLIP_BLOCK_FRAMES];
+}
+
+void AnimClip::SampleBone(BoneId boneId, const AnimClipCursor& cursor, TransformQuat& out, AnimClipPlayback& playback) const
+{
+	out = InterpolateTransform(GetKey(boneId, cursor.m_frame0, playback), GetKey(boneId, cursor.m_frame1, playback), cursor.m_alpha);
+}
+
+void AnimClip::SamplePose(float time, Pose& pose, AnimClipPlayback& playback) const
+{
+	AnimClipCursor cursor = GetCursor(time);
+	for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+		SampleBone((BoneId)boneIdx, cursor, pose.m_boneLocalPose[boneIdx], playback);
+
+	TrimResidentBlocks(cursor, playback);
+}
+
+void AnimClip::TrimResidentBlocks(const AnimClipCursor& cursor, AnimClipPlayback& playback) const
+{
+	if (!IsStreamed())
+		return;
+
+	// playback moves forward and loops, the blocks of the current key pair and the next few stay resident
+	ClipBlockWindow& window = GetWindow(playback);
+	int blockCount = GetBlockCount();
+	int keepBlocks[2 + CLIP_PREFETCH_BLOCKS];
+	int keepCount = 0;
+	keepBlocks[keepCount++] = cursor.m_frame0 / CLIP_BLOCK_FRAMES;
+	keepBlocks[keepCount++] = cursor.m_frame1 / CLIP_BLOCK_FRAMES;
+	for (int ahead = 1; ahead <= CLIP_PREFETCH_BLOCKS && ahead < blockCount; ahead++)
+	{
+		int blockIdx = (keepBlocks[1] + ahead) % blockCount;
+		keepBlocks[keepCount++] = blockIdx;
+		window.Prefetch(blockIdx);
+	}
+	window.ReleaseExcept(keepBlocks, keepCount);
+}
+
+const TransformQuat* AnimClip::GetBlockKeys(int blockIdx, std::vector<TransformQuat>& scratch) const
+{
+	if (m_attachedKeys)
+		return m_attachedKeys + (size_t)blockIdx * m_boneCount * CLIP_BLOCK_FRAMES;
+	if (!IsStreamed())
+		return m_keys.data() + (size_t)blockIdx * m_boneCount * CLIP_BLOCK_FRAMES;
+
+	// decoded here, the players' windows are theirs and may be trimmed on another thread meanwhile
+	m_source->Decode(blockIdx, scratch);
+	return scratch.data();
+}
+
+void AnimClip::SampleBatch(const float* times, int timeCount, TransformQuat* outLocalPoses) const
+{
+	if (m_frameCount == 0 || timeCount <= 0)
+		return;
+
+	struct BatchSample
+	{
+		AnimClipCursor m_cursor;
+		int            m_timeIdx;
+	};
+	std::vector<BatchSample> samples(timeCount);
+	for (int timeIdx = 0; timeIdx < timeCount; timeIdx++)
+		samples[timeIdx] = { GetCursor(times[timeIdx]), timeIdx };
+	std::stable_sort(samples.begin(), samples.end(), [](const BatchSample& a, const BatchSample& b) { return a.m_cursor.m_frame0 < b.m_cursor.m_frame0; });
+
+	// the second key is in the same block or the first frame of the next one, two decoded blocks are kept
+	std::vector<TransformQuat> scratch[2];
+	int scratchBlocks[2] = { -1, -1 };
+	auto getBlock = [&](int blockIdx) -> const TransformQuat*
+	{
+		if (!IsStreamed())
+			return GetBlockKeys(blockIdx, scratch[0]);
+		for (int slot = 0; slot < 2; slot++)
+		{
+			if (scratchBlocks[slot] == blockIdx)
+				return scratch[slot].data();
+		}
+		int slot = scratchBlocks[0] < scratchBlocks[1] ? 0 : 1; // blocks only move forward, the older one goes
+		scratchBlocks[slot] = blockIdx;
+		return GetBlockKeys(blockIdx, scratch[slot]);
+	};
+
+	size_t first = 0;
+	while (first < samples.size())
+	{
+		int blockIdx = samples[first].m_cursor.m_frame0 / CLIP_BLOCK_FRAMES;
+		size_t last = first;
+		bool needsNext = false;
+		while (last < samples.size() && samples[last].m_cursor.m_frame0 / CLIP_BLOCK_FRAMES == blockIdx)
+		{
+			needsNext |= samples[last].m_cursor.m_frame1 / CLIP_BLOCK_FRAMES != blockIdx;
+			last++;
+		}
+
+		const TransformQuat* block = getBlock(blockIdx);
+		const TransformQuat* nextBlock = needsNext ? getBlock(blockIdx + 1) : nullptr;
+		int blockFrames = GetBlockFrameCount(blockIdx);
+		int nextBlockFrames = needsNext ? GetBlockFrameCount(blockIdx + 1) : 0;
+
+		for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+		{
+			const TransformQuat* track = block + (size_t)boneIdx * blockFrames;
+			const TransformQuat* nextTrack = needsNext ? nextBlock + (size_t)boneIdx * nextBlockFrames : nullptr;
+			for (size_t sampleIdx = first; sampleIdx < last; sampleIdx++)
+			{
+				const AnimClipCursor& cursor = samples[sampleIdx].m_cursor;
+				const TransformQuat& key0 = track[cursor.m_frame0 % CLIP_BLOCK_FRAMES];
+				const TransformQuat& key1 = cursor.m_frame1 / CLIP_BLOCK_FRAMES == blockIdx ? track[cursor.m_frame1 % CLIP_BLOCK_FRAMES] : nextTrack[0];
+				outLocalPoses[(size_t)samples[sampleIdx].m_timeIdx * m_boneCount + boneIdx] = InterpolateTransform(key0, key1, cursor.m_alpha);
+			}
+		}
+		first = last;
+	}
+}
+
+BoneQuery::BoneQuery(const Skeleton& skeleton, const std::vector<BoneId>& bones)
+{
+	int boneCount = (int)skeleton.size();
+	m_parents.resize(boneCount, INVALID_BONE_ID);
+	m_compPose.resize(boneCount);
+
+	for (auto& bone : skeleton)
+		m_parents[bone.m_id] = bone.m_parentId;
+
+	// close the set over ancestors, remembering depth so parents get evaluated first
+	// each walk stops at the first bone already in the set and numbers the new ones down from there,
+	// so every bone is visited once however deep the chains are
+	std::vector<int> depth(boneCount, -1);
+	std::vector<BoneId> chain;
+	for (BoneId boneId : bones)
+	{
+		chain.clear();
+		BoneId id = boneId;
+		for (; id != INVALID_BONE_ID && depth[id] < 0; id = m_parents[id])
+			chain.push_back(id);
+
+		int d = id == INVALID_BONE_ID ? 0 : depth[id] + 1;
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it, d++)
+		{
+			depth[*it] = d;
+			m_evalOrder.push_back(*it);
+		}
+	}
+
+	std::sort(m_evalOrder.begin(), m_evalOrder.end(), [&depth](BoneId a, BoneId b) { return depth[a] < depth[b]; });
+}
+
+void BoneQuery::Evaluate(const AnimClip& clip, float time)
+{
+	AnimClipCursor cursor = clip.GetCursor(time);
+	clip.TrimResidentBlocks(cursor, m_playback);
+
+	TransformQuat local;
+	for (BoneId boneId : m_evalOrder)
+	{
+		clip.SampleBone(boneId, cursor, local, m_playback);
+
+		BoneId parentId = m_parents[boneId];
+		m_compPose[boneId] = parentId == INVALID_BONE_ID ? local : CombineTransform(m_compPose[parentId], local);
+	}
+}
+
+void BoneQuery::EvaluateFrame(const AnimClip& clip, const TransformQuat* keys, int frame)
+{
+	for (BoneId boneId : m_evalOrder)
+	{
+		const TransformQuat& local = keys[clip.GetKeyIndex(boneId, frame)];
+		BoneId parentId = m_parents[boneId];
+		m_compPose[boneId] = parentId == INVALID_BONE_ID ? local : CombineTransform(m_compPose[parentId], local);
+	}
+}
+
+const TransformQuat& BoneQuery::GetCompTransform(BoneId boneId) const
+{
+	return m_compPose[boneId];
+}
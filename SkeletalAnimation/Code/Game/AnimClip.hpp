@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Animation;
+class ByteBuffer;
+class ClipBlockSource;
+class ClipBlockWindow;
+class CookedAssetView;
+class CookedAssetWriter;
+
+constexpr float CLIP_FALLBACK_TPS = 60.0f; // sources without key times of their own, engine animations
+constexpr float CLIP_MAX_TPS      = 120.0f; // denser sources are resampled down to this
+constexpr int   CLIP_BLOCK_FRAMES = 64; // frames per compressed block, the unit of on demand decompression
+
+// key pair and blend factor for one sample time, shared by every track of a clip
+struct AnimClipCursor
+{
+public:
+	int   m_frame0 = 0;
+	int   m_frame1 = 0;
+	float m_alpha  = 0.0f;
+};
+
+// decoded blocks around one playback position of a streamed clip, owned by whoever plays the clip
+// players at different times each keep their own, the packed blocks stay shared by the clip
+// in memory and attached clips never touch it
+class AnimClipPlayback
+{
+public:
+	void   Reset() { m_window.reset(); }
+	size_t GetResidentBytes() const;
+
+private:
+	friend class AnimClip;
+	std::shared_ptr<ClipBlockWindow> m_window; // made on first use, and again once the clip was reloaded
+};
+
+// uniform rate local pose tracks baked from an Animation, keys are grouped in blocks of CLIP_BLOCK_FRAMES frames
+// with one contiguous track per bone inside a block, so partial evaluation never touches unused bones
+// cooked clips stay compressed and only decompress the blocks around the sampled time into the player's
+// AnimClipPlayback, a background thread decodes the blocks ahead of it and the ones behind it are released,
+// so resident keys do not grow with length
+class AnimClip
+{
+public:
+	void BakeFrom(const Animation& animation, const Skeleton& skeleton, float tps);
+
+	// animation only import straight from assimp, meshes are stripped before any post processing runs
+	// keys stay at the source's own rate, the densest channel's, so a 30 fps clip is not stored at 60
+	// fails if the file's nodes do not reproduce the skeleton and its bind pose, or the file has no tick rate,
+	// the caller then falls back to a full import
+	bool ImportFrom(const char* filePath, const Skeleton& skeleton);
+
+	// cooked sections, the packed blocks are copied out of the mapping in one go
+	// taking the view lets a long clip keep its file mapped and stream blocks straight from it
+	void WriteCooked(CookedAssetWriter& writer) const;
+	bool ReadCooked(const CookedAssetView& view);
+	bool ReadCooked(CookedAssetView&& view);
+
+	// field by field, only for clips cooked before they became sectioned assets
+	void WriteBytes(ByteBuffer* buffer) const;
+	void ReadBytes(ByteBuffer* buffer);
+
+	AnimClipCursor GetCursor(float time) const;
+
+	// in memory and attached clips only, e.g. library clips, streamed ones need a playback
+	const TransformQuat& GetKey(BoneId boneId, int frame) const;
+	void SampleBone(BoneId boneId, const AnimClipCursor& cursor, TransformQuat& out) const;
+
+	// any clip, streamed blocks are decoded into the playback
+	const TransformQuat& GetKey(BoneId boneId, int frame, AnimClipPlayback& playback) const;
+	void SampleBone(BoneId boneId, const AnimClipCursor& cursor, TransformQuat& out, AnimClipPlayback& playback) const;
+	void SamplePose(float time, Pose& pose, AnimClipPlayback& playback) const; // also prefetches ahead and releases blocks behind
+	void TrimResidentBlocks(const AnimClipCursor& cursor, AnimClipPlayback& playback) const; // for callers sampling bone by bone
+
+	// local poses at many times, [time][bone] in the order given, for bakes and feature extraction
+	// times are sorted by key so each track is swept once per block, streamed blocks are decoded once without staying resident, any thread
+	void SampleBatch(const float* times, int timeCount, TransformQuat* outLocalPoses) const;
+
+	int    GetBlockCount() const { return (m_frameCount + CLIP_BLOCK_FRAMES - 1) / CLIP_BLOCK_FRAMES; }
+	int    GetBlockFrameCount(int blockIdx) const;
+	bool   IsStreamed() const { return m_source != nullptr; }
+	bool   IsMapped() const;
+	size_t GetResidentBytes() const; // attached keys belong to their library, mapped blocks to the os and decoded ones to the players
+
+	// all keys in the unpacked layout, decoding streamed blocks as needed
+	void CopyKeys(std::vector<TransformQuat>& out) const;
+	size_t GetKeyIndex(BoneId boneId, int frame) const; // into the unpacked [block][bone][frame] layout
+
+	// play keys owned elsewhere, e.g. a clip library arena, which must outlive the clip
+	void AttachKeys(const TransformQuat* keys);
+	bool HasAttachedKeys() const { return m_attachedKeys != nullptr; }
+
+private:
+	const TransformQuat* GetBlockKeys(int blockIdx, std::vector<TransformQuat>& scratch) const;
+	void   PackBlocks(std::vector<uint8_t>& out) const;
+	bool   ReadCookedHeader(const CookedAssetView& view);
+	bool   SetSource(const std::shared_ptr<ClipBlockSource>& source);
+	ClipBlockWindow& GetWindow(AnimClipPlayback& playback) const;
+
+
+public:
+	std::string                m_name;
+	float                      m_tps        = 60.0f;
+	float                      m_duration   = 0.0f;
+	int                        m_frameCount = 0;
+	int                        m_boneCount  = 0;
+	std::vector<TransformQuat> m_keys; // [block][bone][frame in block], empty while streamed or attached
+
+private:
+	const TransformQuat*                            m_attachedKeys = nullptr;
+
+	// streamed keys, copies of a clip share the packed blocks like they share a resource
+	std::shared_ptr<const ClipBlockSource>          m_source;
+};
+
+// component space transforms of a few bones without a full pose update
+// only the tracks on the ancestor paths of the queried bones are sampled and baked
+class BoneQuery
+{
+public:
+	BoneQuery(const Skeleton& skeleton, const std::vector<BoneId>& bones);
+
+	void Evaluate(const AnimClip& clip, float time);
+	void EvaluateFrame(const AnimClip& clip, const TransformQuat* keys, int frame); // one frame of the clip's keys as CopyKeys lays them out, no interpolation or wrapping
+	const TransformQuat& GetCompTransform(BoneId boneId) const;
+	int GetEvaluatedBoneCount() const { return (int)m_evalOrder.size(); }
+
+private:
+	std::vector<BoneId>        m_evalOrder; // ancestors closed, parents before children
+	std::vector<BoneId>        m_parents;
+	std::vector<TransformQuat> m_compPose;
+	AnimClipPlayback           m_playback; // only the evaluated block stays decoded
+};
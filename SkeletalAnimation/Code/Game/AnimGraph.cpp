@@ -0,0 +1,522 @@
+#include "AnimGraph.hpp"
+#include "AnimUtils.hpp"
+
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/XmlUtils.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+bool ReadGraphNode(const XmlElement& element, AnimGraphNodeDesc& out)
+{
+	std::string type = element.Name();
+	if (type == "Clip")
+	{
+		out.m_type = AnimGraphNodeType::CLIP;
+		out.m_clip = ParseXmlAttribute(element, "clip", "");
+		out.m_rate = ParseXmlAttribute(element, "rate", 1.0f);
+		out.m_loop = ParseXmlAttribute(element, "loop", true);
+	}
+	else if (type == "Blend")
+	{
+		out.m_type = AnimGraphNodeType::BLEND;
+		out.m_weight = ParseXmlAttribute(element, "weight", 0.5f);
+	}
+	else if (type == "Blend1D")
+	{
+		out.m_type = AnimGraphNodeType::BLEND_1D;
+	}
+	else
+	{
+		return false;
+	}
+	out.m_parameter = ParseXmlAttribute(element, "parameter", "");
+	out.m_threshold = ParseXmlAttribute(element, "threshold", 0.0f);
+
+	for (const XmlElement* child = element.FirstChildElement(); child; child = child->NextSiblingElement())
+	{
+		out.m_children.emplace_back();
+		if (!ReadGraphNode(*child, out.m_children.back()))
+			return false;
+	}
+	return true;
+}
+
+bool AnimGraphDesc::LoadFromXmlElement(const XmlElement& element)
+{
+	m_entryState = ParseXmlAttribute(element, "entry", "");
+
+	for (const XmlElement* parameter = element.FirstChildElement("Parameter"); parameter; parameter = parameter->NextSiblingElement("Parameter"))
+		m_parameters.emplace_back(ParseXmlAttribute(*parameter, "name", ""), ParseXmlAttribute(*parameter, "default", 0.0f));
+
+	for (const XmlElement* state = element.FirstChildElement("State"); state; state = state->NextSiblingElement("State"))
+	{
+		m_states.emplace_back();
+		m_states.back().m_name = ParseXmlAttribute(*state, "name", "");
+		const XmlElement* root = state->FirstChildElement();
+		if (!root || !ReadGraphNode(*root, m_states.back().m_root))
+			return false;
+	}
+
+	for (const XmlElement* transition = element.FirstChildElement("Transition"); transition; transition = transition->NextSiblingElement("Transition"))
+	{
+		AnimGraphTransitionDesc desc;
+		desc.m_from = ParseXmlAttribute(*transition, "from", "");
+		desc.m_to = ParseXmlAttribute(*transition, "to", "");
+		desc.m_parameter = ParseXmlAttribute(*transition, "parameter", "");
+		if (transition->Attribute("greater"))
+		{
+			desc.m_compare = AnimGraphCompare::GREATER;
+			desc.m_threshold = ParseXmlAttribute(*transition, "greater", 0.0f);
+		}
+		else if (transition->Attribute("less"))
+		{
+			desc.m_compare = AnimGraphCompare::LESS;
+			desc.m_threshold = ParseXmlAttribute(*transition, "less", 0.0f);
+		}
+		desc.m_exitTime = ParseXmlAttribute(*transition, "exitTime", -1.0f);
+		desc.m_duration = ParseXmlAttribute(*transition, "duration", 0.2f);
+		m_transitions.push_back(desc);
+	}
+	return true;
+}
+
+bool AnimGraphDesc::LoadFromFile(const char* filePath)
+{
+	XmlDocument document;
+	if (document.LoadFile(filePath) != tinyxml2::XML_SUCCESS || !document.RootElement())
+		return false;
+	return LoadFromXmlElement(*document.RootElement());
+}
+
+bool AnimGraphProgram::Compile(const AnimGraphDesc& desc, const ClipLibraryRef& library, uint64_t skeletonHash, std::string& outError)
+{
+	*this = AnimGraphProgram();
+	m_library = library;
+	m_skeletonHash = skeletonHash;
+	if (!m_library || desc.m_states.empty())
+	{
+		outError = "needs a clip library and at least one state";
+		return false;
+	}
+
+	for (auto& parameter : desc.m_parameters)
+	{
+		m_parameterNames.push_back(parameter.first);
+		m_parameterDefaults.push_back(parameter.second);
+	}
+	if (m_parameterNames.size() >= ANIM_GRAPH_NO_PARAMETER)
+	{
+		outError = "too many parameters";
+		return false;
+	}
+	for (auto& state : desc.m_states)
+		m_stateNames.push_back(state.m_name);
+
+	for (auto& stateDesc : desc.m_states)
+	{
+		AnimGraphState state;
+		state.m_codeStart = (int32_t)m_code.size();
+		if (!CompileNode(stateDesc.m_root, 0, state.m_duration, outError))
+		{
+			outError = Stringf("state %s: %s", stateDesc.m_name.c_str(), outError.c_str());
+			return false;
+		}
+		state.m_codeCount = (int32_t)m_code.size() - state.m_codeStart;
+		m_states.push_back(state);
+	}
+
+	// transitions are stored next to each other per source state so a state only scans its own
+	for (int stateIdx = 0; stateIdx < (int)m_states.size(); stateIdx++)
+	{
+		AnimGraphState& state = m_states[stateIdx];
+		state.m_transitionStart = (int32_t)m_transitions.size();
+		for (auto& transitionDesc : desc.m_transitions)
+		{
+			if (transitionDesc.m_from != m_stateNames[stateIdx])
+				continue;
+
+			AnimGraphTransition transition;
+			transition.m_target = FindState(transitionDesc.m_to.c_str());
+			transition.m_compare = transitionDesc.m_compare;
+			transition.m_threshold = transitionDesc.m_threshold;
+			transition.m_exitTime = transitionDesc.m_exitTime;
+			transition.m_duration = transitionDesc.m_duration;
+			if (transition.m_target < 0)
+			{
+				outError = Stringf("transition %s -> %s: unknown target state", transitionDesc.m_from.c_str(), transitionDesc.m_to.c_str());
+				return false;
+			}
+			if (transition.m_compare == AnimGraphCompare::ALWAYS && transition.m_exitTime < 0.0f)
+			{
+				outError = Stringf("transition %s -> %s: needs a condition or an exit time", transitionDesc.m_from.c_str(), transitionDesc.m_to.c_str());
+				return false;
+			}
+			if (transition.m_compare != AnimGraphCompare::ALWAYS && !ResolveParameter(transitionDesc.m_parameter, transition.m_parameter, outError))
+				return false;
+			m_transitions.push_back(transition);
+		}
+		state.m_transitionCount = (int32_t)m_transitions.size() - state.m_transitionStart;
+	}
+	for (auto& transitionDesc : desc.m_transitions)
+	{
+		if (FindState(transitionDesc.m_from.c_str()) < 0)
+		{
+			outError = Stringf("transition from unknown state %s", transitionDesc.m_from.c_str());
+			return false;
+		}
+	}
+
+	m_entryState = desc.m_entryState.empty() ? 0 : FindState(desc.m_entryState.c_str());
+	if (m_entryState < 0)
+	{
+		outError = Stringf("unknown entry state %s", desc.m_entryState.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool AnimGraphProgram::CompileNode(const AnimGraphNodeDesc& node, int slot, float& outDuration, std::string& outError)
+{
+	// a node leaves its pose in the slot of its depth, its second child works one slot further in
+	if (slot >= ANIM_GRAPH_MAX_SLOTS)
+	{
+		outError = Stringf("blend tree deeper than %d", ANIM_GRAPH_MAX_SLOTS);
+		return false;
+	}
+	m_slotCount = std::max(m_slotCount, slot + 1);
+
+	AnimGraphInstruction instruction;
+	instruction.m_a = (uint8_t)slot;
+
+	switch (node.m_type)
+	{
+	case AnimGraphNodeType::CLIP:
+	{
+		int clip = AddClip(node.m_clip, outError);
+		if (clip < 0)
+			return false;
+		if (node.m_rate <= 0.0f)
+		{
+			outError = Stringf("clip %s: rate must be positive", node.m_clip.c_str());
+			return false;
+		}
+
+		instruction.m_op = AnimGraphOp::SAMPLE_CLIP;
+		instruction.m_index = clip;
+		instruction.m_value = node.m_rate;
+		instruction.m_flags = node.m_loop ? ANIM_GRAPH_FLAG_LOOP : 0;
+		outDuration = m_clips[clip]->m_duration / node.m_rate;
+		break;
+	}
+	case AnimGraphNodeType::BLEND:
+	{
+		float duration0 = 0.0f;
+		float duration1 = 0.0f;
+		if (node.m_children.size() != 2)
+		{
+			outError = "blend needs two children";
+			return false;
+		}
+		if (!CompileNode(node.m_children[0], slot, duration0, outError) || !CompileNode(node.m_children[1], slot + 1, duration1, outError))
+			return false;
+		if (!node.m_parameter.empty() && !ResolveParameter(node.m_parameter, instruction.m_parameter, outError))
+			return false;
+
+		instruction.m_op = AnimGraphOp::BLEND;
+		instruction.m_b = (uint8_t)(slot + 1);
+		instruction.m_value = std::min(std::max(node.m_weight, 0.0f), 1.0f);
+		outDuration = std::max(duration0, duration1);
+		break;
+	}
+	case AnimGraphNodeType::BLEND_1D:
+	{
+		if (node.m_children.empty() || node.m_children.size() > 255)
+		{
+			outError = "blend 1d needs between 1 and 255 clips";
+			return false;
+		}
+		if (!ResolveParameter(node.m_parameter, instruction.m_parameter, outError))
+			return false;
+
+		std::vector<AnimGraphBlendPoint> points;
+		for (auto& child : node.m_children)
+		{
+			if (child.m_type != AnimGraphNodeType::CLIP || child.m_rate <= 0.0f)
+			{
+				outError = "blend 1d children must be clips with a positive rate";
+				return false;
+			}
+
+			AnimGraphBlendPoint point;
+			point.m_clip = AddClip(child.m_clip, outError);
+			if (point.m_clip < 0)
+				return false;
+			point.m_threshold = child.m_threshold;
+			point.m_duration = m_clips[point.m_clip]->m_duration / child.m_rate;
+			points.push_back(point);
+		}
+		std::stable_sort(points.begin(), points.end(), [](const AnimGraphBlendPoint& a, const AnimGraphBlendPoint& b) { return a.m_threshold < b.m_threshold; });
+
+		instruction.m_op = AnimGraphOp::SAMPLE_BLEND_1D;
+		instruction.m_index = (int32_t)m_blendPoints.size();
+		instruction.m_b = (uint8_t)points.size();
+		outDuration = 0.0f;
+		for (auto& point : points)
+			outDuration = std::max(outDuration, point.m_duration);
+		m_blendPoints.insert(m_blendPoints.end(), points.begin(), points.end());
+		break;
+	}
+	}
+
+	m_code.push_back(instruction);
+	return true;
+}
+
+int AnimGraphProgram::AddClip(const std::string& name, std::string& outError)
+{
+	int clipId = m_library->FindClip(name);
+	if (clipId < 0 || m_library->GetEntry(clipId).m_skeletonHash != m_skeletonHash)
+	{
+		outError = Stringf("clip %s is not in the library for this skeleton", name.c_str());
+		return -1;
+	}
+
+	const AnimClip* clip = &m_library->GetClip(clipId);
+	if (m_boneCount != 0 && clip->m_boneCount != m_boneCount)
+	{
+		outError = Stringf("clip %s has %d bones, expected %d", name.c_str(), clip->m_boneCount, m_boneCount);
+		return -1;
+	}
+	m_boneCount = clip->m_boneCount;
+
+	auto found = std::find(m_clips.begin(), m_clips.end(), clip);
+	if (found != m_clips.end())
+		return (int)(found - m_clips.begin());
+	m_clips.push_back(clip);
+	return (int)m_clips.size() - 1;
+}
+
+bool AnimGraphProgram::ResolveParameter(const std::string& name, uint16_t& outParameter, std::string& outError) const
+{
+	int parameter = FindParameter(name.c_str());
+	if (parameter < 0)
+	{
+		outError = Stringf("unknown parameter %s", name.c_str());
+		return false;
+	}
+	outParameter = (uint16_t)parameter;
+	return true;
+}
+
+int AnimGraphProgram::FindParameter(const char* name) const
+{
+	for (int parameter = 0; parameter < (int)m_parameterNames.size(); parameter++)
+	{
+		if (m_parameterNames[parameter] == name)
+			return parameter;
+	}
+	return -1;
+}
+
+int AnimGraphProgram::FindState(const char* name) const
+{
+	for (int state = 0; state < (int)m_stateNames.size(); state++)
+	{
+		if (m_stateNames[state] == name)
+			return state;
+	}
+	return -1;
+}
+
+size_t AnimGraphProgram::GetBytes() const
+{
+	size_t bytes = sizeof(AnimGraphProgram);
+	bytes += m_code.size() * sizeof(AnimGraphInstruction);
+	bytes += m_blendPoints.size() * sizeof(AnimGraphBlendPoint);
+	bytes += m_states.size() * sizeof(AnimGraphState);
+	bytes += m_transitions.size() * sizeof(AnimGraphTransition);
+	bytes += m_clips.size() * sizeof(const AnimClip*) + m_parameterDefaults.size() * sizeof(float);
+	for (auto& name : m_parameterNames)
+		bytes += sizeof(std::string) + name.capacity();
+	for (auto& name : m_stateNames)
+		bytes += sizeof(std::string) + name.capacity();
+	return bytes;
+}
+
+AnimGraphInstance::AnimGraphInstance(const AnimGraphRef& program)
+	: m_program(program)
+{
+	Reset();
+}
+
+void AnimGraphInstance::Reset()
+{
+	m_parameters.resize(m_program->GetParameterCount());
+	for (int parameter = 0; parameter < (int)m_parameters.size(); parameter++)
+		m_parameters[parameter] = m_program->GetParameterDefault(parameter);
+
+	m_state = m_program->GetEntryState();
+	m_stateTime = 0.0f;
+	m_prevState = -1;
+	m_prevStateTime = 0.0f;
+	m_blendTime = 0.0f;
+	m_blendDuration = 0.0f;
+}
+
+bool AnimGraphInstance::SetParameter(const char* name, float value)
+{
+	int parameter = m_program->FindParameter(name);
+	if (parameter < 0)
+		return false;
+	m_parameters[parameter] = value;
+	return true;
+}
+
+// like GetCursor, but a clip that does not loop holds its last frame instead of wrapping
+AnimClipCursor GetGraphCursor(const AnimClip& clip, float time, bool loop)
+{
+	if (loop || time < clip.m_duration)
+		return clip.GetCursor(time);
+
+	AnimClipCursor cursor;
+	cursor.m_frame0 = std::max(clip.m_frameCount - 1, 0);
+	cursor.m_frame1 = cursor.m_frame0;
+	return cursor;
+}
+
+void AnimGraphEvaluator::Evaluate(AnimGraphInstance& instance, float deltaSeconds, std::vector<TransformQuat>& outPose)
+{
+	const AnimGraphProgram& program = *instance.m_program;
+	UpdateStateMachine(program, instance, deltaSeconds);
+
+	// the current state runs in the first half of the slots, a state fading out in the second
+	m_boneCount = program.m_boneCount;
+	size_t slotKeyCount = (size_t)program.m_slotCount * 2 * m_boneCount;
+	if (m_slots.size() < slotKeyCount)
+		m_slots.resize(slotKeyCount);
+
+	outPose.resize(m_boneCount);
+	RunState(program, instance, instance.m_state, instance.m_stateTime, 0);
+	if (instance.m_prevState < 0)
+	{
+		std::copy_n(m_slots.begin(), m_boneCount, outPose.begin());
+		return;
+	}
+
+	RunState(program, instance, instance.m_prevState, instance.m_prevStateTime, program.m_slotCount);
+	const TransformQuat* fadeOut = &m_slots[(size_t)program.m_slotCount * m_boneCount];
+	float weight = instance.m_blendTime / instance.m_blendDuration;
+	for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+		outPose[boneIdx] = InterpolateTransform(fadeOut[boneIdx], m_slots[boneIdx], weight);
+}
+
+void AnimGraphEvaluator::UpdateStateMachine(const AnimGraphProgram& program, AnimGraphInstance& instance, float deltaSeconds) const
+{
+	instance.m_stateTime += deltaSeconds;
+	if (instance.m_prevState >= 0)
+	{
+		instance.m_prevStateTime += deltaSeconds;
+		instance.m_blendTime += deltaSeconds;
+		if (instance.m_blendTime >= instance.m_blendDuration)
+			instance.m_prevState = -1;
+	}
+
+	const AnimGraphState& state = program.m_states[instance.m_state];
+	float normalizedTime = state.m_duration > 0.0f ? instance.m_stateTime / state.m_duration : 1.0f;
+	for (int transitionIdx = state.m_transitionStart; transitionIdx < state.m_transitionStart + state.m_transitionCount; transitionIdx++)
+	{
+		const AnimGraphTransition& transition = program.m_transitions[transitionIdx];
+		if (transition.m_exitTime >= 0.0f && normalizedTime < transition.m_exitTime)
+			continue;
+		if (transition.m_compare == AnimGraphCompare::GREATER && !(instance.m_parameters[transition.m_parameter] > transition.m_threshold))
+			continue;
+		if (transition.m_compare == AnimGraphCompare::LESS && !(instance.m_parameters[transition.m_parameter] < transition.m_threshold))
+			continue;
+
+		// the state being left fades out from where it is, a fade already running is dropped
+		instance.m_prevState = transition.m_duration > 0.0f ? instance.m_state : -1;
+		instance.m_prevStateTime = instance.m_stateTime;
+		instance.m_blendTime = 0.0f;
+		instance.m_blendDuration = transition.m_duration;
+		instance.m_state = transition.m_target;
+		instance.m_stateTime = 0.0f;
+		break;
+	}
+}
+
+void AnimGraphEvaluator::RunState(const AnimGraphProgram& program, const AnimGraphInstance& instance, int state, float stateTime, int slotBase)
+{
+	const AnimGraphInstruction* code = &program.m_code[program.m_states[state].m_codeStart];
+	int codeCount = program.m_states[state].m_codeCount;
+	for (int pc = 0; pc < codeCount; pc++)
+	{
+		const AnimGraphInstruction& instruction = code[pc];
+		TransformQuat* slotA = &m_slots[(size_t)(slotBase + instruction.m_a) * m_boneCount];
+
+		switch (instruction.m_op)
+		{
+		case AnimGraphOp::SAMPLE_CLIP:
+		{
+			const AnimClip& clip = *program.m_clips[instruction.m_index];
+			AnimClipCursor cursor = GetGraphCursor(clip, stateTime * instruction.m_value, (instruction.m_flags & ANIM_GRAPH_FLAG_LOOP) != 0);
+			for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+				clip.SampleBone((BoneId)boneIdx, cursor, slotA[boneIdx]);
+			break;
+		}
+		case AnimGraphOp::SAMPLE_BLEND_1D:
+		{
+			// points are sorted, positions past either end hold that end's clip
+			const AnimGraphBlendPoint* points = &program.m_blendPoints[instruction.m_index];
+			int pointCount = instruction.m_b;
+			float position = instance.m_parameters[instruction.m_parameter];
+			int point0 = 0;
+			int point1 = 0;
+			float weight = 0.0f;
+			if (position >= points[pointCount - 1].m_threshold)
+			{
+				point0 = point1 = pointCount - 1;
+			}
+			else if (position > points[0].m_threshold)
+			{
+				while (points[point0 + 1].m_threshold <= position)
+					point0++;
+				point1 = point0 + 1;
+				weight = (position - points[point0].m_threshold) / (points[point1].m_threshold - points[point0].m_threshold);
+			}
+
+			// both clips play at the same phase so their steps line up
+			float duration = points[point0].m_duration + (points[point1].m_duration - points[point0].m_duration) * weight;
+			float phase = duration > 0.0f ? fmodf(stateTime / duration, 1.0f) : 0.0f;
+
+			const AnimClip& clip0 = *program.m_clips[points[point0].m_clip];
+			AnimClipCursor cursor0 = clip0.GetCursor(phase * clip0.m_duration);
+			for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+				clip0.SampleBone((BoneId)boneIdx, cursor0, slotA[boneIdx]);
+
+			if (point1 != point0 && weight > 0.0f)
+			{
+				const AnimClip& clip1 = *program.m_clips[points[point1].m_clip];
+				AnimClipCursor cursor1 = clip1.GetCursor(phase * clip1.m_duration);
+				TransformQuat key;
+				for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+				{
+					clip1.SampleBone((BoneId)boneIdx, cursor1, key);
+					slotA[boneIdx] = InterpolateTransform(slotA[boneIdx], key, weight);
+				}
+			}
+			break;
+		}
+		case AnimGraphOp::BLEND:
+		{
+			const TransformQuat* slotB = &m_slots[(size_t)(slotBase + instruction.m_b) * m_boneCount];
+			float weight = instruction.m_value;
+			if (instruction.m_parameter != ANIM_GRAPH_NO_PARAMETER)
+				weight = std::min(std::max(instance.m_parameters[instruction.m_parameter], 0.0f), 1.0f);
+			for (int boneIdx = 0; boneIdx < m_boneCount; boneIdx++)
+				slotA[boneIdx] = InterpolateTransform(slotA[boneIdx], slotB[boneIdx], weight);
+			break;
+		}
+		}
+	}
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "ClipLibrary.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace tinyxml2
+{
+	class XMLElement;
+}
+typedef tinyxml2::XMLElement XmlElement;
+
+constexpr int      ANIM_GRAPH_MAX_SLOTS    = 16; // pose slots one state may use, deeper blend trees fail to compile
+constexpr uint16_t ANIM_GRAPH_NO_PARAMETER = 0xFFFF;
+constexpr uint8_t  ANIM_GRAPH_FLAG_LOOP    = 1 << 0;
+
+// ---- description, a tree read from xml and only walked by the compiler
+//
+// <AnimGraph entry="Locomotion">
+//     <Parameter name="speed" default="0"/>
+//     <State name="Locomotion">
+//         <Blend1D parameter="speed">
+//             <Clip clip="Idle" threshold="0"/>
+//             <Clip clip="Run" threshold="4" rate="1.2"/>
+//         </Blend1D>
+//     </State>
+//     <State name="Hit"><Clip clip="Hit" loop="false"/></State>
+//     <Transition from="Locomotion" to="Hit" parameter="hit" greater="0.5" duration="0.1"/>
+//     <Transition from="Hit" to="Locomotion" exitTime="0.9" duration="0.3"/>
+// </AnimGraph>
+
+enum class AnimGraphNodeType : uint8_t
+{
+	CLIP,
+	BLEND,    // two children, weighted by a parameter or a constant
+	BLEND_1D, // clip children placed along a parameter, the two around it are sampled
+};
+
+enum class AnimGraphCompare : uint8_t
+{
+	ALWAYS,
+	GREATER,
+	LESS,
+};
+
+struct AnimGraphNodeDesc
+{
+public:
+	AnimGraphNodeType              m_type      = AnimGraphNodeType::CLIP;
+	std::string                    m_clip;
+	float                          m_rate      = 1.0f;
+	bool                           m_loop      = true;
+	std::string                    m_parameter; // blend weight, or position along a blend 1d
+	float                          m_weight    = 0.5f; // blend without a parameter
+	float                          m_threshold = 0.0f; // position of a clip in its blend 1d parent
+	std::vector<AnimGraphNodeDesc> m_children;
+};
+
+struct AnimGraphStateDesc
+{
+public:
+	std::string       m_name;
+	AnimGraphNodeDesc m_root;
+};
+
+struct AnimGraphTransitionDesc
+{
+public:
+	std::string      m_from;
+	std::string      m_to;
+	std::string      m_parameter;
+	AnimGraphCompare m_compare   = AnimGraphCompare::ALWAYS;
+	float            m_threshold = 0.0f;
+	float            m_exitTime  = -1.0f; // normalized state time the transition waits for, negative for none
+	float            m_duration  = 0.2f;  // crossfade seconds
+};
+
+struct AnimGraphDesc
+{
+public:
+	bool LoadFromXmlElement(const XmlElement& element);
+	bool LoadFromFile(const char* filePath);
+
+public:
+	std::string                                m_entryState; // first state if empty
+	std::vector<std::pair<std::string, float>> m_parameters; // name and default
+	std::vector<AnimGraphStateDesc>            m_states;
+	std::vector<AnimGraphTransitionDesc>       m_transitions;
+};
+
+// ---- compiled program, flat arrays indexed by int with no pointers between them
+
+enum class AnimGraphOp : uint8_t
+{
+	SAMPLE_CLIP,     // slot a = clip m_index at state time * m_value
+	SAMPLE_BLEND_1D, // slot a = the two of the m_b blend points from m_index around the parameter, phase matched
+	BLEND,           // slot a = lerp(slot a, slot b), weight from the parameter or m_value
+};
+
+struct AnimGraphInstruction
+{
+public:
+	AnimGraphOp m_op        = AnimGraphOp::SAMPLE_CLIP;
+	uint8_t     m_a         = 0;
+	uint8_t     m_b         = 0;
+	uint8_t     m_flags     = 0;
+	uint16_t    m_parameter = ANIM_GRAPH_NO_PARAMETER;
+	uint16_t    m_reserved  = 0;
+	int32_t     m_index     = 0;
+	float       m_value     = 0.0f;
+};
+
+struct AnimGraphBlendPoint
+{
+public:
+	int32_t m_clip      = 0;
+	float   m_threshold = 0.0f;
+	float   m_duration  = 0.0f; // clip duration over its rate
+};
+
+struct AnimGraphState
+{
+public:
+	int32_t m_codeStart       = 0;
+	int32_t m_codeCount       = 0;
+	int32_t m_transitionStart = 0;
+	int32_t m_transitionCount = 0;
+	float   m_duration        = 0.0f; // longest clip of the tree, exit times are relative to it
+};
+
+struct AnimGraphTransition
+{
+public:
+	int32_t          m_target    = 0;
+	uint16_t         m_parameter = ANIM_GRAPH_NO_PARAMETER;
+	AnimGraphCompare m_compare   = AnimGraphCompare::ALWAYS;
+	float            m_threshold = 0.0f;
+	float            m_exitTime  = -1.0f;
+	float            m_duration  = 0.0f;
+};
+
+// a state machine whose states are blend trees, compiled against the clips of one library
+// each state is a postfix run of instructions over pose slots, slot indices are the tree depth so a state
+// needs as many slots as its deepest branch, and the evaluator gives every program a fixed slot count
+// programs are immutable once compiled and shared by every instance playing them
+class AnimGraphProgram
+{
+public:
+	bool Compile(const AnimGraphDesc& desc, const ClipLibraryRef& library, uint64_t skeletonHash, std::string& outError);
+
+	int FindParameter(const char* name) const; // -1 if missing
+	int FindState(const char* name) const;     // -1 if missing
+
+	int                GetParameterCount() const                { return (int)m_parameterNames.size(); }
+	float              GetParameterDefault(int parameter) const { return m_parameterDefaults[parameter]; }
+	int                GetStateCount() const                    { return (int)m_states.size(); }
+	const std::string& GetStateName(int state) const            { return m_stateNames[state]; }
+	int                GetEntryState() const                    { return m_entryState; }
+	int                GetSlotCount() const                     { return m_slotCount; } // per evaluated state
+	int                GetBoneCount() const                     { return m_boneCount; }
+	int                GetInstructionCount() const              { return (int)m_code.size(); }
+	uint64_t           GetSkeletonHash() const                  { return m_skeletonHash; }
+	size_t             GetBytes() const;
+
+private:
+	bool CompileNode(const AnimGraphNodeDesc& node, int slot, float& outDuration, std::string& outError);
+	int  AddClip(const std::string& name, std::string& outError);
+	bool ResolveParameter(const std::string& name, uint16_t& outParameter, std::string& outError) const;
+
+	friend class AnimGraphEvaluator;
+
+private:
+	std::vector<AnimGraphInstruction> m_code;
+	std::vector<AnimGraphBlendPoint>  m_blendPoints;
+	std::vector<AnimGraphState>       m_states;
+	std::vector<AnimGraphTransition>  m_transitions;   // grouped by source state, first match wins
+	std::vector<const AnimClip*>      m_clips;         // attached views into the library
+	std::vector<std::string>          m_parameterNames;
+	std::vector<float>                m_parameterDefaults;
+	std::vector<std::string>          m_stateNames;
+	int                               m_entryState = 0;
+	int                               m_slotCount  = 0;
+	int                               m_boneCount  = 0;
+	ClipLibraryRef                    m_library;       // keeps the clip keys alive
+	uint64_t                          m_skeletonHash = 0;
+};
+
+typedef std::shared_ptr<const AnimGraphProgram> AnimGraphRef;
+
+// one character, the parameter block plus where it is in the state machine
+class AnimGraphInstance
+{
+public:
+	explicit AnimGraphInstance(const AnimGraphRef& program);
+
+	void  Reset();
+	void  SetParameter(int parameter, float value) { m_parameters[parameter] = value; }
+	bool  SetParameter(const char* name, float value);
+	float GetParameter(int parameter) const        { return m_parameters[parameter]; }
+	int   GetState() const                         { return m_state; }
+	bool  IsInTransition() const                   { return m_prevState >= 0; }
+	const AnimGraphRef& GetProgram() const         { return m_program; }
+
+private:
+	friend class AnimGraphEvaluator;
+
+	AnimGraphRef       m_program;
+	std::vector<float> m_parameters;
+	int                m_state         = 0;
+	float              m_stateTime     = 0.0f;
+	int                m_prevState     = -1; // faded out over the transition, still advancing
+	float              m_prevStateTime = 0.0f;
+	float              m_blendTime     = 0.0f;
+	float              m_blendDuration = 0.0f;
+};
+
+// the vm, owns the scratch pose slots and reuses them for every instance it evaluates
+// keep one per thread, instances and programs are only read while a pose is produced
+class AnimGraphEvaluator
+{
+public:
+	void Evaluate(AnimGraphInstance& instance, float deltaSeconds, std::vector<TransformQuat>& outPose);
+
+private:
+	void UpdateStateMachine(const AnimGraphProgram& program, AnimGraphInstance& instance, float deltaSeconds) const;
+	void RunState(const AnimGraphProgram& program, const AnimGraphInstance& instance, int state, float stateTime, int slotBase);
+
+private:
+	std::vector<TransformQuat> m_slots; // [slot][bone]
+	int                        m_boneCount = 0;
+};
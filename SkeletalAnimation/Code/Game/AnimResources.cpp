@@ -0,0 +1,177 @@
+#include "AnimResources.hpp"
+#include "AnimClip.hpp"
+#include "GameCommon.hpp"
+
+#include "Engine/Animation/Animation.hpp"
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Renderer/IndexBuffer.hpp"
+#include "Engine/Renderer/Renderer.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <utility>
+
+extern std::vector<VertexFormat> g_SkeletalShaderLayout;
+
+ModelResource::ModelResource(LoadedModel& model)
+{
+	auto& layout = g_SkeletalShaderLayout;
+
+	m_name = model.m_name;
+	m_selection = model.m_selection;
+	m_mesh = model.m_mesh;
+	model.m_mesh = nullptr;
+	m_cookedMesh = std::move(model.m_cookedMesh);
+	m_streams = model.m_streams;
+	m_morphs = std::make_shared<const MorphTargetSet>(std::move(model.m_morphs));
+	m_submeshes.swap(model.m_submeshes);
+	m_lodSet = std::move(model.m_lodSet); // streams may point into its indices, a move keeps them in place
+	m_skeleton = std::move(model.m_skeleton);
+
+	const SkeletalMeshStreams& streams = m_streams;
+	size_t vertexCount = streams.m_vertexCount;
+
+	// one vbo per shader layout slot, colors are not stored in the asset
+	std::vector<Rgba8> colors;
+	colors.resize(vertexCount);
+	const void* slotData[] = { streams.m_positions, streams.m_normals, colors.data(), streams.m_uvs, streams.m_boneIds, streams.m_boneWeights };
+	for (int slot = 0; slot < (int)(sizeof(slotData) / sizeof(slotData[0])); slot++)
+	{
+		size_t size = vertexCount * layout[slot].GetVertexStride();
+		VertexBuffer* vbo = g_theRenderer->CreateVertexBuffer(size, &layout[slot]);
+		g_theRenderer->CopyCPUToGPU(slotData[slot], size, vbo);
+		m_vbos.push_back(vbo);
+		m_gpuBytes += size;
+	}
+
+	m_ibo = g_theRenderer->CreateIndexBuffer(sizeof(int) * streams.m_indexCount);
+	g_theRenderer->CopyCPUToGPU(streams.m_indices, sizeof(int) * streams.m_indexCount, m_ibo);
+	m_gpuBytes += sizeof(int) * streams.m_indexCount;
+
+	const unsigned int* lodIndices = static_cast<const unsigned int*>(streams.m_lodIndices);
+	for (auto& lod : m_lodSet.m_lods)
+	{
+		IndexBuffer* ibo = g_theRenderer->CreateIndexBuffer(sizeof(int) * lod.m_indexCount);
+		g_theRenderer->CopyCPUToGPU(lodIndices + lod.m_indexStart, sizeof(int) * lod.m_indexCount, ibo);
+		m_lodIbos.push_back(ibo);
+		m_gpuBytes += sizeof(int) * lod.m_indexCount;
+	}
+
+	// bounding sphere around the box center, used for screen size lod selection
+	Vec3 mins = vertexCount > 0 ? streams.m_positions[0] : Vec3();
+	Vec3 maxs = mins;
+	for (size_t vertIdx = 0; vertIdx < vertexCount; vertIdx++)
+	{
+		const Vec3& pos = streams.m_positions[vertIdx];
+		mins = Vec3(std::min(mins.x, pos.x), std::min(mins.y, pos.y), std::min(mins.z, pos.z));
+		maxs = Vec3(std::max(maxs.x, pos.x), std::max(maxs.y, pos.y), std::max(maxs.z, pos.z));
+	}
+	m_boundsCenter = (mins + maxs) * 0.5f;
+	for (size_t vertIdx = 0; vertIdx < vertexCount; vertIdx++)
+		m_boundsRadius = std::max(m_boundsRadius, (streams.m_positions[vertIdx] - m_boundsCenter).GetLengthSquared());
+	m_boundsRadius = sqrtf(m_boundsRadius);
+}
+
+ModelResource::~ModelResource()
+{
+	for (auto* vbo : m_vbos)
+		delete vbo;
+	m_vbos.clear();
+	delete m_ibo;
+	m_ibo = nullptr;
+	for (auto* ibo : m_lodIbos)
+		delete ibo;
+	m_lodIbos.clear();
+
+	delete m_mesh;
+	m_mesh = nullptr;
+	m_cookedMesh.Close();
+}
+
+size_t ModelResource::GetCpuBytes() const
+{
+	// streams used in place from a mapped cooked asset are the os's to page out, only decompressed ones count
+	size_t bytes = 0;
+	if (m_cookedMesh.IsOpen())
+	{
+		bytes = m_cookedMesh.GetOwnedBytes();
+	}
+	else
+	{
+		size_t vertexBytes = sizeof(Vec3) * 2
+			+ sizeof(m_mesh->m_uvs[0][0])
+			+ sizeof(m_mesh->m_boneIndices[0])
+			+ sizeof(m_mesh->m_boneWeights[0]);
+		bytes = vertexBytes * m_streams.m_vertexCount + sizeof(int) * (m_streams.m_indexCount + m_streams.m_lodIndexCount);
+	}
+
+	for (int targetIdx = 0; targetIdx < m_morphs->GetTargetCount(); targetIdx++)
+	{
+		const MorphTarget& target = m_morphs->GetTarget(targetIdx);
+		bytes += target.GetDeltaCount() * (sizeof(unsigned int) + sizeof(Vec4) * 2);
+	}
+	return bytes;
+}
+
+ClipResource::ClipResource(LoadedAnimation& animation)
+{
+	m_name = animation.m_name;
+	m_animation = animation.m_animation;
+	m_clip = animation.m_clip;
+	animation.m_animation = nullptr;
+	animation.m_clip = nullptr;
+	m_skeleton = std::move(animation.m_skeleton);
+}
+
+ClipResource::ClipResource(const ClipLibraryRef& library, int clipId, const std::string& name, const SkeletonRef& skeleton)
+{
+	m_name = name;
+	m_clip = new AnimClip(library->GetClip(clipId));
+	m_skeleton = skeleton;
+	m_library = library;
+}
+
+ClipResource::~ClipResource()
+{
+	delete m_animation;
+	m_animation = nullptr;
+	delete m_clip;
+	m_clip = nullptr;
+}
+
+size_t ClipResource::GetCpuBytes() const
+{
+	return m_clip->GetResidentBytes();
+}
+
+RetargetResource::RetargetResource(const SkeletonRef& sourceSkeleton, const RetargetMap& map)
+	: m_sourceSkeleton(sourceSkeleton)
+	, m_map(map)
+{
+}
+
+size_t RetargetResource::GetCpuBytes() const
+{
+	// the source skeleton is shared, counted by the skeleton registry
+	return m_map.GetTargetBoneCount() * sizeof(TransformQuat) * 2;
+}
+
+std::string MakeModelResourceId(const std::string& name, const MeshSelection& selection)
+{
+	if (selection.IsDefault())
+		return Stringf("SKEL/%s", name.c_str());
+	return Stringf("SKEL/%s/%s", name.c_str(), selection.GetSource().c_str());
+}
+
+std::string MakeClipResourceId(const std::string& name, const SkeletonAsset& skeleton)
+{
+	return Stringf("ANIM/%s/%016llx", name.c_str(), (unsigned long long)skeleton.m_hash);
+}
+
+std::string MakeRetargetResourceId(const std::string& animation, const SkeletonAsset& target)
+{
+	return Stringf("RTGT/%s/%016llx", animation.c_str(), (unsigned long long)target.m_hash);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ModelLoader.hpp"
+#include "ResourceManager.hpp"
+#include "RetargetMap.hpp"
+
+#include <string>
+#include <vector>
+
+class AnimClip;
+class Animation;
+class IndexBuffer;
+class SkeletalMesh;
+class VertexBuffer;
+
+// loaded model plus its gpu buffers, shared by every scene showing it
+class ModelResource : public Resource
+{
+public:
+	explicit ModelResource(LoadedModel& model); // takes the cpu data, creates gpu buffers, main thread only
+	ModelResource(const ModelResource& copyFrom) = delete;
+	virtual ~ModelResource();
+
+	virtual size_t GetCpuBytes() const override;
+	virtual size_t GetGpuBytes() const override { return m_gpuBytes; }
+
+	// lod 0 is the full index buffer, every lod draws with the same vbos
+	int          GetLodCount() const { return 1 + (int)m_lodIbos.size(); }
+	IndexBuffer* GetLodIbo(int lod) const { return lod == 0 ? m_ibo : m_lodIbos[lod - 1]; }
+	int          GetLodIndexCount(int lod) const { return lod == 0 ? (int)m_streams.m_indexCount : (int)m_lodSet.m_lods[lod - 1].m_indexCount; }
+
+public:
+	std::string                  m_name;
+	MeshSelection                m_selection;
+	SkeletalMesh*                m_mesh = nullptr;
+	CookedAssetView              m_cookedMesh; // owns the vertex streams, mapped in place or decompressed
+	SkeletalMeshStreams          m_streams;
+	MorphTargetSetRef            m_morphs;     // never null, scenes share it and keep their own MorphApplyState
+	std::vector<SkeletalSubmesh> m_submeshes;
+	SkeletalMeshLodSet           m_lodSet;     // lod 1 and up
+	SkeletonRef                  m_skeleton;
+	std::vector<VertexBuffer*>   m_vbos;
+	IndexBuffer*                 m_ibo = nullptr;
+	std::vector<IndexBuffer*>    m_lodIbos;
+	Vec3                         m_boundsCenter; // bind pose, mesh space
+	float                        m_boundsRadius = 0.0f;
+
+private:
+	size_t                       m_gpuBytes = 0;
+};
+
+class ClipResource : public Resource
+{
+public:
+	explicit ClipResource(LoadedAnimation& animation);
+	ClipResource(const ClipLibraryRef& library, int clipId, const std::string& name, const SkeletonRef& skeleton); // view into the library arena
+	ClipResource(const ClipResource& copyFrom) = delete;
+	virtual ~ClipResource();
+
+	virtual size_t GetCpuBytes() const override;
+	virtual size_t GetGpuBytes() const override { return 0; }
+
+public:
+	std::string m_name; // the animation file, what a reload requests again
+	Animation*  m_animation = nullptr; // played instead of the clip when loaded, see PLAY_ENGINE_ANIMATION
+	AnimClip*   m_clip = nullptr;
+	SkeletonRef m_skeleton;
+	ClipLibraryRef m_library; // owns the keys of library clips
+};
+
+// clips of one animation file played on another skeleton, the clip stays bound to the file's own skeleton
+class RetargetResource : public Resource
+{
+public:
+	RetargetResource(const SkeletonRef& sourceSkeleton, const RetargetMap& map);
+
+	virtual size_t GetCpuBytes() const override;
+	virtual size_t GetGpuBytes() const override { return 0; }
+
+public:
+	SkeletonRef m_sourceSkeleton;
+	RetargetMap m_map;
+};
+
+// ids match what LoadModelData and LoadAnimationData would produce, clips depend on the skeleton they are bound to
+std::string MakeModelResourceId(const std::string& name, const MeshSelection& selection);
+std::string MakeClipResourceId(const std::string& name, const SkeletonAsset& skeleton);
+std::string MakeRetargetResourceId(const std::string& animation, const SkeletonAsset& target);
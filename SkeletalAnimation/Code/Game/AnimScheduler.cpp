@@ -0,0 +1,99 @@
+#include "AnimScheduler.hpp"
+
+#include "Engine/Core/Time.hpp"
+
+#include <algorithm>
+
+constexpr float ANIM_SCHEDULER_COST_SMOOTHING = 0.2f; // weight of the newest measurement
+
+int AnimScheduler::Register(const UpdateFunction& update)
+{
+	int handle = (int)m_tasks.size();
+	if (!m_freeTasks.empty())
+	{
+		handle = m_freeTasks.back();
+		m_freeTasks.pop_back();
+	}
+	else
+	{
+		m_tasks.emplace_back();
+	}
+
+	Task& task = m_tasks[handle];
+	task = Task();
+	task.m_update = update;
+	task.m_isActive = true;
+	task.m_costMs = m_config.m_initialCostMs;
+	m_activeCount++;
+	return handle;
+}
+
+void AnimScheduler::Unregister(int handle)
+{
+	if (handle < 0 || handle >= (int)m_tasks.size() || !m_tasks[handle].m_isActive)
+		return;
+
+	m_tasks[handle] = Task();
+	m_freeTasks.push_back(handle);
+	m_activeCount--;
+}
+
+void AnimScheduler::Clear()
+{
+	m_tasks.clear();
+	m_freeTasks.clear();
+	m_order.clear();
+	m_activeCount = 0;
+	m_stats = AnimSchedulerStats();
+}
+
+void AnimScheduler::SetPriorityInputs(int handle, float distance, bool isVisible)
+{
+	Task& task = m_tasks[handle];
+	task.m_distance = distance;
+	task.m_isVisible = isVisible;
+}
+
+void AnimScheduler::RunFrame(float deltaSeconds)
+{
+	double frameStart = GetCurrentTimeSeconds();
+
+	// waiting time keeps raising the priority, so far and hidden characters still update, only less often
+	m_order.clear();
+	for (int handle = 0; handle < (int)m_tasks.size(); handle++)
+	{
+		Task& task = m_tasks[handle];
+		if (!task.m_isActive)
+			continue;
+
+		task.m_pendingSeconds += deltaSeconds;
+		float weight = task.m_isVisible ? 1.0f : m_config.m_hiddenWeight;
+		task.m_priority = task.m_pendingSeconds * weight / (1.0f + task.m_distance / m_config.m_distanceFalloff);
+		m_order.push_back(handle);
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](int a, int b) { return m_tasks[a].m_priority > m_tasks[b].m_priority; });
+
+	// the first update always runs so a budget smaller than one update still makes progress
+	m_stats = AnimSchedulerStats();
+	float usedMs = 0.0f;
+	for (int handle : m_order)
+	{
+		Task& task = m_tasks[handle];
+		if (m_stats.m_ranCount > 0 && usedMs + task.m_costMs > m_config.m_budgetMilliseconds)
+		{
+			m_stats.m_deferredCount++;
+			m_stats.m_maxPendingSeconds = std::max(m_stats.m_maxPendingSeconds, task.m_pendingSeconds);
+			continue;
+		}
+
+		double startTime = GetCurrentTimeSeconds();
+		task.m_update(task.m_pendingSeconds);
+		float costMs = (float)((GetCurrentTimeSeconds() - startTime) * 1000.0);
+
+		task.m_pendingSeconds = 0.0f;
+		task.m_costMs += (costMs - task.m_costMs) * ANIM_SCHEDULER_COST_SMOOTHING;
+		usedMs = (float)((GetCurrentTimeSeconds() - frameStart) * 1000.0);
+		m_stats.m_ranCount++;
+	}
+	m_stats.m_usedMilliseconds = usedMs;
+}
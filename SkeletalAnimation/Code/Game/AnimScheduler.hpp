@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// how a frame's animation budget is shared out
+struct AnimSchedulerConfig
+{
+public:
+	float m_budgetMilliseconds = 2.0f;
+	float m_distanceFalloff    = 500.0f; // priority halves at this distance from the camera
+	float m_hiddenWeight       = 0.25f;  // off screen updates count for this much of a visible one
+	float m_initialCostMs      = 0.05f;  // estimate for an update that has not run yet
+};
+
+// per frame stats of the last RunFrame
+struct AnimSchedulerStats
+{
+public:
+	int   m_ranCount          = 0;
+	int   m_deferredCount     = 0;
+	float m_usedMilliseconds  = 0.0f;
+	float m_maxPendingSeconds = 0.0f; // oldest update carried into the next frame
+};
+
+// time sliced animation updates under a fixed per frame budget
+// every registered update is ranked by how long it has waited, its distance and whether it is visible,
+// then updates run best first until the next one's measured cost would not fit, the rest wait a frame
+// an update receives all the time since it last ran, so a character that skipped frames catches up in one step
+// updates must not register or unregister while RunFrame is calling them
+class AnimScheduler
+{
+public:
+	typedef std::function<void(float deltaSeconds)> UpdateFunction;
+
+	int  Register(const UpdateFunction& update); // handle for the calls below
+	void Unregister(int handle);
+	void Clear();
+	void SetPriorityInputs(int handle, float distance, bool isVisible);
+
+	void RunFrame(float deltaSeconds);
+
+	void                       SetConfig(const AnimSchedulerConfig& config) { m_config = config; }
+	const AnimSchedulerConfig& GetConfig() const                           { return m_config; }
+	const AnimSchedulerStats&  GetStats() const                            { return m_stats; }
+	int                        GetTaskCount() const                        { return m_activeCount; }
+
+private:
+	struct Task
+	{
+	public:
+		UpdateFunction m_update;
+		float          m_distance       = 0.0f;
+		bool           m_isVisible      = true;
+		bool           m_isActive       = false;
+		float          m_pendingSeconds = 0.0f;
+		float          m_costMs         = 0.0f; // moving average of measured runs
+		float          m_priority       = 0.0f;
+	};
+
+	std::vector<Task>   m_tasks;     // by handle, unregistered slots are reused
+	std::vector<int>    m_freeTasks;
+	std::vector<int>    m_order;     // scratch, handles by priority
+	int                 m_activeCount = 0;
+	AnimSchedulerConfig m_config;
+	AnimSchedulerStats  m_stats;
+};
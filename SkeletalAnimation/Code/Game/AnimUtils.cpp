@@ -0,0 +1,146 @@
+#include "AnimUtils.hpp"
+
+#include "Engine/Animation/SkeletalMesh.hpp"
+
+#include <math.h>
+
+constexpr int SKIN_MAX_BONE_WEIGHTS = 4;
+
+Quaternion MultiplyQuaternions(const Quaternion& a, const Quaternion& b)
+{
+	return Quaternion(
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+Quaternion GetConjugate(const Quaternion& quat)
+{
+	return Quaternion(-quat.x, -quat.y, -quat.z, quat.w);
+}
+
+Quaternion GetNormalized(const Quaternion& quat)
+{
+	float length = sqrtf(DotProductQuat(quat, quat));
+	if (length == 0.0f)
+		return Quaternion();
+	float invLength = 1.0f / length;
+	return Quaternion(quat.x * invLength, quat.y * invLength, quat.z * invLength, quat.w * invLength);
+}
+
+Vec3 RotateVector(const Quaternion& quat, const Vec3& vec)
+{
+	// v' = v + 2w(q x v) + 2(q x (q x v))
+	Vec3 axis = Vec3(quat.x, quat.y, quat.z);
+	Vec3 t = CrossProduct3D(axis, vec) * 2.0f;
+	return vec + t * quat.w + CrossProduct3D(axis, t);
+}
+
+float DotProductQuat(const Quaternion& a, const Quaternion& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+Quaternion NlerpShortest(const Quaternion& a, const Quaternion& b, float t)
+{
+	float sign = DotProductQuat(a, b) < 0.0f ? -1.0f : 1.0f;
+	float s = 1.0f - t;
+	float u = t * sign;
+	return GetNormalized(Quaternion(a.x * s + b.x * u, a.y * s + b.y * u, a.z * s + b.z * u, a.w * s + b.w * u));
+}
+
+TransformQuat InterpolateTransform(const TransformQuat& a, const TransformQuat& b, float t)
+{
+	TransformQuat result;
+	result.m_position = a.m_position + (b.m_position - a.m_position) * t;
+	result.m_rotation = NlerpShortest(a.m_rotation, b.m_rotation, t);
+	result.m_scale = a.m_scale + (b.m_scale - a.m_scale) * t;
+	return result;
+}
+
+TransformQuat CombineTransform(const TransformQuat& parent, const TransformQuat& local)
+{
+	TransformQuat result;
+	Vec3 scaledPos = Vec3(local.m_position.x * parent.m_scale.x, local.m_position.y * parent.m_scale.y, local.m_position.z * parent.m_scale.z);
+	result.m_position = parent.m_position + RotateVector(parent.m_rotation, scaledPos);
+	result.m_rotation = MultiplyQuaternions(parent.m_rotation, local.m_rotation);
+	result.m_scale = Vec3(parent.m_scale.x * local.m_scale.x, parent.m_scale.y * local.m_scale.y, parent.m_scale.z * local.m_scale.z);
+	return result;
+}
+
+Mat4x4 GetTransformMatrix(const TransformQuat& transform)
+{
+	Mat4x4 mat;
+	mat.AppendTranslation3D(transform.m_position);
+	mat.Append(transform.m_rotation.GetMatrix());
+	mat.AppendScaleNonUniform3D(transform.m_scale);
+	return mat;
+}
+
+Mat4x4 GetInverseMatrix(const Mat4x4& mat)
+{
+	// cofactor expansion over the flat array, the transpose of the result is the inverse of the transpose,
+	// so it holds for either storage order
+	const float* m = mat.m_values;
+	float inv[16];
+	inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+	inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+	inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+	inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+	inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+	inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+	inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+	// a zero scale has no inverse, the bone then skins nothing either way
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0f)
+		return Mat4x4::IDENTITY;
+
+	Mat4x4 result;
+	float invDet = 1.0f / det;
+	for (int i = 0; i < 16; i++)
+		result.m_values[i] = inv[i] * invDet;
+	return result;
+}
+
+const Mat4x4* GetSkinningMatrices(const Pose& pose)
+{
+	return reinterpret_cast<const Mat4x4*>(pose.m_bakedPose.GetBuffer());
+}
+
+void SkinVertices(const SkeletalMesh& mesh, const Pose& pose, const Vec3* positions, const Vec3* normals, Vec3* outPositions, Vec3* outNormals)
+{
+	const Mat4x4* bones = GetSkinningMatrices(pose);
+	int vertexCount = (int)mesh.m_vertices.size();
+
+	for (int vertIdx = 0; vertIdx < vertexCount; vertIdx++)
+	{
+		// UB4 ids and FLOAT4 weights, same streams as the vertex buffers
+		const unsigned char* boneIds = reinterpret_cast<const unsigned char*>(&mesh.m_boneIndices[vertIdx]);
+		const float* boneWeights = reinterpret_cast<const float*>(&mesh.m_boneWeights[vertIdx]);
+
+		Vec3 skinnedPos;
+		Vec3 skinnedNrm;
+		for (int i = 0; i < SKIN_MAX_BONE_WEIGHTS; i++)
+		{
+			if (boneWeights[i] == 0.0f)
+				continue;
+			const Mat4x4& bone = bones[boneIds[i]];
+			skinnedPos += bone.TransformPosition3D(positions[vertIdx]) * boneWeights[i];
+			skinnedNrm += bone.TransformVectorQuantity3D(normals[vertIdx]) * boneWeights[i];
+		}
+
+		outPositions[vertIdx] = skinnedPos;
+		outNormals[vertIdx] = skinnedNrm;
+	}
+}
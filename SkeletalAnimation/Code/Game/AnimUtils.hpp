@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Engine/Animation/Quaternion.hpp"
+#include "Engine/Animation/Skeleton.hpp"
+#include "Engine/Math/Mat4x4.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+class SkeletalMesh;
+
+// quaternion helpers, rotations are unit quaternions
+Quaternion MultiplyQuaternions(const Quaternion& a, const Quaternion& b);
+Quaternion GetConjugate(const Quaternion& quat);
+Quaternion GetNormalized(const Quaternion& quat);
+Vec3       RotateVector(const Quaternion& quat, const Vec3& vec);
+float      DotProductQuat(const Quaternion& a, const Quaternion& b);
+Quaternion NlerpShortest(const Quaternion& a, const Quaternion& b, float t);
+
+// transform helpers matching the local -> component composition of Pose::BakeLocalToComp
+TransformQuat InterpolateTransform(const TransformQuat& a, const TransformQuat& b, float t);
+TransformQuat CombineTransform(const TransformQuat& parent, const TransformQuat& local);
+Mat4x4        GetTransformMatrix(const TransformQuat& transform);
+Mat4x4        GetInverseMatrix(const Mat4x4& mat); // general inverse, a rotated non uniform scale inverts to a shear
+
+// skinning palette as uploaded to SkeletonConstants (float4x4 Bone[ENGINE_SKEL_MAX_BONES]), written by Pose::BakeFromComp
+const Mat4x4* GetSkinningMatrices(const Pose& pose);
+
+// cpu version of TransformLocalToSkinned in SkeletalLit.hlsl, pose must be baked
+void SkinVertices(const SkeletalMesh& mesh, const Pose& pose, const Vec3* positions, const Vec3* normals, Vec3* outPositions, Vec3* outNormals);
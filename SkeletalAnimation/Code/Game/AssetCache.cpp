@@ -0,0 +1,260 @@
+#include "AssetCache.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Core/FileUtils.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+constexpr uint64_t COOKED_ENDIAN_MARKER = 0x01020304CAFEBADEULL;
+constexpr uint64_t FNV_PRIME_64         = 0x100000001b3ULL;
+
+constexpr const char* SOURCE_STAMP_PATH = "Content/Cooked/Assets/SourceStamps.txt";
+
+// cooked writes are rare and the import before them is what takes time, one lock for all of them is enough
+std::mutex               g_cookedWriteMutex;
+std::vector<std::string> g_pendingCookedSwaps; // cooked paths whose new version is still <path>.tmp
+
+// content hash of every source seen, reused while the file keeps its size and write time
+std::mutex                         g_sourceStampMutex;
+std::map<std::string, SourceStamp> g_sourceStamps;
+bool                               g_sourceStampsLoaded = false;
+bool                               g_sourceStampsDirty  = false; // hashed since the last save
+
+bool CookedAssetKey::operator==(const CookedAssetKey& other) const
+{
+	return m_importerVersion == other.m_importerVersion
+		&& m_contentHash == other.m_contentHash
+		&& m_sourcePath == other.m_sourcePath;
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	// FNV-1a
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t idx = 0; idx < size; idx++)
+	{
+		hash ^= bytes[idx];
+		hash *= FNV_PRIME_64;
+	}
+	return hash;
+}
+
+bool ReadSourceStamp(const char* filePath, SourceStamp& outStamp)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+	if (!GetFileAttributesExA(filePath, GetFileExInfoStandard, &attributes))
+		return false;
+	outStamp.m_size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	outStamp.m_writeTime = (int64_t)(((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat fileStat = {};
+	if (stat(filePath, &fileStat) != 0)
+		return false;
+	outStamp.m_size = (uint64_t)fileStat.st_size;
+	outStamp.m_writeTime = (int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+static void LoadSourceStamps()
+{
+	g_sourceStampsLoaded = true;
+	std::string text;
+	if (FileReadToString(text, SOURCE_STAMP_PATH) < 0)
+		return;
+
+	std::vector<std::string> lines = SplitStringOnDelimiter(text, '\n');
+	if (lines.empty() || atoi(lines[0].c_str()) != (int)ASSET_IMPORTER_VERSION)
+		return;
+
+	// "<size> <write time> <hash> <path>", the path last since it may hold spaces
+	for (size_t lineIdx = 1; lineIdx < lines.size(); lineIdx++)
+	{
+		SourceStamp stamp;
+		unsigned long long size = 0;
+		long long writeTime = 0;
+		unsigned long long hash = 0;
+		int pathStart = 0;
+		if (sscanf(lines[lineIdx].c_str(), "%llu %lld %llx %n", &size, &writeTime, &hash, &pathStart) < 3 || pathStart <= 0 || pathStart >= (int)lines[lineIdx].size())
+			continue;
+
+		stamp.m_size = size;
+		stamp.m_writeTime = writeTime;
+		stamp.m_hash = hash;
+		g_sourceStamps[lines[lineIdx].substr(pathStart)] = stamp;
+	}
+}
+
+void AssetCache::SaveSourceStamps()
+{
+	// written straight over the old file, a torn file just costs one more hash per source
+	std::string text;
+	{
+		std::lock_guard<std::mutex> lock(g_sourceStampMutex);
+		if (!g_sourceStampsDirty)
+			return;
+		g_sourceStampsDirty = false;
+
+		text = Stringf("%u\n", ASSET_IMPORTER_VERSION);
+		for (auto& entry : g_sourceStamps)
+			text += Stringf("%llu %lld %llx %s\n", (unsigned long long)entry.second.m_size, (long long)entry.second.m_writeTime, (unsigned long long)entry.second.m_hash, entry.first.c_str());
+	}
+
+	ByteBuffer buffer;
+	buffer.m_data.assign(text.begin(), text.end());
+	FileWriteFromBuffer(buffer, SOURCE_STAMP_PATH);
+}
+
+uint64_t HashFileContents(const char* filePath)
+{
+	SourceStamp stamp;
+	if (!ReadSourceStamp(filePath, stamp))
+		return 0;
+
+	{
+		std::lock_guard<std::mutex> lock(g_sourceStampMutex);
+		if (!g_sourceStampsLoaded)
+			LoadSourceStamps();
+		auto found = g_sourceStamps.find(filePath);
+		if (found != g_sourceStamps.end() && found->second.m_size == stamp.m_size && found->second.m_writeTime == stamp.m_writeTime)
+			return found->second.m_hash;
+	}
+
+	ByteBuffer contents;
+	if (FileReadToBuffer(contents, filePath) < 0)
+		return 0;
+	uint64_t hash = HashBytes(contents.m_data.data(), contents.m_data.size());
+
+	// a file still being written is hashed again next time
+	SourceStamp after;
+	if (!ReadSourceStamp(filePath, after) || after.m_size != stamp.m_size || after.m_writeTime != stamp.m_writeTime)
+		return hash;
+
+	stamp.m_hash = hash;
+	std::lock_guard<std::mutex> lock(g_sourceStampMutex);
+	g_sourceStamps[filePath] = stamp;
+	g_sourceStampsDirty = true;
+	return hash;
+}
+
+uint64_t HashSkeleton(const Skeleton& skeleton)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto& bone : skeleton)
+	{
+		hash = HashBytes(bone.m_name.data(), bone.m_name.size(), hash);
+		hash = HashBytes(&bone.m_parentId, sizeof(bone.m_parentId), hash);
+	}
+	return hash;
+}
+
+std::string AssetCache::GetCookedPath(const char* prefix, const char* name)
+{
+	return Stringf("Content/Cooked/Assets/%s_%s.asset", prefix, name);
+}
+
+CookedAssetKey AssetCache::MakeKey(const char* sourcePath, uint64_t dependencyHash)
+{
+	CookedAssetKey key;
+	key.m_sourcePath = sourcePath;
+	key.m_contentHash = HashFileContents(sourcePath);
+	if (dependencyHash != 0)
+		key.m_contentHash = HashBytes(&dependencyHash, sizeof(dependencyHash), key.m_contentHash);
+	return key;
+}
+
+bool AssetCache::ReadCooked(const std::string& cookedPath, const CookedAssetKey& key, ByteBuffer& buffer)
+{
+	if (key.m_contentHash == 0)
+		return false; // source missing, nothing to validate against
+
+	if (FileReadToBuffer(buffer, cookedPath) < 0)
+		return false;
+
+	uint64_t endian = 0;
+	buffer.Read(endian);
+	if (endian != COOKED_ENDIAN_MARKER)
+		return false;
+
+	CookedAssetKey cookedKey;
+	buffer.Read(cookedKey.m_importerVersion);
+	if (cookedKey.m_importerVersion != key.m_importerVersion)
+		return false;
+	buffer.Read(cookedKey.m_contentHash);
+	cookedKey.m_sourcePath = buffer.ReadString();
+
+	return cookedKey == key;
+}
+
+void AssetCache::BeginCooked(const CookedAssetKey& key, ByteBuffer& buffer)
+{
+	uint64_t endian = COOKED_ENDIAN_MARKER;
+	buffer.Write(endian); // endianness identifier
+	buffer.Write(key.m_importerVersion);
+	buffer.Write(key.m_contentHash);
+	buffer.WriteString(key.m_sourcePath);
+}
+
+static bool SwapInCookedFile(const std::string& cookedPath)
+{
+	std::error_code error;
+	std::filesystem::rename(cookedPath + ".tmp", cookedPath, error);
+	return !error;
+}
+
+bool AssetCache::WriteCooked(const std::string& cookedPath, ByteBuffer& buffer)
+{
+	std::lock_guard<std::mutex> lock(g_cookedWriteMutex);
+
+	std::string tempPath = cookedPath + ".tmp";
+	std::error_code error;
+	if (FileWriteFromBuffer(buffer, tempPath) < 0 || std::filesystem::file_size(tempPath, error) != buffer.m_data.size() || error)
+	{
+		DebuggerPrintf(Stringf("[COOK] %s: write failed, keeping the old file\n", cookedPath.c_str()).c_str());
+		std::filesystem::remove(tempPath, error);
+		g_pendingCookedSwaps.erase(std::remove(g_pendingCookedSwaps.begin(), g_pendingCookedSwaps.end(), cookedPath), g_pendingCookedSwaps.end());
+		return false;
+	}
+
+	if (SwapInCookedFile(cookedPath))
+	{
+		g_pendingCookedSwaps.erase(std::remove(g_pendingCookedSwaps.begin(), g_pendingCookedSwaps.end(), cookedPath), g_pendingCookedSwaps.end());
+		return true;
+	}
+
+	if (std::find(g_pendingCookedSwaps.begin(), g_pendingCookedSwaps.end(), cookedPath) == g_pendingCookedSwaps.end())
+	{
+		DebuggerPrintf(Stringf("[COOK] %s: in use, replaced once released\n", cookedPath.c_str()).c_str());
+		g_pendingCookedSwaps.push_back(cookedPath);
+	}
+	return true;
+}
+
+int AssetCache::CommitPendingWrites()
+{
+	std::lock_guard<std::mutex> lock(g_cookedWriteMutex);
+	if (g_pendingCookedSwaps.empty())
+		return 0;
+
+	size_t pendingCount = g_pendingCookedSwaps.size();
+	g_pendingCookedSwaps.erase(std::remove_if(g_pendingCookedSwaps.begin(), g_pendingCookedSwaps.end(), SwapInCookedFile), g_pendingCookedSwaps.end());
+	return (int)(pendingCount - g_pendingCookedSwaps.size());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+class ByteBuffer;
+class Skeleton;
+
+// bump whenever import settings or cooked payload layout change, every cooked asset is then re-imported
+constexpr uint32_t ASSET_IMPORTER_VERSION = 4;
+
+struct CookedAssetKey
+{
+public:
+	std::string m_sourcePath;
+	uint64_t    m_contentHash     = 0;
+	uint32_t    m_importerVersion = ASSET_IMPORTER_VERSION;
+
+public:
+	bool operator==(const CookedAssetKey& other) const;
+};
+
+// size and last write time of a source, with the content hash they were last seen with
+struct SourceStamp
+{
+public:
+	uint64_t m_size      = 0;
+	int64_t  m_writeTime = 0;
+	uint64_t m_hash      = 0;
+};
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+uint64_t HashFileContents(const char* filePath); // remembered across runs, hashed again only once size or write time change
+uint64_t HashSkeleton(const Skeleton& skeleton);
+bool     ReadSourceStamp(const char* filePath, SourceStamp& outStamp); // size and write time only, the hash is left alone
+
+// cooked assets live next to each other as <prefix>_<name>.asset, keyed by source path + content hash + importer version
+class AssetCache
+{
+public:
+	static std::string    GetCookedPath(const char* prefix, const char* name);
+	static CookedAssetKey MakeKey(const char* sourcePath, uint64_t dependencyHash = 0);
+
+	// on success the buffer read cursor is left at the start of the payload
+	static bool ReadCooked(const std::string& cookedPath, const CookedAssetKey& key, ByteBuffer& buffer);
+	static void BeginCooked(const CookedAssetKey& key, ByteBuffer& buffer);
+
+	// written to a temp file and renamed over the old one, so a reader sees either file whole and a live mapping
+	// keeps its contents, writers from every thread are serialized
+	// if the old file is still mapped where that blocks the rename (windows), the new file waits as <path>.tmp
+	// until CommitPendingWrites gets it through, false only if the new file could not be written at all
+	static bool WriteCooked(const std::string& cookedPath, ByteBuffer& buffer);
+	static int  CommitPendingWrites(); // main thread, once per frame after resources were swapped
+
+	// source stamps hashed since the last save, once per frame and after a cook rather than per hash
+	static void SaveSourceStamps();
+};
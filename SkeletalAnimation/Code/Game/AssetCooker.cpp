@@ -0,0 +1,589 @@
+#include "AssetCooker.hpp"
+#include "AnimClip.hpp"
+#include "CookedAsset.hpp"
+#include "MeshSimplifier.hpp"
+#include "ModelLoader.hpp"
+#include "MorphTarget.hpp"
+#include "ParallelFor.hpp"
+#include "VertexAnimation.hpp"
+
+#include "Engine/Animation/Animation.hpp"
+#include "Engine/Animation/AssetImporter.hpp"
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Time.hpp"
+
+#include "ThirdParty/assimp/Importer.hpp"
+#include "ThirdParty/assimp/scene.h"
+#include "ThirdParty/assimp/postprocess.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+constexpr const char* COOK_MANIFEST_PATH    = "Content/Cooked/Assets/CookManifest.txt";
+constexpr int         COOK_MANIFEST_VERSION = 3; // 2: anim and vat outputs per model, 3: skeleton hash of the anim output
+
+// must produce the same meshes and vertex order as AssimpRes::LoadMesh, checked per mesh by vertex count
+constexpr unsigned int MESH_SCAN_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_LimitBoneWeights;
+
+MeshSelection::MeshSelection(const std::string& selection)
+	: m_source(selection)
+{
+	for (auto& token : SplitStringOnDelimiter(selection, ','))
+	{
+		if (token == "*")
+			m_all = true;
+		else if (!token.empty() && token.find_first_not_of("0123456789") == std::string::npos)
+			m_indices.push_back(atoi(token.c_str()));
+		else if (!token.empty())
+			m_names.push_back(token);
+	}
+}
+
+bool MeshSelection::IsSelected(int index, const std::string& name) const
+{
+	if (IsDefault())
+		return index == 0;
+
+	return m_all
+		|| std::find(m_indices.begin(), m_indices.end(), index) != m_indices.end()
+		|| std::find(m_names.begin(), m_names.end(), name) != m_names.end();
+}
+
+template<typename T>
+void AppendStream(std::vector<T>& dst, const std::vector<T>& src)
+{
+	dst.insert(dst.end(), src.begin(), src.end());
+}
+
+// one convention for every AssimpRes import, AnimClip::ImportFrom reads assimp's space directly and only keeps
+// a clip whose nodes reproduce the bind pose of a skeleton imported through here
+void SetImportSpaceConventions(AssimpRes& aiRes)
+{
+	aiRes.SetSpaceConventions(Mat4x4(Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3::ZERO)); // no conversion
+}
+
+// topmost node above a mesh's bones, meshes bound to different rigs hang below different roots
+const aiNode* FindSkeletonRoot(const aiScene& scene, const aiMesh& mesh)
+{
+	if (mesh.mNumBones == 0)
+		return nullptr;
+
+	const aiNode* node = scene.mRootNode->FindNode(mesh.mBones[0]->mName.C_Str());
+	while (node && node->mParent && node->mParent != scene.mRootNode)
+		node = node->mParent;
+	return node;
+}
+
+void RejectMesh(const char* filePath, const std::string& reason, std::vector<std::string>& outRejected)
+{
+	DebuggerPrintf(Stringf("[IMPORT] %s: %s\n", filePath, reason.c_str()).c_str());
+	outRejected.push_back(reason);
+}
+
+SkeletalMesh* ImportSkeletalMesh(const char* filePath, const MeshSelection& selection, MorphTargetSet& outMorphs, std::vector<SkeletalSubmesh>& outSubmeshes, std::vector<std::string>& outRejected)
+{
+	outSubmeshes.clear();
+	outRejected.clear();
+
+	// the selection and the rig check run on assimp's scene first, the same scene then feeds the morph targets
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(filePath, MESH_SCAN_IMPORT_FLAGS);
+	if (!scene || !scene->mRootNode)
+		return nullptr;
+
+	for (auto& name : selection.GetNames())
+	{
+		bool isFound = false;
+		for (unsigned int meshIdx = 0; meshIdx < scene->mNumMeshes && !isFound; meshIdx++)
+			isFound = name == scene->mMeshes[meshIdx]->mName.C_Str();
+		if (!isFound)
+			RejectMesh(filePath, Stringf("no mesh named %s", name.c_str()), outRejected);
+	}
+	for (int index : selection.GetIndices())
+	{
+		if (index >= (int)scene->mNumMeshes)
+			RejectMesh(filePath, Stringf("no mesh %d, the file has %u", index, scene->mNumMeshes), outRejected);
+	}
+
+	// scene index of every kept mesh, the converted meshes are matched by it, names may repeat
+	std::vector<int> sourceMeshes;
+	const aiNode* skeletonRoot = nullptr;
+	for (unsigned int meshIdx = 0; meshIdx < scene->mNumMeshes; meshIdx++)
+	{
+		const aiMesh* aiMeshSrc = scene->mMeshes[meshIdx];
+		if (!selection.IsSelected((int)meshIdx, aiMeshSrc->mName.C_Str()))
+			continue;
+
+		// bone ids index the same palette only if the meshes share one rig
+		const aiNode* root = FindSkeletonRoot(*scene, *aiMeshSrc);
+		if (!sourceMeshes.empty() && root != skeletonRoot)
+		{
+			RejectMesh(filePath, Stringf("mesh %u %s is bound to another skeleton, skipped", meshIdx, aiMeshSrc->mName.C_Str()), outRejected);
+			continue;
+		}
+
+		skeletonRoot = root;
+		sourceMeshes.push_back((int)meshIdx);
+	}
+
+	if (sourceMeshes.empty())
+	{
+		RejectMesh(filePath, "no mesh selected", outRejected);
+		return nullptr;
+	}
+
+	// AssimpRes takes no selection and converts every mesh of the file, one per scene mesh in scene order
+	AssimpRes aiRes(filePath);
+	SetImportSpaceConventions(aiRes);
+	auto meshes = aiRes.LoadMesh();
+
+	std::vector<SkeletalMesh*> selected(sourceMeshes.size(), nullptr);
+	for (int meshIdx = 0; meshIdx < (int)meshes.size(); meshIdx++)
+	{
+		auto kept = std::find(sourceMeshes.begin(), sourceMeshes.end(), meshIdx);
+		if (kept != sourceMeshes.end() && meshIdx < (int)scene->mNumMeshes && meshes[meshIdx]->m_vertices.size() == scene->mMeshes[meshIdx]->mNumVertices)
+			selected[kept - sourceMeshes.begin()] = meshes[meshIdx];
+		else
+			delete meshes[meshIdx];
+	}
+
+	// merged into the first kept mesh, the skeleton hash backs up the rig check on the scene
+	SkeletalMesh* merged = nullptr;
+	uint64_t skeletonHash = 0;
+	std::vector<int> mergedSources;
+	for (size_t keptIdx = 0; keptIdx < selected.size(); keptIdx++)
+	{
+		SkeletalMesh* mesh = selected[keptIdx];
+		if (!mesh)
+		{
+			RejectMesh(filePath, Stringf("mesh %d was not converted in scene order, skipped", sourceMeshes[keptIdx]), outRejected);
+			continue;
+		}
+		if (merged && HashSkeleton(mesh->m_skeleton) != skeletonHash)
+		{
+			RejectMesh(filePath, Stringf("mesh %d %s has a different skeleton, skipped", sourceMeshes[keptIdx], mesh->m_name.c_str()), outRejected);
+			delete mesh;
+			continue;
+		}
+
+		if (!merged)
+		{
+			merged = mesh;
+			skeletonHash = HashSkeleton(merged->m_skeleton);
+		}
+
+		SkeletalSubmesh& submesh = outSubmeshes.emplace_back();
+		submesh.m_name = mesh->m_name;
+		submesh.m_vertexStart = mesh != merged ? (int)merged->m_vertices.size() : 0;
+		submesh.m_vertexCount = (int)mesh->m_vertices.size();
+		submesh.m_indexStart = mesh != merged ? (int)merged->m_indices.size() : 0;
+		submesh.m_indexCount = (int)mesh->m_indices.size();
+		mergedSources.push_back(sourceMeshes[keptIdx]);
+
+		if (mesh == merged)
+			continue;
+
+		AppendStream(merged->m_vertices, mesh->m_vertices);
+		AppendStream(merged->m_normals, mesh->m_normals);
+		AppendStream(merged->m_uvs[0], mesh->m_uvs[0]);
+		AppendStream(merged->m_boneIndices, mesh->m_boneIndices);
+		AppendStream(merged->m_boneWeights, mesh->m_boneWeights);
+		for (auto index : mesh->m_indices)
+			merged->m_indices.push_back(index + submesh.m_vertexStart);
+
+		delete mesh;
+	}
+
+	if (merged)
+		outMorphs.Import(*scene, *merged, outSubmeshes, mergedSources);
+	return merged;
+}
+
+Animation* ImportAnimation(const char* filePath, const Skeleton& skeleton)
+{
+	AssimpRes aiRes(filePath);
+	SetImportSpaceConventions(aiRes);
+
+	auto animations = aiRes.LoadAnimation(skeleton);
+	if (animations.empty())
+		return nullptr;
+
+	Animation* animation = animations[0];
+	for (auto& other : animations)
+	{
+		if (other != animation)
+			delete other;
+	}
+	return animation;
+}
+
+bool ImportAnimationClip(const char* filePath, const Skeleton& skeleton, AnimClip& outClip)
+{
+	// clip files usually share the loaded skeleton, then their mesh is never built
+	if (outClip.ImportFrom(filePath, skeleton))
+		return true;
+
+	Animation* animation = ImportAnimation(filePath, skeleton);
+	if (!animation)
+		return false;
+
+	// the engine's animation does not keep its key times, sampled at a fixed rate
+	outClip.BakeFrom(*animation, skeleton, CLIP_FALLBACK_TPS);
+	delete animation;
+	return true;
+}
+
+bool WriteCookedClip(const std::string& cookedPath, const CookedAssetKey& key, const AnimClip& clip)
+{
+	CookedAssetWriter writer;
+	clip.WriteCooked(writer);
+	return writer.Write(cookedPath, key);
+}
+
+bool ReadCookedClip(const std::string& cookedPath, const CookedAssetKey& key, AnimClip& outClip)
+{
+	// keys are decoded out of the view, so an older container is read as is and rewritten in the current one
+	CookedAssetView view;
+	if (view.Open(cookedPath, key))
+	{
+		bool isCurrent = view.IsCurrentVersion();
+		if (!outClip.ReadCooked(std::move(view)))
+			return false;
+		if (!isCurrent)
+		{
+			WriteCookedClip(cookedPath, key, outClip);
+			DebuggerPrintf(Stringf("[COOK] %s: upgraded to container v%u\n", cookedPath.c_str(), COOKED_ASSET_VERSION).c_str());
+		}
+		return true;
+	}
+
+	// clips used to be a plain ByteBuffer behind the cache header, still valid if the source did not change
+	ByteBuffer buffer;
+	if (!AssetCache::ReadCooked(cookedPath, key, buffer))
+		return false;
+
+	outClip.ReadBytes(&buffer);
+	WriteCookedClip(cookedPath, key, outClip);
+	DebuggerPrintf(Stringf("[COOK] %s: upgraded to sectioned clip\n", cookedPath.c_str()).c_str());
+	return true;
+}
+
+bool WriteCookedVertexAnimation(const std::string& cookedPath, const CookedAssetKey& key, const VertexAnimation& vat)
+{
+	ByteBuffer buffer;
+	AssetCache::BeginCooked(key, buffer);
+	vat.WriteBytes(&buffer);
+	return AssetCache::WriteCooked(cookedPath, buffer);
+}
+
+bool ReadCookedVertexAnimation(const std::string& cookedPath, const CookedAssetKey& key, VertexAnimation& outVat)
+{
+	ByteBuffer buffer;
+	if (!AssetCache::ReadCooked(cookedPath, key, buffer))
+		return false;
+
+	outVat.ReadBytes(&buffer);
+	return true;
+}
+
+bool IsModelSourceExtension(const std::string& extension)
+{
+	return extension.size() == 4 && std::equal(extension.begin(), extension.end(), ".fbx", [](char ca, char cb) { return tolower((unsigned char)ca) == cb; });
+}
+
+std::string FindModelSourcePath(const std::string& sourceDir, const std::string& name)
+{
+	std::string path = Stringf("%s/%s.FBX", sourceDir.c_str(), name.c_str());
+	std::error_code error;
+	if (std::filesystem::exists(path, error))
+		return path;
+
+	for (auto& entry : std::filesystem::directory_iterator(sourceDir, error))
+	{
+		if (entry.path().stem().string() == name && IsModelSourceExtension(entry.path().extension().string()))
+			return Stringf("%s/%s", sourceDir.c_str(), entry.path().filename().string().c_str());
+	}
+	return path; // missing, the caller fails to open it
+}
+
+size_t GetFileSizeOrZero(const std::string& path)
+{
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	return error ? 0 : (size_t)size;
+}
+
+AssetCooker::AssetCooker(const AssetCookerConfig& config)
+	: m_config(config)
+{
+}
+
+int AssetCooker::Run()
+{
+	double startTime = GetCurrentTimeSeconds();
+
+	m_results.clear();
+	std::error_code error;
+	for (auto& entry : std::filesystem::directory_iterator(m_config.m_sourceDir, error))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		if (!IsModelSourceExtension(entry.path().extension().string()))
+			continue;
+
+		AssetCookResult& result = m_results.emplace_back();
+		result.m_name = entry.path().stem().string();
+		result.m_sourcePath = FindModelSourcePath(m_config.m_sourceDir, result.m_name); // same path the scene keys with
+		result.m_sourceBytes = (size_t)entry.file_size();
+	}
+
+	// biggest first so one large model does not end up alone at the tail of the pool
+	std::sort(m_results.begin(), m_results.end(), [](const AssetCookResult& a, const AssetCookResult& b) { return a.m_sourceBytes > b.m_sourceBytes; });
+
+	LoadManifest();
+	std::filesystem::create_directories(std::filesystem::path(COOK_MANIFEST_PATH).parent_path(), error);
+
+	m_threadCount = m_config.m_threadCount > 0 ? m_config.m_threadCount : (int)std::thread::hardware_concurrency();
+	m_threadCount = std::max(1, std::min(m_threadCount, (int)m_results.size()));
+
+	std::atomic<size_t> nextJob(0);
+	std::mutex printLock;
+	auto worker = [&]()
+	{
+		for (size_t jobIdx = nextJob++; jobIdx < m_results.size(); jobIdx = nextJob++)
+		{
+			AssetCookResult& result = m_results[jobIdx];
+			CookAsset(result);
+
+			std::lock_guard<std::mutex> lock(printLock);
+			const char* status = result.m_status == AssetCookResult::Status::COOKED ? "cooked" : result.m_status == AssetCookResult::Status::UP_TO_DATE ? "up to date" : "FAILED";
+			printf("[COOK] %-32s %-10s %8.2fs %s\n", result.m_name.c_str(), status, result.m_seconds, result.m_error.c_str());
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int threadIdx = 1; threadIdx < m_threadCount; threadIdx++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	SaveManifest();
+	AssetCache::SaveSourceStamps();
+	m_wallSeconds = GetCurrentTimeSeconds() - startTime;
+
+	int failures = 0;
+	for (auto& result : m_results)
+		failures += result.m_status == AssetCookResult::Status::FAILED ? 1 : 0;
+	return failures;
+}
+
+void AssetCooker::CookAsset(AssetCookResult& result) const
+{
+	double startTime = GetCurrentTimeSeconds();
+
+	std::string meshPath = AssetCache::GetCookedPath("SKEL", result.m_name.c_str());
+	std::string vatPath = AssetCache::GetCookedPath("VAT", result.m_name.c_str());
+	CookedAssetKey meshKey = AssetCache::MakeKey(result.m_sourcePath.c_str());
+	result.m_sourceHash = meshKey.m_contentHash;
+
+	const ManifestEntry* upToDate = m_config.m_force ? nullptr : FindUpToDateEntry(result);
+	if (upToDate)
+	{
+		result.m_status = AssetCookResult::Status::UP_TO_DATE;
+		result.m_meshBytes = GetFileSizeOrZero(meshPath);
+		result.m_skeletonHash = upToDate->m_skeletonHash;
+		result.m_animBytes = upToDate->m_hasAnim ? GetFileSizeOrZero(GetCookedClipPath(result.m_name, upToDate->m_skeletonHash)) : 0;
+		result.m_vatBytes = upToDate->m_vatTps > 0.0f ? GetFileSizeOrZero(vatPath) : 0;
+		result.m_vatTps = upToDate->m_vatTps;
+		result.m_seconds = GetCurrentTimeSeconds() - startTime;
+		return;
+	}
+
+	MorphTargetSet morphs;
+	std::vector<SkeletalSubmesh> submeshes;
+	SkeletalMesh* mesh = ImportSkeletalMesh(result.m_sourcePath.c_str(), MeshSelection(), morphs, submeshes, result.m_rejectedMeshes);
+	if (!mesh)
+	{
+		result.m_status = AssetCookResult::Status::FAILED;
+		result.m_error = "no mesh in model file";
+		result.m_seconds = GetCurrentTimeSeconds() - startTime;
+		return;
+	}
+
+	SkeletalMeshLodSet lods;
+	GenerateMeshLods(SkeletalMeshStreams::FromMesh(*mesh), lods);
+	if (WriteCookedMesh(meshPath, meshKey, *mesh, morphs, submeshes, lods, m_config.m_compressStreams))
+		result.m_meshBytes = GetFileSizeOrZero(meshPath);
+
+	// animations are keyed against the skeleton of the model they ship with, same as SceneSkelAnim::LoadAnimation
+	AnimClip clip;
+	if (ImportAnimationClip(result.m_sourcePath.c_str(), mesh->m_skeleton, clip))
+	{
+		result.m_skeletonHash = HashSkeleton(mesh->m_skeleton);
+		std::string animPath = GetCookedClipPath(result.m_name, result.m_skeletonHash);
+		CookedAssetKey animKey = AssetCache::MakeKey(result.m_sourcePath.c_str(), result.m_skeletonHash);
+		if (WriteCookedClip(animPath, animKey, clip))
+			result.m_animBytes = GetFileSizeOrZero(animPath);
+
+		// same key as the clip, the bake depends on the same source and skeleton
+		if (m_config.m_bakeVertexAnimation)
+		{
+			VertexAnimation vat;
+			vat.BakeFrom(*mesh, clip, m_config.m_vertexAnimationTps);
+			if (WriteCookedVertexAnimation(vatPath, animKey, vat))
+			{
+				result.m_vatBytes = GetFileSizeOrZero(vatPath);
+				result.m_vatTps = m_config.m_vertexAnimationTps;
+			}
+		}
+	}
+
+	delete mesh;
+
+	result.m_status = result.m_meshBytes > 0 ? AssetCookResult::Status::COOKED : AssetCookResult::Status::FAILED;
+	if (result.m_status == AssetCookResult::Status::FAILED)
+		result.m_error = "could not write cooked asset";
+	result.m_seconds = GetCurrentTimeSeconds() - startTime;
+}
+
+const AssetCooker::ManifestEntry* AssetCooker::FindUpToDateEntry(const AssetCookResult& result) const
+{
+	if (result.m_sourceHash == 0)
+		return nullptr;
+
+	for (auto& entry : m_manifest)
+	{
+		if (entry.m_name != result.m_name)
+			continue;
+		if (entry.m_sourceHash != result.m_sourceHash || GetFileSizeOrZero(AssetCache::GetCookedPath("SKEL", result.m_name.c_str())) == 0)
+			return nullptr;
+
+		// every output the last cook wrote has to be there still, and a vat asked for now has to match the one baked
+		if (entry.m_hasAnim && GetFileSizeOrZero(GetCookedClipPath(result.m_name, entry.m_skeletonHash)) == 0)
+			return nullptr;
+		if (m_config.m_bakeVertexAnimation && entry.m_hasAnim)
+		{
+			if (entry.m_vatTps != m_config.m_vertexAnimationTps || GetFileSizeOrZero(AssetCache::GetCookedPath("VAT", result.m_name.c_str())) == 0)
+				return nullptr;
+		}
+		return &entry;
+	}
+	return nullptr;
+}
+
+void AssetCooker::LoadManifest()
+{
+	m_manifest.clear();
+
+	std::ifstream file(COOK_MANIFEST_PATH);
+	if (!file)
+		return;
+
+	// first line is the importer and manifest version, a mismatch invalidates every entry
+	std::string line;
+	unsigned int importerVersion = 0;
+	int manifestVersion = 0;
+	if (!std::getline(file, line) || !(std::istringstream(line) >> importerVersion >> manifestVersion))
+		return;
+	if (importerVersion != ASSET_IMPORTER_VERSION || manifestVersion != COOK_MANIFEST_VERSION)
+		return;
+
+	while (std::getline(file, line))
+	{
+		ManifestEntry entry;
+		int hasAnim = 0;
+		if (std::istringstream(line) >> entry.m_name >> std::hex >> entry.m_sourceHash >> std::dec >> hasAnim >> entry.m_vatTps >> std::hex >> entry.m_skeletonHash)
+		{
+			entry.m_hasAnim = hasAnim != 0;
+			m_manifest.push_back(entry);
+		}
+	}
+}
+
+void AssetCooker::SaveManifest() const
+{
+	std::ofstream file(COOK_MANIFEST_PATH);
+	if (!file)
+		return;
+
+	file << ASSET_IMPORTER_VERSION << " " << COOK_MANIFEST_VERSION << "\n";
+	for (auto& result : m_results)
+	{
+		if (result.m_status != AssetCookResult::Status::FAILED)
+			file << result.m_name << " " << std::hex << result.m_sourceHash << std::dec << " " << (result.m_animBytes > 0 ? 1 : 0) << " " << result.m_vatTps << " " << std::hex << result.m_skeletonHash << std::dec << "\n";
+	}
+}
+
+void AssetCooker::PrintReport() const
+{
+	int cooked = 0;
+	int upToDate = 0;
+	int failed = 0;
+	size_t sourceBytes = 0;
+	size_t cookedBytes = 0;
+	double cpuSeconds = 0.0;
+
+	for (auto& result : m_results)
+	{
+		cooked += result.m_status == AssetCookResult::Status::COOKED ? 1 : 0;
+		upToDate += result.m_status == AssetCookResult::Status::UP_TO_DATE ? 1 : 0;
+		failed += result.m_status == AssetCookResult::Status::FAILED ? 1 : 0;
+		sourceBytes += result.m_sourceBytes;
+		cookedBytes += result.m_meshBytes + result.m_animBytes + result.m_vatBytes;
+		cpuSeconds += result.m_seconds;
+	}
+
+	printf("\n%-32s %10s %10s %10s %10s %8s\n", "asset", "source KB", "mesh KB", "anim KB", "vat KB", "time");
+	for (auto& result : m_results)
+	{
+		printf("%-32s %10d %10d %10d %10d %7.2fs\n", result.m_name.c_str(), (int)(result.m_sourceBytes / 1024), (int)(result.m_meshBytes / 1024), (int)(result.m_animBytes / 1024), (int)(result.m_vatBytes / 1024), result.m_seconds);
+		for (auto& rejected : result.m_rejectedMeshes)
+			printf("    %s\n", rejected.c_str());
+	}
+
+	printf("\n%d cooked, %d up to date, %d failed\n", cooked, upToDate, failed);
+	printf("source %.2f MB -> cooked %.2f MB\n", sourceBytes / (1024.0 * 1024.0), cookedBytes / (1024.0 * 1024.0));
+	printf("%.2fs wall, %.2fs summed over %d threads\n", m_wallSeconds, cpuSeconds, m_threadCount);
+}
+
+int RunAssetCooker(const char* commandLine)
+{
+	AssetCookerConfig config;
+	config.m_force = strstr(commandLine, "-force") != nullptr;
+	config.m_compressStreams = strstr(commandLine, "-uncompressed") == nullptr;
+
+	if (const char* vat = strstr(commandLine, "-vat"))
+	{
+		config.m_bakeVertexAnimation = true;
+		if (vat[strlen("-vat")] == '=' && atof(vat + strlen("-vat=")) > 0.0)
+			config.m_vertexAnimationTps = (float)atof(vat + strlen("-vat="));
+	}
+
+	if (const char* threads = strstr(commandLine, "-threads="))
+		config.m_threadCount = atoi(threads + strlen("-threads="));
+
+	if (const char* source = strstr(commandLine, "-source="))
+	{
+		source += strlen("-source=");
+		config.m_sourceDir = std::string(source, strcspn(source, " \t"));
+	}
+
+	AssetCooker cooker(config);
+	int failures = cooker.Run();
+	cooker.PrintReport();
+	ShutdownParallelFor();
+	return failures;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "AssetCache.hpp"
+
+#include <string>
+#include <vector>
+
+class AnimClip;
+class Animation;
+class MorphTargetSet;
+class SkeletalMesh;
+class Skeleton;
+class VertexAnimation;
+
+struct SkeletalSubmesh;
+
+// which meshes of a model file to keep, "Body,2,Hair" by name or index, "*" for all, empty for the first only
+struct MeshSelection
+{
+public:
+	MeshSelection() = default;
+	explicit MeshSelection(const std::string& selection);
+
+	bool IsSelected(int index, const std::string& name) const;
+	bool IsDefault() const { return m_source.empty(); }
+	const std::string& GetSource() const { return m_source; }
+	const std::vector<std::string>& GetNames() const { return m_names; }
+	const std::vector<int>&         GetIndices() const { return m_indices; }
+
+private:
+	std::string              m_source;
+	std::vector<std::string> m_names;
+	std::vector<int>         m_indices;
+	bool                     m_all = false;
+};
+
+// import helpers shared by runtime load and offline cook, so both produce identical cooked data
+// selected meshes sharing the first one's skeleton are merged into one SkeletalMesh, one range per source mesh
+// every selected mesh left out, and every selected name or index the file lacks, gets a line in outRejected
+SkeletalMesh* ImportSkeletalMesh(const char* filePath, const MeshSelection& selection, MorphTargetSet& outMorphs, std::vector<SkeletalSubmesh>& outSubmeshes, std::vector<std::string>& outRejected);
+Animation*    ImportAnimation(const char* filePath, const Skeleton& skeleton); // full import, engine curves
+bool          ImportAnimationClip(const char* filePath, const Skeleton& skeleton, AnimClip& outClip);
+bool          WriteCookedClip(const std::string& cookedPath, const CookedAssetKey& key, const AnimClip& clip);
+bool          ReadCookedClip(const std::string& cookedPath, const CookedAssetKey& key, AnimClip& outClip); // upgrades pre-section clips in place
+bool          WriteCookedVertexAnimation(const std::string& cookedPath, const CookedAssetKey& key, const VertexAnimation& vat);
+bool          ReadCookedVertexAnimation(const std::string& cookedPath, const CookedAssetKey& key, VertexAnimation& outVat);
+
+// "<dir>/<name>.FBX" as long as that opens, so the path and every key built from it stay the same on windows
+// case sensitive file systems get whatever spelling of the extension is on disk
+bool        IsModelSourceExtension(const std::string& extension); // ".fbx" in any case
+std::string FindModelSourcePath(const std::string& sourceDir, const std::string& name);
+
+constexpr float VAT_BAKE_TPS = 30.0f;
+
+struct AssetCookerConfig
+{
+public:
+	std::string m_sourceDir   = "Data/Models";
+	int         m_threadCount = 0; // 0 = one per hardware thread
+	bool        m_force       = false;
+	bool        m_bakeVertexAnimation = false; // far crowd tier, the model's own clip skinned onto its whole mesh
+	float       m_vertexAnimationTps  = VAT_BAKE_TPS;
+	bool        m_compressStreams     = true; // see WriteCookedMesh, switching it needs -force to recook unchanged models
+};
+
+struct AssetCookResult
+{
+public:
+	enum class Status
+	{
+		COOKED,
+		UP_TO_DATE,
+		FAILED,
+	};
+
+	std::string m_name;
+	std::string m_sourcePath;
+	Status      m_status      = Status::FAILED;
+	std::string m_error;
+	uint64_t    m_sourceHash  = 0;
+	uint64_t    m_skeletonHash = 0; // the clip's, 0 when the model has no clip
+	size_t      m_sourceBytes = 0;
+	size_t      m_meshBytes   = 0;
+	size_t      m_animBytes   = 0;
+	size_t      m_vatBytes    = 0;
+	float       m_vatTps      = 0.0f; // 0 when no vertex animation was baked
+	std::vector<std::string> m_rejectedMeshes;
+	double      m_seconds     = 0.0;
+};
+
+// cooks every model in the source dir on a worker pool, the manifest records the source hash per model
+// so unchanged models are skipped on the next run
+class AssetCooker
+{
+public:
+	explicit AssetCooker(const AssetCookerConfig& config);
+
+	int  Run(); // returns number of failed assets
+	void PrintReport() const;
+
+	const std::vector<AssetCookResult>& GetResults() const { return m_results; }
+
+private:
+	// what the last cook of a model wrote, a model without a clip has no anim or vat output
+	struct ManifestEntry
+	{
+		std::string m_name;
+		uint64_t    m_sourceHash = 0;
+		bool        m_hasAnim    = false;
+		float       m_vatTps     = 0.0f;
+		uint64_t    m_skeletonHash = 0; // part of the anim output's name
+	};
+
+	void CookAsset(AssetCookResult& result) const;
+	const ManifestEntry* FindUpToDateEntry(const AssetCookResult& result) const;
+	void LoadManifest();
+	void SaveManifest() const;
+
+private:
+	AssetCookerConfig            m_config;
+	std::vector<AssetCookResult> m_results;
+	std::vector<ManifestEntry>   m_manifest;
+	double                       m_wallSeconds = 0.0;
+	int                          m_threadCount = 0;
+};
+
+// "-cook [-force] [-threads=N] [-source=Dir] [-vat[=tps]] [-uncompressed]", runs without window, renderer or audio
+int RunAssetCooker(const char* commandLine);
@@ -0,0 +1,179 @@
+#include "AssetHotReload.hpp"
+#include "AnimClip.hpp"
+#include "AnimResources.hpp"
+#include "GameCommon.hpp"
+
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <ctype.h>
+#include <memory>
+#include <thread>
+
+constexpr float HOT_RELOAD_POLL_SECONDS = 0.5f;
+
+struct AssetHotReloader::ReloadJob
+{
+public:
+	std::string m_changedPath;
+
+	// live versions, held so they cannot be evicted while their replacement loads
+	std::vector<ResourceHandle<ModelResource>> m_models;
+	std::vector<ResourceHandle<ClipResource>>  m_clips;
+
+	// worker side, copied before the thread starts since handles are main thread only
+	std::vector<std::pair<std::string, MeshSelection>> m_modelKeys;
+	std::vector<std::pair<std::string, SkeletonRef>>   m_clipKeys;
+	std::vector<std::unique_ptr<LoadedModel>>          m_loadedModels;
+	std::vector<std::unique_ptr<LoadedAnimation>>      m_loadedClips;
+	std::vector<char>                                  m_modelLoaded;
+	std::vector<char>                                  m_clipLoaded;
+
+	std::thread       m_thread;
+	std::atomic<bool> m_isDone = false;
+};
+
+bool IsSamePath(const std::string& a, const std::string& b)
+{
+	// windows paths are case insensitive, "x.fbx" on disk is loaded as "x.FBX"
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char ca, unsigned char cb) { return tolower(ca) == tolower(cb); });
+}
+
+AssetHotReloader::AssetHotReloader()
+{
+	m_watcher.AddDirectory("Data/Models", ".fbx");
+	m_watcher.Start(HOT_RELOAD_POLL_SECONDS);
+}
+
+AssetHotReloader::~AssetHotReloader()
+{
+	m_watcher.Stop();
+	for (auto* job : m_jobs)
+	{
+		if (job->m_thread.joinable())
+			job->m_thread.join();
+		delete job;
+	}
+	m_jobs.clear();
+}
+
+void AssetHotReloader::Update()
+{
+	std::vector<std::string> changes;
+	m_watcher.PopChanges(changes);
+	for (auto& path : changes)
+		StartJob(path);
+
+	for (size_t idx = 0; idx < m_jobs.size();)
+	{
+		ReloadJob* job = m_jobs[idx];
+		if (!job->m_isDone)
+		{
+			idx++;
+			continue;
+		}
+
+		job->m_thread.join();
+		FinishJob(*job);
+		delete job;
+		m_jobs.erase(m_jobs.begin() + idx);
+	}
+}
+
+void AssetHotReloader::StartJob(const std::string& changedPath)
+{
+	ReloadJob* job = new ReloadJob();
+	job->m_changedPath = changedPath;
+
+	std::vector<ResourceHandle<ModelResource>> models;
+	std::vector<ResourceHandle<ClipResource>> clips;
+	g_theResources->CollectResources(models);
+	g_theResources->CollectResources(clips);
+
+	// only our own handle left means nothing shows it, dropping the cached copy is enough
+	for (auto& model : models)
+	{
+		if (!IsSamePath(changedPath, GetModelSourcePath(model->m_name)))
+			continue;
+
+		if (model.GetRefCount() == 1)
+		{
+			std::string id = model.GetId();
+			model.Reset();
+			g_theResources->Remove(id);
+			continue;
+		}
+		job->m_modelKeys.emplace_back(model->m_name, model->m_selection);
+		job->m_models.push_back(model);
+	}
+
+	for (auto& clip : clips)
+	{
+		if (!IsSamePath(changedPath, GetModelSourcePath(clip->m_name)))
+			continue;
+
+		if (clip.GetRefCount() == 1)
+		{
+			std::string id = clip.GetId();
+			clip.Reset();
+			g_theResources->Remove(id);
+			continue;
+		}
+		job->m_clipKeys.emplace_back(clip->m_name, clip->m_skeleton);
+		job->m_clips.push_back(clip);
+	}
+
+	if (job->m_models.empty() && job->m_clips.empty())
+	{
+		delete job;
+		return;
+	}
+
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("%s changed, reloading %d models and %d clips...", changedPath.c_str(), (int)job->m_models.size(), (int)job->m_clips.size()));
+
+	job->m_thread = std::thread([job]()
+	{
+		// loading recooks since the source changed, the live versions still map the old cooked files,
+		// so the new ones are swapped in by AssetCache::CommitPendingWrites once FinishJob released them
+		for (auto& key : job->m_modelKeys)
+		{
+			job->m_loadedModels.emplace_back(new LoadedModel());
+			job->m_modelLoaded.push_back(LoadModelData(key.first.c_str(), key.second, *job->m_loadedModels.back()));
+		}
+
+		for (auto& key : job->m_clipKeys)
+		{
+			job->m_loadedClips.emplace_back(new LoadedAnimation());
+			job->m_clipLoaded.push_back(LoadAnimationData(key.first.c_str(), key.second, *job->m_loadedClips.back()));
+		}
+
+		job->m_isDone = true;
+	});
+	m_jobs.push_back(job);
+}
+
+void AssetHotReloader::FinishJob(ReloadJob& job)
+{
+	// gpu buffers of the new models are created here, on the main thread
+	int reloaded = 0;
+	for (size_t idx = 0; idx < job.m_models.size(); idx++)
+	{
+		if (job.m_modelLoaded[idx] && g_theResources->Replace(job.m_models[idx].GetId(), new ModelResource(*job.m_loadedModels[idx])))
+			reloaded++;
+		else
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Reload of %s failed, keeping the old version", job.m_models[idx].GetId().c_str()));
+	}
+
+	for (size_t idx = 0; idx < job.m_clips.size(); idx++)
+	{
+		if (job.m_clipLoaded[idx] && g_theResources->Replace(job.m_clips[idx].GetId(), new ClipResource(*job.m_loadedClips[idx])))
+			reloaded++;
+		else
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Reload of %s failed, keeping the old version", job.m_clips[idx].GetId().c_str()));
+	}
+
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Reloaded %d assets from %s", reloaded, job.m_changedPath.c_str()));
+}
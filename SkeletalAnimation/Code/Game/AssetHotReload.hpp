@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FileWatcher.hpp"
+
+#include <string>
+#include <vector>
+
+// watches model sources, reloads every live resource built from a changed file on a worker thread
+// (recooking it) and swaps the new versions in at a frame boundary
+// cooked assets are outputs, whoever writes them (loads, upgrades, this reloader) is not a change to react to
+// unreferenced cached versions are simply dropped, the next load picks up the new file
+class AssetHotReloader
+{
+public:
+	AssetHotReloader();
+	AssetHotReloader(const AssetHotReloader& copyFrom) = delete;
+	~AssetHotReloader(); // waits for running reloads, imports cannot be interrupted
+
+	void Update(); // main thread, before scenes update
+	int  GetRunningJobCount() const { return (int)m_jobs.size(); }
+
+private:
+	struct ReloadJob;
+
+	void StartJob(const std::string& changedPath);
+	void FinishJob(ReloadJob& job);
+
+private:
+	FileWatcher             m_watcher;
+	std::vector<ReloadJob*> m_jobs;
+};
@@ -0,0 +1,245 @@
+#include "BlockCompression.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+constexpr int      LZ_MIN_MATCH      = 4;
+constexpr int      LZ_LAST_LITERALS  = 5;  // format rule, the last 5 bytes are always literals
+constexpr int      LZ_MF_LIMIT       = 12; // format rule, no match may start within the last 12 bytes
+constexpr int      LZ_HASH_BITS      = 12;
+constexpr size_t   LZ_MAX_OFFSET     = 65535;
+constexpr uint32_t BLOCK_HEADER_SIZE = 16;
+
+uint32_t ReadU32(const uint8_t* ptr)
+{
+	uint32_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+uint32_t HashSequence(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+void WriteLength(std::vector<uint8_t>& out, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		out.push_back(255);
+	out.push_back((uint8_t)length);
+}
+
+void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength >= LZ_MIN_MATCH ? matchLength - LZ_MIN_MATCH : 0;
+	uint8_t token = (uint8_t)((std::min(literalCount, (size_t)15) << 4) | (matchLength > 0 ? std::min(matchCode, (size_t)15) : 0));
+	out.push_back(token);
+	if (literalCount >= 15)
+		WriteLength(out, literalCount - 15);
+	out.insert(out.end(), literals, literals + literalCount);
+
+	if (matchLength == 0)
+		return; // last sequence, literals only
+
+	out.push_back((uint8_t)(offset & 0xFF));
+	out.push_back((uint8_t)(offset >> 8));
+	if (matchCode >= 15)
+		WriteLength(out, matchCode - 15);
+}
+
+void CompressBlockLZ(const void* src, size_t srcSize, std::vector<uint8_t>& out)
+{
+	const uint8_t* base = static_cast<const uint8_t*>(src);
+	const uint8_t* ip = base;
+	const uint8_t* anchor = base;
+	const uint8_t* end = base + srcSize;
+
+	if (srcSize > LZ_MF_LIMIT)
+	{
+		const uint8_t* matchLimit = end - LZ_LAST_LITERALS;
+		const uint8_t* mfLimit = end - LZ_MF_LIMIT;
+		std::vector<uint32_t> table((size_t)1 << LZ_HASH_BITS, 0);
+
+		while (ip < mfLimit)
+		{
+			uint32_t sequence = ReadU32(ip);
+			uint32_t hash = HashSequence(sequence);
+			const uint8_t* ref = base + table[hash];
+			table[hash] = (uint32_t)(ip - base);
+
+			if (ref >= ip || (size_t)(ip - ref) > LZ_MAX_OFFSET || ReadU32(ref) != sequence)
+			{
+				ip++;
+				continue;
+			}
+
+			size_t matchLength = LZ_MIN_MATCH;
+			while (ip + matchLength < matchLimit && ip[matchLength] == ref[matchLength])
+				matchLength++;
+
+			WriteSequence(out, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), matchLength);
+			ip += matchLength;
+			anchor = ip;
+		}
+	}
+
+	WriteSequence(out, anchor, (size_t)(end - anchor), 0, 0);
+}
+
+bool DecompressBlockLZ(const void* src, size_t srcSize, void* dst, size_t dstSize)
+{
+	const uint8_t* ip = static_cast<const uint8_t*>(src);
+	const uint8_t* ipEnd = ip + srcSize;
+	uint8_t* op = static_cast<uint8_t*>(dst);
+	uint8_t* opBase = op;
+	uint8_t* opEnd = op + dstSize;
+
+	while (ip < ipEnd)
+	{
+		uint8_t token = *ip++;
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15)
+		{
+			uint8_t extra;
+			do
+			{
+				if (ip >= ipEnd)
+					return false;
+				extra = *ip++;
+				literalCount += extra;
+			} while (extra == 255);
+		}
+
+		if ((size_t)(ipEnd - ip) < literalCount || (size_t)(opEnd - op) < literalCount)
+			return false;
+		memcpy(op, ip, literalCount);
+		ip += literalCount;
+		op += literalCount;
+
+		if (ip >= ipEnd)
+			break; // last sequence has no match
+
+		if (ipEnd - ip < 2)
+			return false;
+		size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - opBase))
+			return false;
+
+		size_t matchLength = token & 0x0F;
+		if (matchLength == 15)
+		{
+			uint8_t extra;
+			do
+			{
+				if (ip >= ipEnd)
+					return false;
+				extra = *ip++;
+				matchLength += extra;
+			} while (extra == 255);
+		}
+		matchLength += LZ_MIN_MATCH;
+
+		if ((size_t)(opEnd - op) < matchLength)
+			return false;
+
+		// byte wise, matches may overlap their own output
+		const uint8_t* ref = op - offset;
+		for (size_t idx = 0; idx < matchLength; idx++)
+			op[idx] = ref[idx];
+		op += matchLength;
+	}
+
+	return op == opEnd;
+}
+
+void CompressToBlocks(const void* src, size_t srcSize, uint32_t blockSize, std::vector<uint8_t>& out)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(src);
+	uint32_t blockCount = blockSize > 0 ? (uint32_t)((srcSize + blockSize - 1) / blockSize) : 0;
+	uint64_t rawSize = srcSize;
+
+	size_t headerStart = out.size();
+	out.resize(headerStart + BLOCK_HEADER_SIZE + sizeof(uint32_t) * (blockCount + 1));
+	memcpy(&out[headerStart + 0], &blockSize, sizeof(blockSize));
+	memcpy(&out[headerStart + 4], &blockCount, sizeof(blockCount));
+	memcpy(&out[headerStart + 8], &rawSize, sizeof(rawSize));
+
+	// blocks are compressed in parallel, then appended in order
+	std::vector<std::vector<uint8_t>> blocks(blockCount);
+	ParallelFor((int)blockCount, [&](int blockIdx)
+	{
+		size_t offset = (size_t)blockIdx * blockSize;
+		size_t size = std::min((size_t)blockSize, srcSize - offset);
+		CompressBlockLZ(bytes + offset, size, blocks[blockIdx]);
+		if (blocks[blockIdx].size() >= size)
+			blocks[blockIdx].assign(bytes + offset, bytes + offset + size);
+	});
+
+	size_t dataStart = out.size();
+	uint32_t offset = 0;
+	for (uint32_t blockIdx = 0; blockIdx <= blockCount; blockIdx++)
+	{
+		memcpy(&out[headerStart + BLOCK_HEADER_SIZE + sizeof(uint32_t) * blockIdx], &offset, sizeof(offset));
+		if (blockIdx < blockCount)
+			offset += (uint32_t)blocks[blockIdx].size();
+	}
+
+	out.reserve(dataStart + offset);
+	for (auto& block : blocks)
+		out.insert(out.end(), block.begin(), block.end());
+}
+
+bool CompressedBlockView::Parse(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	if (size < BLOCK_HEADER_SIZE)
+		return false;
+
+	memcpy(&m_blockSize, bytes + 0, sizeof(m_blockSize));
+	memcpy(&m_blockCount, bytes + 4, sizeof(m_blockCount));
+	memcpy(&m_rawSize, bytes + 8, sizeof(m_rawSize));
+
+	size_t tableEnd = BLOCK_HEADER_SIZE + sizeof(uint32_t) * ((size_t)m_blockCount + 1);
+	if (size < tableEnd || (m_blockCount > 0 && m_blockSize == 0))
+		return false;
+
+	m_offsets = reinterpret_cast<const uint32_t*>(bytes + BLOCK_HEADER_SIZE);
+	m_data = bytes + tableEnd;
+	return m_offsets[m_blockCount] <= size - tableEnd;
+}
+
+size_t CompressedBlockView::GetBlockRawSize(int blockIdx) const
+{
+	size_t offset = GetBlockRawOffset(blockIdx);
+	return std::min((size_t)m_blockSize, (size_t)m_rawSize - offset);
+}
+
+bool CompressedBlockView::DecompressBlock(int blockIdx, void* dst) const
+{
+	const uint8_t* block = m_data + m_offsets[blockIdx];
+	size_t storedSize = m_offsets[blockIdx + 1] - m_offsets[blockIdx];
+	size_t rawSize = GetBlockRawSize(blockIdx);
+
+	if (storedSize == rawSize)
+	{
+		memcpy(dst, block, rawSize);
+		return true;
+	}
+	return DecompressBlockLZ(block, storedSize, dst, rawSize);
+}
+
+bool CompressedBlockView::DecompressAll(void* dst) const
+{
+	uint8_t* bytes = static_cast<uint8_t*>(dst);
+	std::atomic<bool> isValid(true);
+	ParallelFor((int)m_blockCount, [&](int blockIdx)
+	{
+		if (!DecompressBlock(blockIdx, bytes + GetBlockRawOffset(blockIdx)))
+			isValid = false;
+	});
+	return isValid;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// LZ4 block format, greedy single probe compressor, no frame header or checksum
+void   CompressBlockLZ(const void* src, size_t srcSize, std::vector<uint8_t>& out);
+bool   DecompressBlockLZ(const void* src, size_t srcSize, void* dst, size_t dstSize);
+
+// split into fixed size blocks that compress and decompress independently
+// layout: blockSize u32, blockCount u32, rawSize u64, offsets u32[blockCount + 1], block data
+// a block whose stored size equals its raw size did not compress and is stored as is
+void   CompressToBlocks(const void* src, size_t srcSize, uint32_t blockSize, std::vector<uint8_t>& out);
+
+// non owning view over a block stream, e.g. straight out of a mapped file
+class CompressedBlockView
+{
+public:
+	bool   Parse(const void* data, size_t size);
+
+	int    GetBlockCount() const { return (int)m_blockCount; }
+	size_t GetRawSize() const    { return (size_t)m_rawSize; }
+	size_t GetBlockRawSize(int blockIdx) const;
+	size_t GetBlockRawOffset(int blockIdx) const { return (size_t)blockIdx * m_blockSize; }
+
+	bool   DecompressBlock(int blockIdx, void* dst) const;
+	bool   DecompressAll(void* dst) const; // blocks are spread over worker threads
+
+private:
+	const uint8_t*  m_data       = nullptr;
+	const uint32_t* m_offsets    = nullptr;
+	uint32_t        m_blockSize  = 0;
+	uint32_t        m_blockCount = 0;
+	uint64_t        m_rawSize    = 0;
+};
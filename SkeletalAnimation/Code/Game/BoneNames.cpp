@@ -0,0 +1,84 @@
+#include "BoneNames.hpp"
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+std::mutex g_boneNameMutex;
+std::unordered_map<BoneNameHash, std::string> g_boneNames; // imports intern from worker threads
+
+BoneNameHash HashBoneName(const char* name, size_t length)
+{
+	BoneNameHash hash = BONE_NAME_HASH_SEED;
+	for (size_t idx = 0; idx < length; idx++)
+		hash = (hash ^ (uint8_t)name[idx]) * BONE_NAME_HASH_PRIME;
+	return hash;
+}
+
+void InternBoneName(BoneNameHash hash, const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(g_boneNameMutex);
+	auto inserted = g_boneNames.emplace(hash, name);
+	if (!inserted.second && inserted.first->second != name)
+		DebuggerPrintf(Stringf("[BONE] %s and %s share hash %08x, lookups by hash will confuse them\n", inserted.first->second.c_str(), name.c_str(), hash).c_str());
+}
+
+const char* GetInternedBoneName(BoneNameHash hash)
+{
+	std::lock_guard<std::mutex> lock(g_boneNameMutex);
+	auto found = g_boneNames.find(hash);
+	return found != g_boneNames.end() ? found->second.c_str() : "?";
+}
+
+uint32_t GetBoneSlot(BoneNameHash hash, uint32_t mask)
+{
+	// fold the high bits in, FNV low bits alone cluster for names that differ only in a suffix
+	return (hash ^ (hash >> 16)) & mask;
+}
+
+void BoneLookup::Build(const Skeleton& skeleton)
+{
+	int boneCount = (int)skeleton.size();
+	uint32_t capacity = 8;
+	while (capacity < (uint32_t)boneCount * 2)
+		capacity *= 2;
+
+	m_slots.assign(capacity, Slot());
+	m_mask = capacity - 1;
+	m_boneHashes.assign(boneCount, 0);
+
+	for (auto& bone : skeleton)
+	{
+		BoneNameHash hash = HashBoneName(bone.m_name.c_str(), bone.m_name.size());
+		InternBoneName(hash, bone.m_name);
+		m_boneHashes[bone.m_id] = hash;
+
+		uint32_t slot = GetBoneSlot(hash, m_mask);
+		while (m_slots[slot].m_boneId != INVALID_BONE_ID)
+			slot = (slot + 1) & m_mask;
+		m_slots[slot].m_hash = hash;
+		m_slots[slot].m_boneId = bone.m_id;
+	}
+}
+
+void BoneLookup::Clear()
+{
+	m_slots.clear();
+	m_boneHashes.clear();
+	m_mask = 0;
+}
+
+BoneId BoneLookup::Find(BoneNameHash hash) const
+{
+	if (m_slots.empty())
+		return INVALID_BONE_ID;
+
+	for (uint32_t slot = GetBoneSlot(hash, m_mask);; slot = (slot + 1) & m_mask)
+	{
+		const Slot& entry = m_slots[slot];
+		if (entry.m_boneId == INVALID_BONE_ID || entry.m_hash == hash)
+			return entry.m_boneId;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// interned bone name, 32 bit FNV-1a of the name
+typedef uint32_t BoneNameHash;
+
+constexpr BoneNameHash BONE_NAME_HASH_SEED  = 2166136261u;
+constexpr BoneNameHash BONE_NAME_HASH_PRIME = 16777619u;
+
+constexpr BoneNameHash HashBoneName(const char* name)
+{
+	BoneNameHash hash = BONE_NAME_HASH_SEED;
+	for (; *name; name++)
+		hash = (hash ^ (uint8_t)*name) * BONE_NAME_HASH_PRIME;
+	return hash;
+}
+
+BoneNameHash HashBoneName(const char* name, size_t length);
+
+// template argument forces the hash to fold at compile time, BONE("spine_01") costs nothing at runtime
+template<BoneNameHash HASH>
+struct BoneNameConstant
+{
+	static constexpr BoneNameHash VALUE = HASH;
+};
+
+#define BONE(name) (BoneNameConstant<HashBoneName(name)>::VALUE)
+
+// hash back to name for logs, filled as skeletons are interned, warns on two names sharing a hash
+const char* GetInternedBoneName(BoneNameHash hash);
+
+// flat open addressing table from name hash to bone id, built once per skeleton at import
+class BoneLookup
+{
+public:
+	void   Build(const Skeleton& skeleton);
+	void   Clear();
+
+	BoneId Find(BoneNameHash hash) const;
+	BoneId Find(const char* name) const { return Find(HashBoneName(name)); }
+	BoneNameHash GetHash(BoneId boneId) const { return m_boneHashes[boneId]; }
+	int    GetBoneCount() const { return (int)m_boneHashes.size(); }
+
+private:
+	struct Slot
+	{
+		BoneNameHash m_hash   = 0;
+		BoneId       m_boneId = INVALID_BONE_ID; // invalid marks an empty slot
+	};
+
+	std::vector<Slot>         m_slots; // power of two, at most half full, linear probing
+	std::vector<BoneNameHash> m_boneHashes;
+	uint32_t                  m_mask = 0;
+};
@@ -0,0 +1,122 @@
+#include "ClipLibrary.hpp"
+
+constexpr uint32_t SECTION_LDIR = MakeSectionId('L', 'D', 'I', 'R');
+constexpr uint32_t SECTION_LNAM = MakeSectionId('L', 'N', 'A', 'M');
+constexpr uint32_t SECTION_LKEY = MakeSectionId('L', 'K', 'E', 'Y');
+constexpr uint32_t SECTION_LSRC = MakeSectionId('L', 'S', 'R', 'C');
+constexpr uint32_t CLIP_LIBRARY_VERSION = 2; // 2 names entries after their source file instead of the take
+
+void ClipLibrary::Build(const std::vector<const AnimClip*>& clips, const std::vector<std::string>& names, uint64_t skeletonHash)
+{
+	Clear();
+
+	// keys are packed back to back, padded so each clip starts on an aligned boundary
+	std::vector<TransformQuat> clipKeys;
+	for (size_t clipIdx = 0; clipIdx < clips.size(); clipIdx++)
+	{
+		const AnimClip* clip = clips[clipIdx];
+		while ((m_ownedKeys.size() * sizeof(TransformQuat)) % CLIP_LIBRARY_ALIGNMENT != 0)
+			m_ownedKeys.emplace_back();
+
+		ClipLibraryEntry& entry = m_entries.emplace_back();
+		entry.m_skeletonHash = skeletonHash;
+		entry.m_keyOffset = m_ownedKeys.size();
+		entry.m_nameOffset = (uint32_t)m_names.size();
+		entry.m_nameSize = (uint32_t)names[clipIdx].size();
+		entry.m_frameCount = clip->m_frameCount;
+		entry.m_boneCount = clip->m_boneCount;
+		entry.m_tps = clip->m_tps;
+		entry.m_duration = clip->m_duration;
+		m_names += names[clipIdx];
+
+		clip->CopyKeys(clipKeys);
+		m_ownedKeys.insert(m_ownedKeys.end(), clipKeys.begin(), clipKeys.end());
+	}
+
+	m_arena = m_ownedKeys.data();
+	m_arenaKeyCount = m_ownedKeys.size();
+	BuildClipViews();
+}
+
+bool ClipLibrary::Write(const std::string& cookedPath, const CookedAssetKey& key) const
+{
+	// keys stay uncompressed so an opened library is used straight from the mapping
+	CookedAssetWriter writer;
+	writer.AddArray(SECTION_LDIR, CLIP_LIBRARY_VERSION, m_entries);
+	writer.AddSection(SECTION_LNAM, CLIP_LIBRARY_VERSION, m_names);
+	writer.AddArray(SECTION_LSRC, CLIP_LIBRARY_VERSION, m_sources);
+	writer.AddSection(SECTION_LKEY, CLIP_LIBRARY_VERSION, m_arena, sizeof(TransformQuat), m_arenaKeyCount);
+	return writer.Write(cookedPath, key);
+}
+
+bool ClipLibrary::Open(const std::string& cookedPath, const CookedAssetKey& key)
+{
+	Clear();
+	if (!m_view.Open(cookedPath, key))
+		return false;
+
+	// used in place, so an older container's alignment is not good enough, the caller packs it again
+	// the same for older directories, their entries were named after the take
+	if (!m_view.IsCurrentVersion() || m_view.GetSectionVersion(SECTION_LDIR) != CLIP_LIBRARY_VERSION)
+	{
+		Clear();
+		return false;
+	}
+
+	const CookedSection* keySection = m_view.FindSection(SECTION_LKEY);
+	if (!keySection || keySection->m_elementSize != sizeof(TransformQuat) || keySection->m_compression != CookedCompression::NONE
+		|| !m_view.ReadArray(SECTION_LDIR, m_entries) || !m_view.ReadString(SECTION_LNAM, m_names) || !m_view.ReadArray(SECTION_LSRC, m_sources))
+	{
+		Clear();
+		return false;
+	}
+	m_arena = m_view.GetArray<TransformQuat>(SECTION_LKEY, m_arenaKeyCount);
+
+	for (auto& entry : m_entries)
+	{
+		if (entry.m_keyOffset + (uint64_t)entry.m_frameCount * entry.m_boneCount > m_arenaKeyCount || (size_t)entry.m_nameOffset + entry.m_nameSize > m_names.size())
+		{
+			Clear(); // truncated or corrupt directory
+			return false;
+		}
+	}
+
+	BuildClipViews();
+	return true;
+}
+
+void ClipLibrary::Clear()
+{
+	m_clips.clear();
+	m_clipIds.clear();
+	m_entries.clear();
+	m_names.clear();
+	m_sources.clear();
+	m_ownedKeys.clear();
+	m_view.Close();
+	m_arena = nullptr;
+	m_arenaKeyCount = 0;
+}
+
+int ClipLibrary::FindClip(const std::string& name) const
+{
+	auto found = m_clipIds.find(name);
+	return found != m_clipIds.end() ? found->second : -1;
+}
+
+void ClipLibrary::BuildClipViews()
+{
+	m_clips.resize(m_entries.size());
+	for (int clipId = 0; clipId < (int)m_entries.size(); clipId++)
+	{
+		const ClipLibraryEntry& entry = m_entries[clipId];
+		AnimClip& clip = m_clips[clipId];
+		clip.m_name.assign(m_names, entry.m_nameOffset, entry.m_nameSize);
+		clip.m_tps = entry.m_tps;
+		clip.m_duration = entry.m_duration;
+		clip.m_frameCount = entry.m_frameCount;
+		clip.m_boneCount = entry.m_boneCount;
+		clip.AttachKeys(m_arena + entry.m_keyOffset);
+		m_clipIds.emplace(clip.m_name, clipId);
+	}
+}
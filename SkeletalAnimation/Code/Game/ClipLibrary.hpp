@@ -0,0 +1,70 @@
+#pragma once
+
+#include "AnimClip.hpp"
+#include "CookedAsset.hpp"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t CLIP_LIBRARY_ALIGNMENT = 64; // every clip's keys start on a cache line of the arena
+
+// one directory row per clip, keys are an unpacked [block][bone][frame] range of the shared arena
+struct ClipLibraryEntry
+{
+public:
+	uint64_t m_skeletonHash = 0;
+	uint64_t m_keyOffset    = 0; // in keys from the start of the arena
+	uint32_t m_nameOffset   = 0; // into the name section
+	uint32_t m_nameSize     = 0;
+	int32_t  m_frameCount   = 0;
+	int32_t  m_boneCount    = 0;
+	float    m_tps          = 0.0f;
+	float    m_duration     = 0.0f;
+};
+
+// every clip's keys in one contiguous arena plus a directory indexed by clip id
+// a cooked library is used in place from a single mapping, clips are views that never copy keys
+class ClipLibrary
+{
+public:
+	ClipLibrary() = default;
+	ClipLibrary(const ClipLibrary& copyFrom) = delete;
+
+	// streamed clips are decoded once while packing, FindClip goes by the names given here,
+	// the clips' own names are their take, which exporters often leave the same for every file ("mixamo.com")
+	void Build(const std::vector<const AnimClip*>& clips, const std::vector<std::string>& names, uint64_t skeletonHash);
+	void SetSources(const std::vector<SourceStamp>& sources) { m_sources = sources; } // one per clip, written with the library
+	bool Write(const std::string& cookedPath, const CookedAssetKey& key) const;
+	bool Open(const std::string& cookedPath, const CookedAssetKey& key);
+	void Clear();
+
+	int                     GetClipCount() const { return (int)m_clips.size(); }
+	int                     FindClip(const std::string& name) const; // -1 if missing
+	const ClipLibraryEntry& GetEntry(int clipId) const { return m_entries[clipId]; }
+	const AnimClip&         GetClip(int clipId) const  { return m_clips[clipId]; }
+	const TransformQuat*    GetKeys(int clipId) const  { return m_arena + m_entries[clipId].m_keyOffset; }
+	const std::vector<SourceStamp>& GetSources() const { return m_sources; }
+	size_t                  GetArenaBytes() const      { return m_arenaKeyCount * sizeof(TransformQuat); }
+	bool                    IsMapped() const           { return m_view.IsOpen(); }
+
+private:
+	void BuildClipViews();
+
+private:
+	CookedAssetView               m_view;      // set when opened from disk
+	std::vector<TransformQuat>    m_ownedKeys; // set when built in memory
+	std::vector<ClipLibraryEntry> m_entries;
+	std::string                   m_names;
+	std::vector<SourceStamp>      m_sources; // member sources as packed, checked on open instead of hashing them
+	const TransformQuat*          m_arena         = nullptr;
+	size_t                        m_arenaKeyCount = 0;
+
+	std::vector<AnimClip>                m_clips; // views with attached keys, by clip id
+	std::unordered_map<std::string, int> m_clipIds;
+};
+
+// clip resources made from a library keep it alive through this
+typedef std::shared_ptr<const ClipLibrary> ClipLibraryRef;
@@ -0,0 +1,201 @@
+#include "ClipStream.hpp"
+
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <thread>
+
+std::mutex g_streamMutex;
+std::condition_variable g_streamWake;
+std::deque<std::pair<std::weak_ptr<ClipBlockWindow>, int>> g_streamQueue;
+std::thread g_streamThread;
+bool g_streamQuit = false;
+
+std::atomic<int> g_streamPrefetchCount = 0; // decoded on the stream thread
+std::atomic<int> g_streamMissCount     = 0; // decoded on the playing thread, prefetch was late or not asked for
+std::atomic<int> g_streamWaitCount     = 0; // playing thread waited for the stream thread
+
+ClipBlockSource::ClipBlockSource(std::vector<uint8_t>&& packed)
+	: m_ownedPacked(std::move(packed))
+{
+	m_packed = m_ownedPacked.data();
+	m_packedSize = m_ownedPacked.size();
+}
+
+ClipBlockSource::ClipBlockSource(CookedAssetView&& view, const uint8_t* packed, size_t packedSize)
+	: m_view(std::move(view))
+	, m_packed(packed)
+	, m_packedSize(packedSize)
+{
+}
+
+bool ClipBlockSource::Initialize(int boneCount, int frameCount, int blockFrames)
+{
+	m_blockCount = (frameCount + blockFrames - 1) / blockFrames;
+	if (!m_blocks.Parse(m_packed, m_packedSize) || m_blocks.GetBlockCount() != m_blockCount)
+		return false;
+
+	m_blockKeyCounts.resize(m_blockCount);
+	for (int blockIdx = 0; blockIdx < m_blockCount; blockIdx++)
+		m_blockKeyCounts[blockIdx] = (size_t)boneCount * std::min(blockFrames, frameCount - blockIdx * blockFrames);
+	return true;
+}
+
+void ClipBlockSource::Decode(int blockIdx, std::vector<TransformQuat>& out) const
+{
+	out.resize(m_blockKeyCounts[blockIdx]);
+	if (m_blocks.GetBlockRawSize(blockIdx) != out.size() * sizeof(TransformQuat) || !m_blocks.DecompressBlock(blockIdx, out.data()))
+	{
+		DebuggerPrintf(Stringf("Clip stream: block %d is corrupt\n", blockIdx).c_str());
+		std::fill(out.begin(), out.end(), TransformQuat());
+	}
+}
+
+ClipBlockWindow::ClipBlockWindow(const std::shared_ptr<const ClipBlockSource>& source)
+	: m_source(source)
+	, m_slots(new ClipBlockSlot[source->GetBlockCount()])
+{
+}
+
+const TransformQuat* ClipBlockWindow::Acquire(int blockIdx)
+{
+	// only the playing thread frees blocks, so a ready block stays valid without the lock
+	ClipBlockSlot& slot = m_slots[blockIdx];
+	if (slot.m_state.load(std::memory_order_acquire) == ClipBlockState::READY)
+		return slot.m_keys.data();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (slot.m_state == ClipBlockState::DECODING)
+	{
+		g_streamWaitCount++;
+		m_decoded.wait(lock, [&slot]() { return slot.m_state == ClipBlockState::READY; });
+		return slot.m_keys.data();
+	}
+	if (slot.m_state == ClipBlockState::READY)
+		return slot.m_keys.data();
+
+	// empty or still queued, the stream thread skips it once we own it
+	slot.m_state = ClipBlockState::DECODING;
+	lock.unlock();
+	std::vector<TransformQuat> keys;
+	m_source->Decode(blockIdx, keys);
+	lock.lock();
+	slot.m_keys.swap(keys);
+	slot.m_state.store(ClipBlockState::READY, std::memory_order_release);
+	g_streamMissCount++;
+	return slot.m_keys.data();
+}
+
+void ClipBlockWindow::Prefetch(int blockIdx)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_slots[blockIdx].m_state != ClipBlockState::EMPTY)
+			return;
+		m_slots[blockIdx].m_state = ClipBlockState::QUEUED;
+	}
+	RequestClipBlock(shared_from_this(), blockIdx);
+}
+
+void ClipBlockWindow::DecodeQueued(int blockIdx)
+{
+	ClipBlockSlot& slot = m_slots[blockIdx];
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (slot.m_state != ClipBlockState::QUEUED)
+			return; // released or taken by the playing thread
+		slot.m_state = ClipBlockState::DECODING;
+	}
+
+	std::vector<TransformQuat> keys;
+	m_source->Decode(blockIdx, keys);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		slot.m_keys.swap(keys);
+		slot.m_state.store(ClipBlockState::READY, std::memory_order_release);
+	}
+	m_decoded.notify_all();
+	g_streamPrefetchCount++;
+}
+
+void ClipBlockWindow::ReleaseExcept(const int* keepBlocks, int keepCount)
+{
+	// blocks being decoded are left alone and go on the next call
+	std::vector<TransformQuat> released;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (int blockIdx = 0; blockIdx < m_source->GetBlockCount(); blockIdx++)
+	{
+		ClipBlockSlot& slot = m_slots[blockIdx];
+		ClipBlockState state = slot.m_state;
+		if ((state != ClipBlockState::READY && state != ClipBlockState::QUEUED) || std::find(keepBlocks, keepBlocks + keepCount, blockIdx) != keepBlocks + keepCount)
+			continue;
+
+		std::vector<TransformQuat>().swap(slot.m_keys);
+		slot.m_state = ClipBlockState::EMPTY;
+	}
+}
+
+size_t ClipBlockWindow::GetResidentBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t keyCount = 0;
+	for (int blockIdx = 0; blockIdx < m_source->GetBlockCount(); blockIdx++)
+		keyCount += m_slots[blockIdx].m_keys.size();
+	return keyCount * sizeof(TransformQuat);
+}
+
+void RunClipStreamThread()
+{
+	for (;;)
+	{
+		std::pair<std::weak_ptr<ClipBlockWindow>, int> request;
+		{
+			std::unique_lock<std::mutex> lock(g_streamMutex);
+			g_streamWake.wait(lock, []() { return g_streamQuit || !g_streamQueue.empty(); });
+			if (g_streamQuit)
+				return;
+			request = std::move(g_streamQueue.front());
+			g_streamQueue.pop_front();
+		}
+
+		// the player may have stopped or moved on to another clip while queued
+		if (std::shared_ptr<ClipBlockWindow> window = request.first.lock())
+			window->DecodeQueued(request.second);
+	}
+}
+
+void RequestClipBlock(const std::shared_ptr<ClipBlockWindow>& window, int blockIdx)
+{
+	{
+		std::lock_guard<std::mutex> lock(g_streamMutex);
+		if (!g_streamThread.joinable())
+		{
+			g_streamQuit = false;
+			g_streamThread = std::thread(RunClipStreamThread);
+		}
+		g_streamQueue.emplace_back(window, blockIdx);
+	}
+	g_streamWake.notify_one();
+}
+
+void ShutdownClipStreaming()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_streamMutex);
+		g_streamQuit = true;
+		g_streamQueue.clear();
+	}
+	g_streamWake.notify_one();
+	if (g_streamThread.joinable())
+		g_streamThread.join();
+}
+
+void PrintClipStreamStats()
+{
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("clip blocks: %d prefetched, %d decoded on the playing thread, %d waits",
+		g_streamPrefetchCount.load(), g_streamMissCount.load(), g_streamWaitCount.load()));
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "BlockCompression.hpp"
+#include "CookedAsset.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+constexpr int    CLIP_PREFETCH_BLOCKS      = 2;          // decoded ahead of the playing block on the stream thread
+constexpr size_t CLIP_STREAM_MAP_MIN_BYTES = 256 * 1024; // shorter clips copy their blocks out of the file
+
+enum class ClipBlockState : uint8_t
+{
+	EMPTY,
+	QUEUED,   // waiting for the stream thread
+	DECODING, // on either thread, the other one waits
+	READY,
+};
+
+struct ClipBlockSlot
+{
+public:
+	std::vector<TransformQuat>  m_keys;
+	std::atomic<ClipBlockState> m_state = ClipBlockState::EMPTY;
+};
+
+// compressed key blocks of one clip, each covering a fixed range of frames, immutable once initialized
+// long clips keep their cooked file mapped and read blocks from it in place, the os pages out what is not touched
+// shared by every copy and every player of the clip, decoding only reads it so any thread may
+class ClipBlockSource
+{
+public:
+	explicit ClipBlockSource(std::vector<uint8_t>&& packed);
+	ClipBlockSource(CookedAssetView&& view, const uint8_t* packed, size_t packedSize);
+	ClipBlockSource(const ClipBlockSource& copyFrom) = delete;
+
+	bool Initialize(int boneCount, int frameCount, int blockFrames);
+
+	int            GetBlockCount() const { return m_blockCount; }
+	const uint8_t* GetPackedData() const { return m_packed; }
+	size_t         GetPackedSize() const { return m_packedSize; }
+	bool           IsMapped() const      { return m_view.IsOpen(); }
+	size_t         GetResidentBytes() const { return IsMapped() ? 0 : m_packedSize; }
+
+	void Decode(int blockIdx, std::vector<TransformQuat>& out) const;
+
+private:
+	CookedAssetView      m_view;        // set when the blocks are used in place
+	std::vector<uint8_t> m_ownedPacked; // set otherwise
+	const uint8_t*       m_packed     = nullptr;
+	size_t               m_packedSize = 0;
+	CompressedBlockView  m_blocks;
+	std::vector<size_t>  m_blockKeyCounts;
+	int                  m_blockCount = 0;
+};
+
+// the decoded blocks around one playback position, every player of a clip keeps its own window
+// so two players at different times never release each other's blocks
+// blocks are acquired and released on the playing thread, the stream thread only ever fills queued ones
+class ClipBlockWindow : public std::enable_shared_from_this<ClipBlockWindow>
+{
+public:
+	explicit ClipBlockWindow(const std::shared_ptr<const ClipBlockSource>& source);
+	ClipBlockWindow(const ClipBlockWindow& copyFrom) = delete;
+
+	const TransformQuat* Acquire(int blockIdx); // decodes here if the prefetch has not run yet
+	void Prefetch(int blockIdx);
+	void ReleaseExcept(const int* keepBlocks, int keepCount);
+	bool IsResident(int blockIdx) const { return m_slots[blockIdx].m_state.load(std::memory_order_acquire) == ClipBlockState::READY; }
+
+	const ClipBlockSource* GetSource() const { return m_source.get(); }
+	size_t                 GetResidentBytes() const; // decoded blocks only, the packed ones are the clip's
+
+	void DecodeQueued(int blockIdx); // stream thread
+
+private:
+	std::shared_ptr<const ClipBlockSource> m_source;
+	std::unique_ptr<ClipBlockSlot[]>       m_slots;
+
+	mutable std::mutex                     m_mutex;
+	std::condition_variable                m_decoded;
+};
+
+// one background thread shared by every playing window, started on the first prefetch
+void RequestClipBlock(const std::shared_ptr<ClipBlockWindow>& window, int blockIdx);
+void ShutdownClipStreaming();
+void PrintClipStreamStats();
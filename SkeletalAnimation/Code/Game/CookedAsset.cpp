@@ -0,0 +1,499 @@
+#include "CookedAsset.hpp"
+#include "BlockCompression.hpp"
+#include "MorphTarget.hpp"
+#include "ParallelFor.hpp"
+
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/FileUtils.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+constexpr uint32_t SECTION_META = MakeSectionId('M', 'E', 'T', 'A');
+constexpr uint32_t SECTION_MRPH = MakeSectionId('M', 'R', 'P', 'H');
+constexpr uint32_t SECTION_SUBM = MakeSectionId('S', 'U', 'B', 'M');
+constexpr uint32_t SECTION_SNAM = MakeSectionId('S', 'N', 'A', 'M');
+constexpr uint32_t SECTION_VPOS = MakeSectionId('V', 'P', 'O', 'S');
+constexpr uint32_t SECTION_VNRM = MakeSectionId('V', 'N', 'R', 'M');
+constexpr uint32_t SECTION_VUV0 = MakeSectionId('V', 'U', 'V', '0');
+constexpr uint32_t SECTION_VBID = MakeSectionId('V', 'B', 'I', 'D');
+constexpr uint32_t SECTION_VBWT = MakeSectionId('V', 'B', 'W', 'T');
+constexpr uint32_t SECTION_INDX = MakeSectionId('I', 'N', 'D', 'X');
+constexpr uint32_t SECTION_LODS = MakeSectionId('L', 'O', 'D', 'S');
+constexpr uint32_t SECTION_LIDX = MakeSectionId('L', 'I', 'D', 'X');
+
+// payload versions, bump when a section layout changes and keep reading the old one
+constexpr uint32_t META_VERSION   = 1;
+constexpr uint32_t MRPH_VERSION   = 1;
+constexpr uint32_t SUBM_VERSION   = 1; // 0: ByteBuffer blob, 1: CookedSubmesh table plus SNAM names
+constexpr uint32_t STREAM_VERSION = 1;
+constexpr uint32_t LOD_VERSION    = 2; // SkeletalMeshLod table plus LIDX indices, 2: lod error in mesh units, missing before lods were cooked
+
+struct CookedSubmesh
+{
+public:
+	uint32_t m_nameOffset  = 0; // into SNAM
+	uint32_t m_nameSize    = 0;
+	int32_t  m_vertexStart = 0;
+	int32_t  m_vertexCount = 0;
+	int32_t  m_indexStart  = 0;
+	int32_t  m_indexCount  = 0;
+};
+
+uint64_t AlignCookedOffset(uint64_t offset)
+{
+	return (offset + COOKED_ASSET_ALIGNMENT - 1) & ~(uint64_t)(COOKED_ASSET_ALIGNMENT - 1);
+}
+
+void CookedAssetWriter::AddSection(uint32_t id, uint32_t version, const void* data, size_t elementSize, size_t count, bool compress)
+{
+	PendingSection& pending = m_sections.emplace_back();
+	pending.m_section.m_id = id;
+	pending.m_section.m_version = version;
+	pending.m_section.m_elementSize = (uint32_t)elementSize;
+	pending.m_section.m_rawSize = elementSize * count;
+
+	if (compress && count > 0)
+	{
+		CompressToBlocks(data, elementSize * count, COOKED_ASSET_BLOCK_SIZE, pending.m_data);
+		pending.m_section.m_compression = CookedCompression::LZ_BLOCKS;
+	}
+	else
+	{
+		pending.m_data.resize(elementSize * count);
+		if (count > 0)
+			memcpy(pending.m_data.data(), data, elementSize * count);
+	}
+	pending.m_section.m_size = pending.m_data.size();
+}
+
+void CookedAssetWriter::AddSection(uint32_t id, uint32_t version, const ByteBuffer& blob, bool compress)
+{
+	AddSection(id, version, blob.m_data.data(), 1, blob.m_data.size(), compress);
+}
+
+bool CookedAssetWriter::Write(const std::string& cookedPath, const CookedAssetKey& key) const
+{
+	CookedAssetHeader header;
+	header.m_importerVersion = key.m_importerVersion;
+	header.m_sectionCount = (uint32_t)m_sections.size();
+	header.m_contentHash = key.m_contentHash;
+	header.m_sourcePathSize = (uint32_t)key.m_sourcePath.size();
+
+	// lay out payloads first so the section table can be written in one go
+	std::vector<CookedSection> table;
+	table.reserve(m_sections.size());
+	uint64_t offset = sizeof(CookedAssetHeader) + sizeof(CookedSection) * m_sections.size() + header.m_sourcePathSize;
+	for (auto& pending : m_sections)
+	{
+		offset = AlignCookedOffset(offset);
+		CookedSection& section = table.emplace_back(pending.m_section);
+		section.m_offset = offset;
+		offset += section.m_size;
+	}
+
+	ByteBuffer buffer;
+	buffer.m_data.reserve((size_t)offset);
+	buffer.Write(header);
+	buffer.Write(sizeof(CookedSection) * table.size(), (const unsigned char*)table.data());
+	buffer.Write(key.m_sourcePath.size(), key.m_sourcePath.data());
+	for (size_t idx = 0; idx < m_sections.size(); idx++)
+	{
+		buffer.m_data.resize((size_t)table[idx].m_offset, 0);
+		buffer.Write(m_sections[idx].m_data.size(), m_sections[idx].m_data.data());
+	}
+
+	return AssetCache::WriteCooked(cookedPath, buffer);
+}
+
+CookedAssetView::CookedAssetView(CookedAssetView&& moveFrom) noexcept
+{
+	*this = std::move(moveFrom);
+}
+
+CookedAssetView& CookedAssetView::operator=(CookedAssetView&& moveFrom) noexcept
+{
+	if (this != &moveFrom)
+	{
+		m_file = std::move(moveFrom.m_file);
+		m_header = moveFrom.m_header;
+		m_sections = moveFrom.m_sections;
+		m_decompressed = std::move(moveFrom.m_decompressed);
+		moveFrom.m_header = nullptr;
+		moveFrom.m_sections = nullptr;
+	}
+	return *this;
+}
+
+bool CookedAssetView::Open(const std::string& cookedPath, const CookedAssetKey& key)
+{
+	Close();
+
+	if (key.m_contentHash == 0)
+		return false; // source missing, nothing to validate against
+
+	if (!m_file.Open(cookedPath.c_str()))
+		return false;
+
+	const unsigned char* data = m_file.GetData();
+	size_t size = m_file.GetSize();
+	const CookedAssetHeader* header = reinterpret_cast<const CookedAssetHeader*>(data);
+	if (size < sizeof(CookedAssetHeader) || header->m_magic != COOKED_ASSET_MAGIC || header->m_contentHash != key.m_contentHash)
+	{
+		Close();
+		return false;
+	}
+
+	// a stale source is the normal reason to re-cook, a version mismatch is worth saying out loud
+	if (header->m_version < COOKED_ASSET_MIN_VERSION || header->m_version > COOKED_ASSET_VERSION || header->m_importerVersion != key.m_importerVersion)
+	{
+		DebuggerPrintf(Stringf("[COOK] %s: container v%u importer v%u, reading v%u-%u importer v%u, re-importing\n", cookedPath.c_str(),
+			header->m_version, header->m_importerVersion, COOKED_ASSET_MIN_VERSION, COOKED_ASSET_VERSION, key.m_importerVersion).c_str());
+		Close();
+		return false;
+	}
+
+	size_t tableEnd = sizeof(CookedAssetHeader) + sizeof(CookedSection) * header->m_sectionCount;
+	if (tableEnd + header->m_sourcePathSize > size
+		|| key.m_sourcePath.size() != header->m_sourcePathSize
+		|| memcmp(data + tableEnd, key.m_sourcePath.data(), header->m_sourcePathSize) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	const CookedSection* sections = reinterpret_cast<const CookedSection*>(data + sizeof(CookedAssetHeader));
+	for (uint32_t idx = 0; idx < header->m_sectionCount; idx++)
+	{
+		if (sections[idx].m_offset + sections[idx].m_size > size)
+		{
+			Close(); // truncated file
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_sections = sections;
+	if (!DecompressSections())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool CookedAssetView::DecompressSections()
+{
+	struct BlockJob
+	{
+		CompressedBlockView* m_view;
+		uint8_t*             m_dst;
+		int                  m_blockIdx;
+	};
+
+	// gather every block first so small and large sections share the same workers
+	std::vector<CompressedBlockView> views(m_header->m_sectionCount);
+	std::vector<BlockJob> jobs;
+	m_decompressed.resize(m_header->m_sectionCount);
+	for (uint32_t idx = 0; idx < m_header->m_sectionCount; idx++)
+	{
+		const CookedSection& section = m_sections[idx];
+		if (section.m_compression == CookedCompression::NONE)
+			continue;
+
+		if (section.m_compression != CookedCompression::LZ_BLOCKS
+			|| !views[idx].Parse(m_file.GetData() + section.m_offset, (size_t)section.m_size)
+			|| views[idx].GetRawSize() != section.m_rawSize)
+		{
+			return false;
+		}
+
+		m_decompressed[idx].resize((size_t)section.m_rawSize);
+		for (int blockIdx = 0; blockIdx < views[idx].GetBlockCount(); blockIdx++)
+			jobs.push_back({ &views[idx], m_decompressed[idx].data() + views[idx].GetBlockRawOffset(blockIdx), blockIdx });
+	}
+
+	std::atomic<bool> isValid(true);
+	ParallelFor((int)jobs.size(), [&](int jobIdx)
+	{
+		if (!jobs[jobIdx].m_view->DecompressBlock(jobs[jobIdx].m_blockIdx, jobs[jobIdx].m_dst))
+			isValid = false;
+	});
+	return isValid;
+}
+
+void CookedAssetView::Close()
+{
+	m_file.Close();
+	m_header = nullptr;
+	m_sections = nullptr;
+	m_decompressed.clear();
+}
+
+size_t CookedAssetView::GetOwnedBytes() const
+{
+	size_t bytes = 0;
+	for (auto& section : m_decompressed)
+		bytes += section.size();
+	return bytes;
+}
+
+const CookedSection* CookedAssetView::FindSection(uint32_t id) const
+{
+	if (!m_header)
+		return nullptr;
+
+	for (uint32_t idx = 0; idx < m_header->m_sectionCount; idx++)
+	{
+		if (m_sections[idx].m_id == id)
+			return &m_sections[idx];
+	}
+	return nullptr;
+}
+
+const void* CookedAssetView::GetSectionData(uint32_t id, size_t& outSize) const
+{
+	const CookedSection* section = FindSection(id);
+	if (!section)
+	{
+		outSize = 0;
+		return nullptr;
+	}
+
+	outSize = (size_t)section->m_rawSize;
+	if (section->m_compression != CookedCompression::NONE)
+		return m_decompressed[section - m_sections].data();
+	return m_file.GetData() + section->m_offset;
+}
+
+uint32_t CookedAssetView::GetSectionVersion(uint32_t id) const
+{
+	const CookedSection* section = FindSection(id);
+	return section ? section->m_version : 0;
+}
+
+bool CookedAssetView::ReadString(uint32_t id, std::string& out) const
+{
+	size_t size = 0;
+	const char* data = static_cast<const char*>(GetSectionData(id, size));
+	if (!data)
+		return false;
+
+	out.assign(data, size);
+	return true;
+}
+
+bool CookedAssetView::ReadSectionBlob(uint32_t id, ByteBuffer& buffer) const
+{
+	size_t size = 0;
+	const void* data = GetSectionData(id, size);
+	if (!data)
+		return false;
+
+	buffer.m_data.assign(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+	buffer.ResetRead();
+	return true;
+}
+
+SkeletalMeshStreams SkeletalMeshStreams::FromMesh(const SkeletalMesh& mesh)
+{
+	SkeletalMeshStreams streams;
+	streams.m_positions = mesh.m_vertices.data();
+	streams.m_normals = mesh.m_normals.data();
+	streams.m_uvs = mesh.m_uvs[0].data();
+	streams.m_boneIds = mesh.m_boneIndices.data();
+	streams.m_boneWeights = mesh.m_boneWeights.data();
+	streams.m_indices = mesh.m_indices.data();
+	streams.m_vertexCount = mesh.m_vertices.size();
+	streams.m_indexCount = mesh.m_indices.size();
+	return streams;
+}
+
+template<typename VectorType>
+using StreamElement = typename std::decay_t<VectorType>::value_type;
+
+template<typename T>
+void CopySection(const void* src, size_t count, std::vector<T>& dst)
+{
+	const T* begin = static_cast<const T*>(src);
+	if (begin)
+		dst.assign(begin, begin + count);
+	else
+		dst.clear();
+}
+
+bool WriteCookedMesh(const std::string& cookedPath, const CookedAssetKey& key, const SkeletalMesh& mesh, const MorphTargetSet& morphs, const std::vector<SkeletalSubmesh>& submeshes, const SkeletalMeshLodSet& lods, bool compressStreams)
+{
+	// name and skeleton go through the regular serializer, vertex streams are stored as arrays
+	SkeletalMesh shell;
+	shell.m_name = mesh.m_name;
+	shell.m_skeleton = mesh.m_skeleton;
+
+	ByteBuffer meta;
+	shell.WriteBytes(&meta);
+	ByteBuffer morphBlob;
+	morphs.WriteBytes(&morphBlob);
+
+	std::vector<CookedSubmesh> submeshTable;
+	std::string submeshNames;
+	for (auto& submesh : submeshes)
+	{
+		CookedSubmesh& cooked = submeshTable.emplace_back();
+		cooked.m_nameOffset = (uint32_t)submeshNames.size();
+		cooked.m_nameSize = (uint32_t)submesh.m_name.size();
+		cooked.m_vertexStart = submesh.m_vertexStart;
+		cooked.m_vertexCount = submesh.m_vertexCount;
+		cooked.m_indexStart = submesh.m_indexStart;
+		cooked.m_indexCount = submesh.m_indexCount;
+		submeshNames += submesh.m_name;
+	}
+
+	CookedAssetWriter writer;
+	writer.AddSection(SECTION_META, META_VERSION, meta);
+	writer.AddSection(SECTION_MRPH, MRPH_VERSION, morphBlob);
+	writer.AddArray(SECTION_SUBM, SUBM_VERSION, submeshTable);
+	writer.AddSection(SECTION_SNAM, SUBM_VERSION, submeshNames);
+	writer.AddArray(SECTION_VPOS, STREAM_VERSION, mesh.m_vertices, compressStreams);
+	writer.AddArray(SECTION_VNRM, STREAM_VERSION, mesh.m_normals, compressStreams);
+	writer.AddArray(SECTION_VUV0, STREAM_VERSION, mesh.m_uvs[0], compressStreams);
+	writer.AddArray(SECTION_VBID, STREAM_VERSION, mesh.m_boneIndices, compressStreams);
+	writer.AddArray(SECTION_VBWT, STREAM_VERSION, mesh.m_boneWeights, compressStreams);
+	writer.AddArray(SECTION_INDX, STREAM_VERSION, mesh.m_indices, compressStreams);
+	writer.AddArray(SECTION_LODS, LOD_VERSION, lods.m_lods);
+	writer.AddArray(SECTION_LIDX, LOD_VERSION, lods.m_indices, compressStreams);
+	return writer.Write(cookedPath, key);
+}
+
+bool ReadCookedMesh(const CookedAssetView& view, SkeletalMesh& outMeshShell, MorphTargetSet& outMorphs, SkeletalMeshStreams& outStreams, std::vector<SkeletalSubmesh>& outSubmeshes, std::vector<SkeletalMeshLod>& outLods)
+{
+	ByteBuffer blob;
+	if (!view.ReadSectionBlob(SECTION_META, blob))
+		return false;
+	outMeshShell.ReadBytes(&blob);
+
+	if (view.ReadSectionBlob(SECTION_MRPH, blob))
+		outMorphs.ReadBytes(&blob);
+	else
+		outMorphs.Clear();
+
+	outSubmeshes.clear();
+	std::vector<CookedSubmesh> submeshTable;
+	std::string submeshNames;
+	if (view.GetSectionVersion(SECTION_SUBM) >= 1 && view.ReadArray(SECTION_SUBM, submeshTable) && view.ReadString(SECTION_SNAM, submeshNames))
+	{
+		for (auto& cooked : submeshTable)
+		{
+			if ((size_t)cooked.m_nameOffset + cooked.m_nameSize > submeshNames.size())
+				return false;
+
+			SkeletalSubmesh& submesh = outSubmeshes.emplace_back();
+			submesh.m_name.assign(submeshNames, cooked.m_nameOffset, cooked.m_nameSize);
+			submesh.m_vertexStart = cooked.m_vertexStart;
+			submesh.m_vertexCount = cooked.m_vertexCount;
+			submesh.m_indexStart = cooked.m_indexStart;
+			submesh.m_indexCount = cooked.m_indexCount;
+		}
+	}
+	else if (view.ReadSectionBlob(SECTION_SUBM, blob))
+	{
+		// version 0, one field at a time
+		int submeshCount = 0;
+		blob.Read(submeshCount);
+		outSubmeshes.resize(submeshCount);
+		for (auto& submesh : outSubmeshes)
+		{
+			submesh.m_name = blob.ReadString();
+			blob.Read(submesh.m_vertexStart);
+			blob.Read(submesh.m_vertexCount);
+			blob.Read(submesh.m_indexStart);
+			blob.Read(submesh.m_indexCount);
+		}
+	}
+
+	size_t normalCount = 0;
+	size_t uvCount = 0;
+	size_t boneIdCount = 0;
+	size_t boneWeightCount = 0;
+	outStreams.m_positions = view.GetArray<Vec3>(SECTION_VPOS, outStreams.m_vertexCount);
+	outStreams.m_normals = view.GetArray<Vec3>(SECTION_VNRM, normalCount);
+	outStreams.m_uvs = view.GetArray<StreamElement<decltype(outMeshShell.m_uvs[0])>>(SECTION_VUV0, uvCount);
+	outStreams.m_boneIds = view.GetArray<StreamElement<decltype(outMeshShell.m_boneIndices)>>(SECTION_VBID, boneIdCount);
+	outStreams.m_boneWeights = view.GetArray<StreamElement<decltype(outMeshShell.m_boneWeights)>>(SECTION_VBWT, boneWeightCount);
+	outStreams.m_indices = view.GetArray<StreamElement<decltype(outMeshShell.m_indices)>>(SECTION_INDX, outStreams.m_indexCount);
+
+	// older cooks have no lods or lods made by an older simplifier, the caller regenerates them, see HasCookedLods
+	outLods.clear();
+	outStreams.m_lodIndices = nullptr;
+	outStreams.m_lodIndexCount = 0;
+	if (HasCookedLods(view) && view.ReadArray(SECTION_LODS, outLods))
+	{
+		outStreams.m_lodIndices = view.GetArray<StreamElement<decltype(outMeshShell.m_indices)>>(SECTION_LIDX, outStreams.m_lodIndexCount);
+		for (auto& lod : outLods)
+		{
+			if ((size_t)lod.m_indexStart + lod.m_indexCount > outStreams.m_lodIndexCount)
+				return false;
+		}
+	}
+
+	// older cooks without a submesh table hold exactly one mesh
+	if (outSubmeshes.empty())
+	{
+		SkeletalSubmesh& submesh = outSubmeshes.emplace_back();
+		submesh.m_name = outMeshShell.m_name;
+		submesh.m_vertexCount = (int)outStreams.m_vertexCount;
+		submesh.m_indexCount = (int)outStreams.m_indexCount;
+	}
+
+	return outStreams.m_vertexCount > 0
+		&& normalCount == outStreams.m_vertexCount
+		&& uvCount == outStreams.m_vertexCount
+		&& boneIdCount == outStreams.m_vertexCount
+		&& boneWeightCount == outStreams.m_vertexCount
+		&& outStreams.m_indexCount > 0;
+}
+
+bool WriteCookedSkeleton(const std::string& cookedPath, const CookedAssetKey& key, const Skeleton& skeleton)
+{
+	// the same meta section as a cooked mesh, just without any streams
+	SkeletalMesh shell;
+	shell.m_skeleton = skeleton;
+
+	ByteBuffer meta;
+	shell.WriteBytes(&meta);
+
+	CookedAssetWriter writer;
+	writer.AddSection(SECTION_META, META_VERSION, meta);
+	return writer.Write(cookedPath, key);
+}
+
+bool ReadCookedSkeleton(const CookedAssetView& view, Skeleton& outSkeleton)
+{
+	ByteBuffer blob;
+	if (!view.ReadSectionBlob(SECTION_META, blob))
+		return false;
+
+	SkeletalMesh shell;
+	shell.ReadBytes(&blob);
+	outSkeleton = shell.m_skeleton;
+	return outSkeleton.size() > 0;
+}
+
+bool HasCookedLods(const CookedAssetView& view)
+{
+	return view.GetSectionVersion(SECTION_LODS) == LOD_VERSION;
+}
+
+void CopyStreamsToMesh(const SkeletalMeshStreams& streams, SkeletalMesh& mesh)
+{
+	CopySection(streams.m_positions, streams.m_vertexCount, mesh.m_vertices);
+	CopySection(streams.m_normals, streams.m_vertexCount, mesh.m_normals);
+	CopySection(streams.m_uvs, streams.m_vertexCount, mesh.m_uvs[0]);
+	CopySection(streams.m_boneIds, streams.m_vertexCount, mesh.m_boneIndices);
+	CopySection(streams.m_boneWeights, streams.m_vertexCount, mesh.m_boneWeights);
+	CopySection(streams.m_indices, streams.m_indexCount, mesh.m_indices);
+}
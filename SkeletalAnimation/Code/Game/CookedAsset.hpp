@@ -0,0 +1,202 @@
+#pragma once
+
+#include "AssetCache.hpp"
+#include "MappedFile.hpp"
+
+#include "Engine/Math/Vec3.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ByteBuffer;
+class MorphTargetSet;
+class SkeletalMesh;
+class Skeleton;
+
+constexpr uint32_t MakeSectionId(char a, char b, char c, char d)
+{
+	return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+constexpr uint32_t COOKED_ASSET_MAGIC     = MakeSectionId('S', 'K', 'A', 'C');
+constexpr uint32_t COOKED_ASSET_VERSION    = 4; // container layout, 3 added per section versions, 4 aligned payloads to 64 bytes
+constexpr uint32_t COOKED_ASSET_MIN_VERSION = 2; // oldest container still read, newer payload layouts are upgraded on read
+constexpr uint32_t COOKED_ASSET_ALIGNMENT  = 64; // cache line, arrays inside a section can keep their own line alignment
+constexpr uint32_t COOKED_ASSET_BLOCK_SIZE = 64 * 1024; // raw bytes per independently compressed block
+
+// relocatable layout: header, section table, source path, then cache line aligned section payloads
+// offsets are from the start of the file, so the file can be mapped anywhere and used in place
+// a byte swapped magic means the file was cooked for the other endianness and is rejected
+// the container version covers this layout, each section carries the version of its own payload,
+// so a payload change only needs a reader for the old version instead of a re-import of every asset
+struct CookedAssetHeader
+{
+public:
+	uint32_t m_magic           = COOKED_ASSET_MAGIC;
+	uint32_t m_version         = COOKED_ASSET_VERSION;
+	uint32_t m_importerVersion = 0;
+	uint32_t m_sectionCount    = 0;
+	uint64_t m_contentHash     = 0;
+	uint32_t m_sourcePathSize  = 0;
+	uint32_t m_reserved        = 0;
+};
+
+enum class CookedCompression : uint32_t
+{
+	NONE,
+	LZ_BLOCKS, // see CompressToBlocks
+};
+
+struct CookedSection
+{
+public:
+	uint32_t          m_id          = 0;
+	uint32_t          m_elementSize = 0;
+	uint64_t          m_offset      = 0;
+	uint64_t          m_size        = 0; // stored bytes
+	uint64_t          m_rawSize     = 0;
+	CookedCompression m_compression = CookedCompression::NONE;
+	uint32_t          m_version     = 0; // payload layout, 0 in containers before version 3
+};
+
+class CookedAssetWriter
+{
+public:
+	void AddSection(uint32_t id, uint32_t version, const void* data, size_t elementSize, size_t count, bool compress = false);
+	void AddSection(uint32_t id, uint32_t version, const ByteBuffer& blob, bool compress = false);
+	void AddSection(uint32_t id, uint32_t version, const std::string& text) { AddSection(id, version, text.data(), 1, text.size()); }
+
+	template<typename T>
+	void AddArray(uint32_t id, uint32_t version, const std::vector<T>& data, bool compress = false)
+	{
+		AddSection(id, version, data.data(), sizeof(T), data.size(), compress);
+	}
+
+	bool Write(const std::string& cookedPath, const CookedAssetKey& key) const; // see AssetCache::WriteCooked
+
+private:
+	struct PendingSection
+	{
+		CookedSection        m_section;
+		std::vector<uint8_t> m_data;
+	};
+	std::vector<PendingSection> m_sections;
+};
+
+// uncompressed sections are used in place from the mapping, compressed ones are decompressed
+// into owned memory on open, all blocks of all sections in parallel
+class CookedAssetView
+{
+public:
+	CookedAssetView() = default;
+	CookedAssetView(CookedAssetView&& moveFrom) noexcept;
+	CookedAssetView& operator=(CookedAssetView&& moveFrom) noexcept;
+
+	bool Open(const std::string& cookedPath, const CookedAssetKey& key);
+	void Close();
+	bool IsOpen() const { return m_file.IsOpen(); }
+	size_t GetOwnedBytes() const; // decompressed sections, what is used in place belongs to the os page cache
+
+	// older containers are readable, the loader rewrites them once their payload is in memory
+	uint32_t GetVersion() const       { return m_header ? m_header->m_version : 0; }
+	bool     IsCurrentVersion() const { return GetVersion() == COOKED_ASSET_VERSION; }
+
+	const CookedSection* FindSection(uint32_t id) const;
+	const void*          GetSectionData(uint32_t id, size_t& outSize) const;
+	uint32_t             GetSectionVersion(uint32_t id) const;
+
+	// in place, no copy
+	template<typename T>
+	const T* GetArray(uint32_t id, size_t& outCount) const
+	{
+		size_t size = 0;
+		const void* data = GetSectionData(id, size);
+		outCount = size / sizeof(T);
+		return static_cast<const T*>(data);
+	}
+
+	// one bulk copy, fails if the section is missing or was written with another element size
+	template<typename T>
+	bool ReadArray(uint32_t id, std::vector<T>& out) const
+	{
+		const CookedSection* section = FindSection(id);
+		if (!section || (section->m_elementSize != sizeof(T) && section->m_rawSize > 0))
+			return false;
+
+		size_t count = 0;
+		const T* data = GetArray<T>(id, count);
+		out.assign(data, data + count);
+		return true;
+	}
+
+	bool ReadString(uint32_t id, std::string& out) const;
+
+	// small structured blobs (skeleton, morphs) are still parsed through ByteBuffer
+	bool ReadSectionBlob(uint32_t id, ByteBuffer& buffer) const;
+
+private:
+	bool DecompressSections();
+
+private:
+	MappedFile                 m_file;
+	const CookedAssetHeader*   m_header   = nullptr;
+	const CookedSection*       m_sections = nullptr;
+	std::vector<std::vector<uint8_t>> m_decompressed; // per section, empty unless compressed
+};
+
+// contiguous vertex and index range of one source mesh inside a merged SkeletalMesh
+struct SkeletalSubmesh
+{
+public:
+	std::string m_name;
+	int         m_vertexStart = 0;
+	int         m_vertexCount = 0;
+	int         m_indexStart  = 0;
+	int         m_indexCount  = 0;
+};
+
+// simplified index range of the whole mesh, over the same vertex streams as lod 0
+struct SkeletalMeshLod
+{
+public:
+	uint32_t m_indexStart = 0; // into the lod index stream
+	uint32_t m_indexCount = 0;
+	float    m_error      = 0.0f; // largest rms distance of a kept vertex to the source planes it absorbed, mesh units
+	float    m_reserved   = 0.0f;
+};
+
+// lods 1 and up as generated at cook time
+struct SkeletalMeshLodSet
+{
+public:
+	std::vector<SkeletalMeshLod> m_lods;
+	std::vector<unsigned int>    m_indices;
+};
+
+// vertex streams either owned by a SkeletalMesh or used in place from a mapped cooked asset
+struct SkeletalMeshStreams
+{
+public:
+	const Vec3* m_positions   = nullptr;
+	const Vec3* m_normals     = nullptr;
+	const void* m_uvs         = nullptr;
+	const void* m_boneIds     = nullptr;
+	const void* m_boneWeights = nullptr;
+	const void* m_indices     = nullptr;
+	const void* m_lodIndices  = nullptr; // every lod's indices back to back, ranges in SkeletalMeshLod
+	size_t      m_vertexCount = 0;
+	size_t      m_indexCount  = 0;
+	size_t      m_lodIndexCount = 0;
+
+public:
+	static SkeletalMeshStreams FromMesh(const SkeletalMesh& mesh);
+};
+
+// compressed streams are read with less I/O and decompressed in parallel on open, uncompressed ones are used in place from the mapping
+bool WriteCookedMesh(const std::string& cookedPath, const CookedAssetKey& key, const SkeletalMesh& mesh, const MorphTargetSet& morphs, const std::vector<SkeletalSubmesh>& submeshes, const SkeletalMeshLodSet& lods, bool compressStreams = true);
+bool ReadCookedMesh(const CookedAssetView& view, SkeletalMesh& outMeshShell, MorphTargetSet& outMorphs, SkeletalMeshStreams& outStreams, std::vector<SkeletalSubmesh>& outSubmeshes, std::vector<SkeletalMeshLod>& outLods);
+bool WriteCookedSkeleton(const std::string& cookedPath, const CookedAssetKey& key, const Skeleton& skeleton);
+bool ReadCookedSkeleton(const CookedAssetView& view, Skeleton& outSkeleton); // from a cooked mesh or a skeleton of its own
+bool HasCookedLods(const CookedAssetView& view); // lods of the current simplifier were generated, an empty table means there was nothing to simplify
+void CopyStreamsToMesh(const SkeletalMeshStreams& streams, SkeletalMesh& mesh);
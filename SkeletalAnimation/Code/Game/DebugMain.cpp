@@ -81,6 +81,62 @@ void DebugBuffer()
 // 	UCHAR* p6 = clientBuffer.ResolveData(pkt6);
 }
 
+#include "BlockCompression.hpp"
+#include "CookedAsset.hpp"
+
+#include <string.h>
+#include <vector>
+
+bool RoundTripBlocks(const std::vector<uint8_t>& source, uint32_t blockSize)
+{
+	std::vector<uint8_t> packed;
+	CompressToBlocks(source.data(), source.size(), blockSize, packed);
+
+	CompressedBlockView view;
+	if (!view.Parse(packed.data(), packed.size()) || view.GetRawSize() != source.size())
+		return false;
+
+	std::vector<uint8_t> unpacked(source.size());
+	return view.DecompressAll(unpacked.data()) && unpacked == source;
+}
+
+void DebugBlockCompression()
+{
+	constexpr uint32_t blockSize = COOKED_ASSET_BLOCK_SIZE;
+
+	// fixed seed, the same bytes every run
+	uint32_t seed = 12345;
+	std::vector<uint8_t> noise(blockSize * 2 + 7);
+	for (uint8_t& byte : noise)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		byte = (uint8_t)(seed >> 24);
+	}
+
+	std::vector<uint8_t> pattern(blockSize * 2);
+	for (size_t idx = 0; idx < pattern.size(); idx++)
+		pattern[idx] = (uint8_t)((idx % 13) * (idx % 7));
+
+	ASSERT_OR_DIE(RoundTripBlocks(std::vector<uint8_t>(), blockSize), "LZ round trip failed on an empty input");
+	ASSERT_OR_DIE(RoundTripBlocks(std::vector<uint8_t>(noise.begin(), noise.begin() + 11), blockSize), "LZ round trip failed on an input shorter than the match limit");
+	ASSERT_OR_DIE(RoundTripBlocks(noise, blockSize), "LZ round trip failed on an incompressible input");
+	ASSERT_OR_DIE(RoundTripBlocks(std::vector<uint8_t>(pattern.begin(), pattern.begin() + blockSize), blockSize), "LZ round trip failed on exactly one block");
+	ASSERT_OR_DIE(RoundTripBlocks(pattern, blockSize), "LZ round trip failed on exactly two blocks");
+
+	// a block that does not shrink is stored raw, so incompressible data costs only the block table
+	std::vector<uint8_t> packed;
+	CompressToBlocks(noise.data(), noise.size(), blockSize, packed);
+	ASSERT_OR_DIE(packed.size() == 16 + sizeof(uint32_t) * 4 + noise.size(), "incompressible blocks were not stored raw");
+
+	// a single block compressed without the block container
+	std::vector<uint8_t> block;
+	CompressBlockLZ(pattern.data(), blockSize, block);
+	std::vector<uint8_t> unpacked(blockSize);
+	ASSERT_OR_DIE(block.size() < blockSize && DecompressBlockLZ(block.data(), block.size(), unpacked.data(), unpacked.size()), "LZ block did not decompress");
+	ASSERT_OR_DIE(memcmp(unpacked.data(), pattern.data(), blockSize) == 0, "LZ block round trip mismatch");
+	ASSERT_OR_DIE(!DecompressBlockLZ(block.data(), block.size(), unpacked.data(), unpacked.size() - 1), "LZ block decompressed into a short buffer");
+}
+
 #include "Engine/Animation/AssetImporter.hpp"
 #include "Engine/Core/FileUtils.hpp"
 #include "Engine/Core/ErrorWarningAssert.hpp"
@@ -100,6 +156,7 @@ bool DebugMain()
 {
 // 	DebugEulerToVec();
 // 	DebugBuffer();
+// 	DebugBlockCompression();
 
 // 	Transformation transform;
 // 	transform.m_position = Vec3(1.23f, 4.56f, 7.89f);
@@ -0,0 +1,128 @@
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <filesystem>
+
+std::string LowercaseExtension(std::string text)
+{
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return text;
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+void FileWatcher::AddDirectory(const std::string& dir, const std::string& extension)
+{
+	m_dirs.push_back({ dir, LowercaseExtension(extension) });
+}
+
+void FileWatcher::Start(float pollSeconds)
+{
+	if (m_isRunning)
+		return;
+
+	// baseline on the calling thread, files already present at start are not changes
+	Poll(true);
+	m_isRunning = true;
+	m_thread = std::thread([this, pollSeconds]() { Run(pollSeconds); });
+}
+
+void FileWatcher::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isRunning = false;
+	}
+	m_wake.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void FileWatcher::PopChanges(std::vector<std::string>& outPaths)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	outPaths.insert(outPaths.end(), m_changes.begin(), m_changes.end());
+	m_changes.clear();
+}
+
+bool FileWatcher::GetStamp(const std::string& path, FileStamp& outStamp)
+{
+	std::error_code error;
+	auto writeTime = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+
+	outStamp.m_writeTime = (int64_t)writeTime.time_since_epoch().count();
+	outStamp.m_size = size;
+	return true;
+}
+
+void FileWatcher::Run(float pollSeconds)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_isRunning)
+	{
+		m_wake.wait_for(lock, std::chrono::duration<float>(pollSeconds));
+		if (!m_isRunning)
+			break;
+
+		lock.unlock();
+		Poll(false);
+		lock.lock();
+	}
+}
+
+void FileWatcher::Poll(bool isBaseline)
+{
+	// stat everything without the lock, the main thread only ever waits for the merge below
+	std::vector<std::pair<std::string, FileStamp>> stamps;
+	for (auto& watched : m_dirs)
+	{
+		std::error_code error;
+		for (std::filesystem::directory_iterator iter(watched.m_dir, error), end; !error && iter != end; iter.increment(error))
+		{
+			if (!iter->is_regular_file(error) || LowercaseExtension(iter->path().extension().string()) != watched.m_extension)
+				continue;
+
+			std::string path = watched.m_dir + "/" + iter->path().filename().string();
+			FileStamp stamp;
+			if (GetStamp(path, stamp))
+				stamps.emplace_back(path, stamp);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& pair : stamps)
+	{
+		const std::string& path = pair.first;
+		const FileStamp& stamp = pair.second;
+
+		auto known = m_known.find(path);
+		if (isBaseline || (known != m_known.end() && known->second == stamp))
+		{
+			m_known[path] = stamp;
+			m_settling.erase(path);
+			continue;
+		}
+
+		auto settling = m_settling.find(path);
+		if (settling != m_settling.end() && settling->second == stamp)
+		{
+			m_known[path] = stamp;
+			m_settling.erase(settling);
+			m_changes.push_back(path);
+		}
+		else
+		{
+			m_settling[path] = stamp;
+		}
+	}
+}
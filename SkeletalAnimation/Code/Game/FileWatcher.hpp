@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// polls directories on its own thread and reports files whose size or write time changed
+// a change is only reported once the file stopped changing for a poll, so half written exports are skipped
+class FileWatcher
+{
+public:
+	FileWatcher() = default;
+	FileWatcher(const FileWatcher& copyFrom) = delete;
+	~FileWatcher();
+
+	void AddDirectory(const std::string& dir, const std::string& extension); // before Start, extension like ".fbx"
+	void Start(float pollSeconds);
+	void Stop();
+
+	// paths as "dir/file.ext", each change reported once
+	void PopChanges(std::vector<std::string>& outPaths);
+
+private:
+	struct FileStamp
+	{
+		int64_t   m_writeTime = 0;
+		uintmax_t m_size      = 0;
+
+		bool operator==(const FileStamp& other) const { return m_writeTime == other.m_writeTime && m_size == other.m_size; }
+	};
+
+	struct WatchedDir
+	{
+		std::string m_dir;
+		std::string m_extension;
+	};
+
+	void Run(float pollSeconds);
+	void Poll(bool isBaseline);
+	static bool GetStamp(const std::string& path, FileStamp& outStamp);
+
+private:
+	std::vector<WatchedDir>                    m_dirs;
+	std::unordered_map<std::string, FileStamp> m_known;    // last reported state
+	std::unordered_map<std::string, FileStamp> m_settling; // changed, waiting for one quiet poll
+	std::vector<std::string>                   m_changes;
+
+	std::mutex              m_mutex;
+	std::condition_variable m_wake;
+	std::thread             m_thread;
+	std::atomic<bool>       m_isRunning = false;
+};
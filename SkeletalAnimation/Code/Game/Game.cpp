@@ -1,8 +1,14 @@
 #include "Game.hpp"
 
 #include "App.hpp"
+#include "AssetCache.hpp"
+#include "AssetHotReload.hpp"
+#include "ClipStream.hpp"
+#include "ParallelFor.hpp"
+#include "ResourceManager.hpp"
 #include "SceneSkelAnim.hpp"
 #include "Scene.hpp"
+#include "SkeletonAsset.hpp"
 
 #include "Engine/Animation/AssetImporter.hpp"
 #include "Engine/Animation/SkeletalMesh.hpp"
@@ -25,6 +31,9 @@
 
 NetworkManagerClient* NET_CLIENT;
 NetworkManagerServer* NET_SERVER;
+ResourceManager* g_theResources = nullptr;
+
+constexpr int DEFAULT_RESOURCE_BUDGET_MB = 512;
 
 int CLIENT_ID = -1;
 
@@ -123,6 +132,24 @@ bool Command_Controls(EventArgs& args)
 	return true;
 }
 
+bool Command_Resources(EventArgs& args)
+{
+	UNUSED(args);
+
+	g_theResources->PrintStats();
+	PrintSkeletonStats();
+	PrintClipStreamStats();
+	return true;
+}
+
+bool Command_ResourceBudget(EventArgs& args)
+{
+	int budgetMB = args.GetValue("mb", (int)(g_theResources->GetBudget() / (1024 * 1024)));
+	g_theResources->SetBudget((size_t)budgetMB * 1024 * 1024);
+	g_theResources->PrintStats();
+	return true;
+}
+
 bool InitializeDebugCommands()
 {
 	g_theEventSystem->SubscribeEventCallbackFunction("Connect", Command_Connect);
@@ -131,6 +158,8 @@ bool InitializeDebugCommands()
 	g_theEventSystem->SubscribeEventCallbackFunction("Disconnect", Command_Disconnect);
 	g_theEventSystem->SubscribeEventCallbackFunction("Stop", Command_Stop);
 	g_theEventSystem->SubscribeEventCallbackFunction("Controls", Command_Controls);
+	g_theEventSystem->SubscribeEventCallbackFunction("Resources", Command_Resources);
+	g_theEventSystem->SubscribeEventCallbackFunction("ResourceBudget", Command_ResourceBudget);
 	// DebugAddMessage("", -5.0f, Rgba8(255, 0, 0), Rgba8(0, 255, 0));
 
 	NET_CLIENT->RegisterHandler(PacketType::MESSAGE, [](Packet& pkt) {
@@ -187,6 +216,11 @@ void Game::Initialize()
 
 	InitializeAudio();
 
+	int budgetMB = g_gameConfigBlackboard.GetValue("resourceBudgetMB", DEFAULT_RESOURCE_BUDGET_MB);
+	g_theResources = new ResourceManager((size_t)budgetMB * 1024 * 1024);
+	if (g_gameConfigBlackboard.GetValue("hotReload", 1) != 0)
+		m_hotReloader = new AssetHotReloader();
+
 	m_currentScene = new SceneSkelAnim(this);
 	m_currentScene->Initialize();
 }
@@ -202,6 +236,14 @@ void Game::Shutdown()
 	delete m_currentScene;
 	m_currentScene = nullptr;
 
+	// scenes and reload jobs hold the last handles, so resources go after them
+	delete m_hotReloader;
+	m_hotReloader = nullptr;
+	delete g_theResources;
+	g_theResources = nullptr;
+	ShutdownClipStreaming();
+	ShutdownParallelFor();
+
 	ShutdownAudio();
 
 	NET_CLIENT->ReleaseClient();
@@ -229,8 +271,19 @@ void Game::Update()
 		m_currentScene->Initialize();
 	}
 
+	// reloaded assets are swapped in before any scene touches them this frame
+	if (m_hotReloader)
+		m_hotReloader->Update();
+
+	// cooked files rewritten while their old version was still mapped, released by now if it was swapped out above
+	AssetCache::CommitPendingWrites();
+	AssetCache::SaveSourceStamps();
+
 	m_currentScene->Update();
 	m_currentScene->UpdateCamera();
+
+	// handles released this frame and clips that streamed more blocks in can leave the cache over budget
+	g_theResources->EvictToBudget();
 }
 
 void Game::InitializeAudio()
@@ -9,6 +9,7 @@ class RandomNumberGenerator;
 
 class Scene;
 class Map;
+class AssetHotReloader;
 class SoundClip;
 class SoundInst;
 
@@ -52,5 +53,7 @@ private:
 	Scene*                      m_newScene                       = nullptr;
 
 	Map*                        m_currentMap                     = nullptr;
+
+	AssetHotReloader*           m_hotReloader                    = nullptr;
 };
 
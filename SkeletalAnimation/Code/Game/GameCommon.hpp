@@ -19,6 +19,7 @@ class Game;
 class BitmapFont;
 class NetworkManagerClient;
 class NetworkManagerServer;
+class ResourceManager;
 
 extern App* g_theApp;
 extern InputSystem* g_theInput;
@@ -31,6 +32,8 @@ extern BitmapFont* g_testFont;
 extern NetworkManagerClient* NET_CLIENT;
 extern NetworkManagerServer* NET_SERVER;
 
+extern ResourceManager* g_theResources;
+
 enum class BillboardType
 {
 	NONE,
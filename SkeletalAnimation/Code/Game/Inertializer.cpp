@@ -0,0 +1,122 @@
+#include "Inertializer.hpp"
+
+#include "AnimUtils.hpp"
+
+#include "Engine/Animation/Quaternion.hpp"
+
+#include <math.h>
+
+constexpr float INERTIAL_EPSILON = 1e-5f;
+
+// twist angle of a rotation offset around axis, in radians
+float GetTwistAngle(const Quaternion& quat, const Vec3& axis)
+{
+	float projected = quat.x * axis.x + quat.y * axis.y + quat.z * axis.z;
+	return 2.0f * atan2f(projected, quat.w);
+}
+
+Quaternion GetRotationOffset(const Quaternion& from, const Quaternion& to)
+{
+	Quaternion offset = MultiplyQuaternions(from, GetConjugate(to));
+	if (offset.w < 0.0f)
+		offset = Quaternion(-offset.x, -offset.y, -offset.z, -offset.w);
+	return offset;
+}
+
+void InertialCurve::Initialize(float x0, float v0, float blendTime)
+{
+	*this = InertialCurve();
+	m_blendTime = blendTime;
+	if (x0 < INERTIAL_EPSILON || blendTime <= 0.0f)
+	{
+		m_blendTime = 0.0f;
+		return;
+	}
+
+	// offset must only shrink, velocity pointing away would overshoot
+	if (v0 > 0.0f)
+		v0 = 0.0f;
+	if (v0 < 0.0f)
+		m_blendTime = fminf(m_blendTime, -5.0f * x0 / v0);
+
+	float t1 = m_blendTime;
+	float t1Sq = t1 * t1;
+	float a0 = fmaxf((-8.0f * v0 * t1 - 20.0f * x0) / t1Sq, 0.0f);
+
+	m_x0 = x0;
+	m_v0 = v0;
+	m_a0 = a0;
+	m_a = -(a0 * t1Sq + 6.0f * v0 * t1 + 12.0f * x0) / (2.0f * t1Sq * t1Sq * t1);
+	m_b = (3.0f * a0 * t1Sq + 16.0f * v0 * t1 + 30.0f * x0) / (2.0f * t1Sq * t1Sq);
+	m_c = -(3.0f * a0 * t1Sq + 12.0f * v0 * t1 + 20.0f * x0) / (2.0f * t1Sq * t1);
+}
+
+float InertialCurve::Evaluate(float time) const
+{
+	if (time >= m_blendTime)
+		return 0.0f;
+
+	float t = time;
+	return (((((m_a * t + m_b) * t + m_c) * t + m_a0 * 0.5f) * t + m_v0) * t + m_x0);
+}
+
+void Inertializer::Begin(const std::vector<TransformQuat>& prevPose, const std::vector<TransformQuat>& prevPrevPose, const std::vector<TransformQuat>& targetPose, float deltaSeconds, float blendTime)
+{
+	m_offsets.resize(targetPose.size());
+	m_elapsed = 0.0f;
+	m_blendTime = blendTime;
+
+	float invDelta = deltaSeconds > 0.0f ? 1.0f / deltaSeconds : 0.0f;
+
+	for (size_t boneIdx = 0; boneIdx < targetPose.size(); boneIdx++)
+	{
+		const TransformQuat& prev = prevPose[boneIdx];
+		const TransformQuat& prevPrev = prevPrevPose[boneIdx];
+		const TransformQuat& target = targetPose[boneIdx];
+		BoneOffset& offset = m_offsets[boneIdx];
+
+		// translation channel, decayed along the offset direction
+		Vec3 posOffset = prev.m_position - target.m_position;
+		float posX0 = posOffset.GetLength();
+		offset.m_positionDir = posX0 > INERTIAL_EPSILON ? posOffset / posX0 : Vec3();
+		float posXPrev = DotProduct3D(prevPrev.m_position - target.m_position, offset.m_positionDir);
+		offset.m_position.Initialize(posX0, (posX0 - posXPrev) * invDelta, blendTime);
+
+		// rotation channel, decayed as an angle around the offset axis
+		Quaternion rotOffset = GetRotationOffset(prev.m_rotation, target.m_rotation);
+		float sinHalf = sqrtf(rotOffset.x * rotOffset.x + rotOffset.y * rotOffset.y + rotOffset.z * rotOffset.z);
+		float rotX0 = 2.0f * atan2f(sinHalf, rotOffset.w);
+		offset.m_rotationAxis = sinHalf > INERTIAL_EPSILON ? Vec3(rotOffset.x, rotOffset.y, rotOffset.z) / sinHalf : Vec3(1.0f, 0.0f, 0.0f);
+		float rotXPrev = GetTwistAngle(GetRotationOffset(prevPrev.m_rotation, target.m_rotation), offset.m_rotationAxis);
+		offset.m_rotation.Initialize(rotX0, (rotX0 - rotXPrev) * invDelta, blendTime);
+	}
+}
+
+void Inertializer::Apply(float deltaSeconds, std::vector<TransformQuat>& pose)
+{
+	if (!IsActive() || pose.size() != m_offsets.size())
+		return;
+
+	for (size_t boneIdx = 0; boneIdx < pose.size(); boneIdx++)
+	{
+		const BoneOffset& offset = m_offsets[boneIdx];
+		TransformQuat& transform = pose[boneIdx];
+
+		float posX = offset.m_position.Evaluate(m_elapsed);
+		if (posX != 0.0f)
+			transform.m_position += offset.m_positionDir * posX;
+
+		float rotX = offset.m_rotation.Evaluate(m_elapsed);
+		if (rotX != 0.0f)
+			transform.m_rotation = MultiplyQuaternions(Quaternion::FromAxisAndAngle(offset.m_rotationAxis, rotX), transform.m_rotation);
+	}
+
+	m_elapsed += deltaSeconds;
+}
+
+void Inertializer::Reset()
+{
+	m_offsets.clear();
+	m_elapsed = 0.0f;
+	m_blendTime = 0.0f;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Engine/Animation/Skeleton.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <vector>
+
+// quintic offset decay for one scalar channel, see Bollo "Inertialization" GDC 2018
+struct InertialCurve
+{
+public:
+	void  Initialize(float x0, float v0, float blendTime);
+	float Evaluate(float time) const;
+
+public:
+	float m_x0        = 0.0f;
+	float m_v0        = 0.0f;
+	float m_a0        = 0.0f;
+	float m_a         = 0.0f;
+	float m_b         = 0.0f;
+	float m_c         = 0.0f;
+	float m_blendTime = 0.0f;
+};
+
+// clip transitions without sampling the source clip again
+// the source pose offset and velocity are captured at the switch and decayed on top of the target clip
+class Inertializer
+{
+public:
+	void Begin(const std::vector<TransformQuat>& prevPose, const std::vector<TransformQuat>& prevPrevPose, const std::vector<TransformQuat>& targetPose, float deltaSeconds, float blendTime);
+	void Apply(float deltaSeconds, std::vector<TransformQuat>& pose);
+	void Reset();
+	bool IsActive() const { return m_elapsed < m_blendTime; }
+
+private:
+	struct BoneOffset
+	{
+		Vec3          m_positionDir;
+		Vec3          m_rotationAxis;
+		InertialCurve m_position;
+		InertialCurve m_rotation;
+	};
+
+	std::vector<BoneOffset> m_offsets;
+	float                   m_elapsed   = 0.0f;
+	float                   m_blendTime = 0.0f;
+};
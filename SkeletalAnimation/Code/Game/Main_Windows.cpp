@@ -2,6 +2,10 @@
 #include <windows.h>			// #include this (massive, platform-specific) header in very few places
 #include <objbase.h>
 #include "App.hpp"
+#include "AssetCooker.hpp"
+
+#include <stdio.h>
+#include <string.h>
 
 #define UNUSED(x) (void)(x);
 
@@ -11,9 +15,22 @@ bool DebugMain();
 int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR commandLineString, int)
 {
 	UNUSED(applicationInstanceHandle);
-	UNUSED(commandLineString);
 	::CoInitialize(nullptr);
 
+	// headless cook, no window, renderer or audio is created
+	if (strstr(commandLineString, "-cook"))
+	{
+		if (AttachConsole(ATTACH_PARENT_PROCESS) || AllocConsole())
+		{
+			FILE* stream = nullptr;
+			freopen_s(&stream, "CONOUT$", "w", stdout);
+		}
+
+		int failures = RunAssetCooker(commandLineString);
+		::CoUninitialize();
+		return failures;
+	}
+
 	g_theApp = new App();
 
 	if (!DebugMain())
@@ -0,0 +1,135 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN		// Always #define this before #including <windows.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(MappedFile&& moveFrom) noexcept
+{
+	*this = std::move(moveFrom);
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& moveFrom) noexcept
+{
+	if (this != &moveFrom)
+	{
+		// the view address does not change, pointers into the mapping stay valid
+		Close();
+		std::swap(m_data, moveFrom.m_data);
+		std::swap(m_size, moveFrom.m_size);
+		std::swap(m_fileHandle, moveFrom.m_fileHandle);
+		std::swap(m_mappingHandle, moveFrom.m_mappingHandle);
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* filePath)
+{
+	Close();
+
+	// share delete lets a recook rename its new file over this one where the file system allows it,
+	// the view keeps the old contents either way
+	HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle)
+		CloseHandle(m_fileHandle);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_fileHandle = nullptr;
+	m_mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const char* filePath)
+{
+	Close();
+
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat = {};
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference, a cooked file renamed over this one leaves it untouched
+	if (view == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = (size_t)fileStat.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
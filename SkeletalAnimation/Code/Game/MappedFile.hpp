@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+
+// read only memory mapped file, pages are brought in by the OS on first touch
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const MappedFile& copyFrom) = delete;
+	MappedFile(MappedFile&& moveFrom) noexcept;
+	~MappedFile();
+
+	MappedFile& operator=(MappedFile&& moveFrom) noexcept;
+
+	bool Open(const char* filePath);
+	void Close();
+
+	bool                 IsOpen() const  { return m_data != nullptr; }
+	const unsigned char* GetData() const { return m_data; }
+	size_t               GetSize() const { return m_size; }
+
+private:
+	const unsigned char* m_data          = nullptr;
+	size_t               m_size          = 0;
+	void*                m_fileHandle    = nullptr;
+	void*                m_mappingHandle = nullptr;
+};
@@ -0,0 +1,393 @@
+#include "MeshSimplifier.hpp"
+
+#include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <queue>
+#include <string.h>
+#include <unordered_map>
+
+// symmetric 4x4 plane quadric, upper triangle a2 ab ac ad b2 bc bd c2 cd d2
+struct Quadric
+{
+public:
+	void AddPlane(const Vec3& normal, float distance, float weight)
+	{
+		double a = normal.x, b = normal.y, c = normal.z, d = distance;
+		double terms[10] = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+		for (int idx = 0; idx < 10; idx++)
+			m[idx] += terms[idx] * weight;
+		m_weight += weight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		for (int idx = 0; idx < 10; idx++)
+			m[idx] += other.m[idx];
+		m_weight += other.m_weight;
+	}
+
+	double Evaluate(const Vec3& pos) const
+	{
+		double x = pos.x, y = pos.y, z = pos.z;
+		return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+			+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+			+ m[7] * z * z + 2.0 * m[8] * z
+			+ m[9];
+	}
+
+	// area weighted mean of the squared distances to the planes, in squared mesh units
+	double EvaluateMean(const Vec3& pos) const
+	{
+		return m_weight > 0.0 ? Evaluate(pos) / m_weight : 0.0;
+	}
+
+public:
+	double m[10] = {};
+	double m_weight = 0.0; // summed plane areas
+};
+
+struct CollapseCandidate
+{
+public:
+	float        m_cost  = 0.0f;
+	float        m_error = 0.0f; // squared distance part of the cost, mesh units
+	unsigned int m_from  = 0;
+	unsigned int m_to   = 0;
+	unsigned int m_fromStamp = 0;
+	unsigned int m_toStamp   = 0;
+
+	bool operator>(const CollapseCandidate& other) const { return m_cost > other.m_cost; }
+};
+
+class MeshSimplifier
+{
+public:
+	explicit MeshSimplifier(const SkeletalMeshStreams& streams);
+
+	void CollapseTo(size_t targetTriangleCount);
+	void AppendIndices(std::vector<unsigned int>& out) const;
+	size_t GetTriangleCount() const { return m_aliveCount; }
+	float  GetMaxError() const      { return sqrtf(m_maxError); } // mesh units
+
+private:
+	void  LockBordersAndSeams();
+	float GetSkinDistance(unsigned int a, unsigned int b) const;
+	void  PushEdge(unsigned int from, unsigned int to);
+	bool  IsCollapseValid(unsigned int from, unsigned int to) const;
+	void  Collapse(unsigned int from, unsigned int to);
+
+private:
+	const Vec3*          m_positions   = nullptr;
+	const unsigned char* m_boneIds     = nullptr; // UB4, same streams as the vertex buffers, may be missing
+	const float*         m_boneWeights = nullptr; // FLOAT4
+	size_t               m_vertexCount = 0;
+
+	std::vector<unsigned int>              m_triangles;
+	std::vector<bool>                      m_triangleAlive;
+	std::vector<std::vector<unsigned int>> m_vertexTriangles;
+	std::vector<Quadric>                   m_quadrics;
+	std::vector<unsigned int>              m_stamps;  // bumped whenever a vertex's quadric or fan changes
+	std::vector<bool>                      m_locked;
+	std::vector<bool>                      m_removed;
+	size_t                                 m_aliveCount = 0;
+	float                                  m_maxError   = 0.0f; // squared
+	double                                 m_inverseDiagonalSquared = 1.0; // cost scale
+
+	std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, std::greater<CollapseCandidate>> m_queue;
+};
+
+MeshSimplifier::MeshSimplifier(const SkeletalMeshStreams& streams)
+{
+	m_positions = streams.m_positions;
+	m_boneIds = static_cast<const unsigned char*>(streams.m_boneIds);
+	m_boneWeights = static_cast<const float*>(streams.m_boneWeights);
+	m_vertexCount = streams.m_vertexCount;
+
+	const unsigned int* indices = static_cast<const unsigned int*>(streams.m_indices);
+	m_triangles.assign(indices, indices + streams.m_indexCount - streams.m_indexCount % 3);
+	m_aliveCount = m_triangles.size() / 3;
+	m_triangleAlive.assign(m_aliveCount, true);
+	m_vertexTriangles.resize(m_vertexCount);
+	m_quadrics.resize(m_vertexCount);
+	m_stamps.assign(m_vertexCount, 0);
+	m_locked.assign(m_vertexCount, false);
+	m_removed.assign(m_vertexCount, false);
+
+	Vec3 boundsMin = m_positions[0];
+	Vec3 boundsMax = m_positions[0];
+	for (size_t vertIdx = 1; vertIdx < m_vertexCount; vertIdx++)
+	{
+		boundsMin = Vec3(std::min(boundsMin.x, m_positions[vertIdx].x), std::min(boundsMin.y, m_positions[vertIdx].y), std::min(boundsMin.z, m_positions[vertIdx].z));
+		boundsMax = Vec3(std::max(boundsMax.x, m_positions[vertIdx].x), std::max(boundsMax.y, m_positions[vertIdx].y), std::max(boundsMax.z, m_positions[vertIdx].z));
+	}
+	double diagonalSquared = (boundsMax - boundsMin).GetLengthSquared();
+	m_inverseDiagonalSquared = diagonalSquared > 0.0 ? 1.0 / diagonalSquared : 1.0;
+
+	// area weighted plane of every triangle, accumulated on its corners
+	for (unsigned int triIdx = 0; triIdx < (unsigned int)m_aliveCount; triIdx++)
+	{
+		const unsigned int* tri = &m_triangles[triIdx * 3];
+		Vec3 cross = CrossProduct3D(m_positions[tri[1]] - m_positions[tri[0]], m_positions[tri[2]] - m_positions[tri[0]]);
+		float doubleArea = cross.GetLength();
+		Vec3 normal = doubleArea > 0.0f ? cross / doubleArea : Vec3();
+		float distance = -DotProduct3D(normal, m_positions[tri[0]]);
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			m_quadrics[tri[corner]].AddPlane(normal, distance, 0.5f * doubleArea);
+			m_vertexTriangles[tri[corner]].push_back(triIdx);
+		}
+	}
+
+	LockBordersAndSeams();
+
+	for (size_t idx = 0; idx < m_triangles.size(); idx += 3)
+	{
+		for (int edge = 0; edge < 3; edge++)
+		{
+			unsigned int a = m_triangles[idx + edge];
+			unsigned int b = m_triangles[idx + (edge + 1) % 3];
+			PushEdge(a, b);
+			PushEdge(b, a);
+		}
+	}
+}
+
+void MeshSimplifier::LockBordersAndSeams()
+{
+	// weld by exact position so split vertices of one corner count as one
+	struct PositionKey
+	{
+		uint32_t m_bits[3];
+		bool operator==(const PositionKey& other) const { return memcmp(m_bits, other.m_bits, sizeof(m_bits)) == 0; }
+	};
+	struct PositionHash
+	{
+		size_t operator()(const PositionKey& key) const { return (size_t)((key.m_bits[0] * 73856093u) ^ (key.m_bits[1] * 19349663u) ^ (key.m_bits[2] * 83492791u)); }
+	};
+
+	std::unordered_map<PositionKey, unsigned int, PositionHash> firstAtPosition;
+	std::vector<unsigned int> welded(m_vertexCount);
+	for (unsigned int vertIdx = 0; vertIdx < (unsigned int)m_vertexCount; vertIdx++)
+	{
+		PositionKey key;
+		memcpy(key.m_bits, &m_positions[vertIdx], sizeof(key.m_bits));
+		auto inserted = firstAtPosition.emplace(key, vertIdx);
+		welded[vertIdx] = inserted.first->second;
+		if (!inserted.second)
+		{
+			m_locked[vertIdx] = true;
+			m_locked[inserted.first->second] = true;
+		}
+	}
+
+	// an edge used by a single triangle lies on an open border
+	std::unordered_map<uint64_t, int> edgeUses;
+	for (size_t idx = 0; idx < m_triangles.size(); idx += 3)
+	{
+		for (int edge = 0; edge < 3; edge++)
+		{
+			uint64_t a = welded[m_triangles[idx + edge]];
+			uint64_t b = welded[m_triangles[idx + (edge + 1) % 3]];
+			edgeUses[a < b ? (a << 32) | b : (b << 32) | a]++;
+		}
+	}
+	for (size_t idx = 0; idx < m_triangles.size(); idx += 3)
+	{
+		for (int edge = 0; edge < 3; edge++)
+		{
+			unsigned int a = m_triangles[idx + edge];
+			unsigned int b = m_triangles[idx + (edge + 1) % 3];
+			uint64_t wa = welded[a];
+			uint64_t wb = welded[b];
+			if (edgeUses[wa < wb ? (wa << 32) | wb : (wb << 32) | wa] == 1)
+			{
+				m_locked[a] = true;
+				m_locked[b] = true;
+			}
+		}
+	}
+}
+
+float MeshSimplifier::GetSkinDistance(unsigned int a, unsigned int b) const
+{
+	// L1 distance between the two influence sets, 0 for identical weights, 2 for disjoint bones
+	const unsigned char* idsA = m_boneIds + a * 4;
+	const unsigned char* idsB = m_boneIds + b * 4;
+	const float* weightsA = m_boneWeights + a * 4;
+	const float* weightsB = m_boneWeights + b * 4;
+
+	// unused slots have zero weight and often repeat bone 0, they never count as a shared influence
+	float distance = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		if (weightsA[i] == 0.0f)
+			continue;
+		float other = 0.0f;
+		for (int j = 0; j < 4; j++)
+		{
+			if (idsB[j] == idsA[i])
+				other += weightsB[j];
+		}
+		distance += fabsf(weightsA[i] - other);
+	}
+	for (int j = 0; j < 4; j++)
+	{
+		bool shared = false;
+		for (int i = 0; i < 4; i++)
+			shared |= weightsA[i] != 0.0f && idsA[i] == idsB[j];
+		if (!shared)
+			distance += weightsB[j];
+	}
+	return distance;
+}
+
+void MeshSimplifier::PushEdge(unsigned int from, unsigned int to)
+{
+	if (m_locked[from])
+		return;
+
+	Quadric quadric = m_quadrics[from];
+	quadric.Add(m_quadrics[to]);
+	double error = std::max(quadric.EvaluateMean(m_positions[to]), 0.0);
+	double cost = error;
+
+	// keep joints bending where they were weighted to bend
+	if (m_boneIds && m_boneWeights)
+		cost += MESH_LOD_SKIN_PENALTY * GetSkinDistance(from, to) * (m_positions[to] - m_positions[from]).GetLengthSquared();
+
+	CollapseCandidate candidate;
+	candidate.m_cost = (float)(cost * m_inverseDiagonalSquared);
+	candidate.m_error = (float)error;
+	candidate.m_from = from;
+	candidate.m_to = to;
+	candidate.m_fromStamp = m_stamps[from];
+	candidate.m_toStamp = m_stamps[to];
+	m_queue.push(candidate);
+}
+
+bool MeshSimplifier::IsCollapseValid(unsigned int from, unsigned int to) const
+{
+	// triangles that survive must not fold over or become slivers
+	for (unsigned int triIdx : m_vertexTriangles[from])
+	{
+		if (!m_triangleAlive[triIdx])
+			continue;
+
+		const unsigned int* tri = &m_triangles[triIdx * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;
+
+		Vec3 corners[3] = { m_positions[tri[0]], m_positions[tri[1]], m_positions[tri[2]] };
+		Vec3 before = CrossProduct3D(corners[1] - corners[0], corners[2] - corners[0]);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (tri[corner] == from)
+				corners[corner] = m_positions[to];
+		}
+		Vec3 after = CrossProduct3D(corners[1] - corners[0], corners[2] - corners[0]);
+
+		float lengths = before.GetLength() * after.GetLength();
+		if (lengths <= 0.0f || DotProduct3D(before, after) < 0.2f * lengths)
+			return false;
+	}
+	return true;
+}
+
+void MeshSimplifier::Collapse(unsigned int from, unsigned int to)
+{
+	std::vector<unsigned int>& toTriangles = m_vertexTriangles[to];
+	for (unsigned int triIdx : m_vertexTriangles[from])
+	{
+		if (!m_triangleAlive[triIdx])
+			continue;
+
+		unsigned int* tri = &m_triangles[triIdx * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+		{
+			m_triangleAlive[triIdx] = false;
+			m_aliveCount--;
+			continue;
+		}
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (tri[corner] == from)
+				tri[corner] = to;
+		}
+		toTriangles.push_back(triIdx);
+	}
+
+	m_vertexTriangles[from].clear();
+	m_removed[from] = true;
+	m_quadrics[to].Add(m_quadrics[from]);
+	m_stamps[to]++;
+
+	// drop dead triangles from the fan and requeue every edge around the kept vertex
+	toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [this](unsigned int triIdx) { return !m_triangleAlive[triIdx]; }), toTriangles.end());
+	for (unsigned int triIdx : toTriangles)
+	{
+		const unsigned int* tri = &m_triangles[triIdx * 3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (tri[corner] == to)
+				continue;
+			PushEdge(to, tri[corner]);
+			PushEdge(tri[corner], to);
+		}
+	}
+}
+
+void MeshSimplifier::CollapseTo(size_t targetTriangleCount)
+{
+	while (m_aliveCount > targetTriangleCount && !m_queue.empty())
+	{
+		CollapseCandidate candidate = m_queue.top();
+		m_queue.pop();
+
+		if (m_removed[candidate.m_from] || m_removed[candidate.m_to]
+			|| candidate.m_fromStamp != m_stamps[candidate.m_from] || candidate.m_toStamp != m_stamps[candidate.m_to])
+			continue; // stale
+
+		if (!IsCollapseValid(candidate.m_from, candidate.m_to))
+			continue;
+
+		Collapse(candidate.m_from, candidate.m_to);
+		m_maxError = std::max(m_maxError, candidate.m_error);
+	}
+}
+
+void MeshSimplifier::AppendIndices(std::vector<unsigned int>& out) const
+{
+	for (size_t triIdx = 0; triIdx < m_triangleAlive.size(); triIdx++)
+	{
+		if (m_triangleAlive[triIdx])
+			out.insert(out.end(), &m_triangles[triIdx * 3], &m_triangles[triIdx * 3] + 3);
+	}
+}
+
+void GenerateMeshLods(const SkeletalMeshStreams& streams, SkeletalMeshLodSet& outLods)
+{
+	outLods.m_lods.clear();
+	outLods.m_indices.clear();
+	if (streams.m_vertexCount == 0 || streams.m_indexCount < 3)
+		return;
+
+	// each lod continues collapsing from the previous one
+	MeshSimplifier simplifier(streams);
+	size_t sourceTriangleCount = simplifier.GetTriangleCount();
+	for (int lod = 1; lod < MESH_LOD_COUNT; lod++)
+	{
+		simplifier.CollapseTo(std::max((size_t)1, (size_t)(sourceTriangleCount * MESH_LOD_TRIANGLE_RATIOS[lod])));
+
+		SkeletalMeshLod& meshLod = outLods.m_lods.emplace_back();
+		meshLod.m_indexStart = (uint32_t)outLods.m_indices.size();
+		simplifier.AppendIndices(outLods.m_indices);
+		meshLod.m_indexCount = (uint32_t)outLods.m_indices.size() - meshLod.m_indexStart;
+		meshLod.m_error = simplifier.GetMaxError();
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CookedAsset.hpp"
+
+constexpr int   MESH_LOD_COUNT = 4; // lod 0 is the source index buffer
+constexpr float MESH_LOD_TRIANGLE_RATIOS[MESH_LOD_COUNT] = { 1.0f, 0.5f, 0.25f, 0.125f };
+constexpr float MESH_LOD_SCREEN_SIZES[MESH_LOD_COUNT]    = { 1.0f, 0.4f, 0.2f, 0.1f }; // lod i below this fraction of screen height
+constexpr float MESH_LOD_HYSTERESIS = 0.1f; // a lod is left only this fraction past its switch size, so it does not flicker at the boundary
+constexpr float MESH_LOD_SKIN_PENALTY = 4.0f; // per squared edge length collapsed across differing weights, like a squared distance off the surface
+
+// quadric error metric edge collapse over the merged mesh, run at cook time
+// vertices only ever collapse onto a neighbour, so every lod indexes the source streams and skin weights stay exact
+// border and seam vertices (same position, split uv or normal) never move, so no cracks open
+// costs are squared distances over the squared bounds diagonal, so the same mesh at any scale simplifies the same way
+void GenerateMeshLods(const SkeletalMeshStreams& streams, SkeletalMeshLodSet& outLods);
@@ -0,0 +1,419 @@
+#include "ModelLoader.hpp"
+#include "AnimClip.hpp"
+#include "AssetCache.hpp"
+#include "AssetCooker.hpp"
+#include "MeshSimplifier.hpp"
+
+#include "Engine/Animation/Animation.hpp"
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Time.hpp"
+
+#include <string.h>
+
+constexpr bool USE_COOKED_ASSETS        = true;
+constexpr bool PLAY_ENGINE_ANIMATION    = false; // scenes play the engine curves instead of the baked clip, not cooked
+constexpr bool TEST_CONV_ANIM_TO_FRAMES = false; // with PLAY_ENGINE_ANIMATION, play the curves baked to frames
+
+enum LoadStage
+{
+	LOAD_STAGE_QUEUED,
+	LOAD_STAGE_MODEL,
+	LOAD_STAGE_SOURCE_SKELETON,
+	LOAD_STAGE_ANIMATION,
+	LOAD_STAGE_DONE,
+};
+
+LoadedModel::~LoadedModel()
+{
+	Release();
+}
+
+void LoadedModel::Release()
+{
+	delete m_mesh;
+	m_mesh = nullptr;
+	m_cookedMesh.Close();
+	m_streams = SkeletalMeshStreams();
+	m_morphs.Clear();
+	m_submeshes.clear();
+	m_lodSet.m_lods.clear();
+	m_lodSet.m_indices.clear();
+	m_skeleton.reset();
+	m_rejectedMeshes.clear();
+}
+
+LoadedAnimation::~LoadedAnimation()
+{
+	Release();
+}
+
+void LoadedAnimation::Release()
+{
+	delete m_animation;
+	m_animation = nullptr;
+	delete m_clip;
+	m_clip = nullptr;
+	m_skeleton.reset();
+}
+
+std::string GetModelSourcePath(const std::string& name)
+{
+	return FindModelSourcePath("Data/Models", name);
+}
+
+std::string GetCookedModelPath(const std::string& name, const MeshSelection& selection)
+{
+	// each mesh selection of a file is cooked separately
+	if (selection.IsDefault())
+		return AssetCache::GetCookedPath("SKEL", name.c_str());
+
+	std::string cookedName = Stringf("%s_%08x", name.c_str(), (unsigned int)HashBytes(selection.GetSource().data(), selection.GetSource().size()));
+	return AssetCache::GetCookedPath("SKEL", cookedName.c_str());
+}
+
+std::string GetCookedSkeletonPath(const std::string& name)
+{
+	return AssetCache::GetCookedPath("RIG", name.c_str());
+}
+
+std::string GetCookedClipPath(const std::string& name, uint64_t skeletonHash)
+{
+	// clips are bound to a skeleton, so the same file on two rigs gets two cooked clips
+	std::string cookedName = Stringf("%s_%08x", name.c_str(), (unsigned int)skeletonHash);
+	return AssetCache::GetCookedPath("ANIM", cookedName.c_str());
+}
+
+std::string GetCookedClipLibraryPath(const std::string& name, uint64_t skeletonHash)
+{
+	std::string cookedName = Stringf("%s_%08x", name.c_str(), (unsigned int)skeletonHash);
+	return AssetCache::GetCookedPath("CLIB", cookedName.c_str());
+}
+
+std::string GetCookedVertexAnimationPath(const std::string& model, const std::string& animation)
+{
+	std::string cookedName = model == animation ? model : model + "_" + animation;
+	return AssetCache::GetCookedPath("VAT", cookedName.c_str());
+}
+
+CookedAssetKey MakeVertexAnimationKey(const std::string& model, const std::string& animation, uint64_t skeletonHash)
+{
+	// same key as the model's own clip, a clip from another file also depends on the model's source
+	CookedAssetKey key = AssetCache::MakeKey(GetModelSourcePath(animation).c_str(), skeletonHash);
+	if (model != animation && key.m_contentHash != 0)
+	{
+		CookedAssetKey modelKey = AssetCache::MakeKey(GetModelSourcePath(model).c_str());
+		key.m_contentHash = modelKey.m_contentHash != 0 ? HashBytes(&modelKey.m_contentHash, sizeof(modelKey.m_contentHash), key.m_contentHash) : 0;
+	}
+	return key;
+}
+
+// simplifies whatever the streams point at, the generated indices are owned by the lod set
+void GenerateModelLods(LoadedModel& out)
+{
+	double startTime = GetCurrentTimeSeconds();
+	GenerateMeshLods(out.m_streams, out.m_lodSet);
+	out.m_streams.m_lodIndices = out.m_lodSet.m_indices.data();
+	out.m_streams.m_lodIndexCount = out.m_lodSet.m_indices.size();
+
+	std::string triangles = Stringf("%d", (int)(out.m_streams.m_indexCount / 3));
+	for (auto& lod : out.m_lodSet.m_lods)
+		triangles += Stringf(" / %d", (int)(lod.m_indexCount / 3));
+	DebuggerPrintf(Stringf("[COOK] %s: lods %s triangles in %.0f ms\n", out.m_name.c_str(), triangles.c_str(), (GetCurrentTimeSeconds() - startTime) * 1000.0).c_str());
+}
+
+bool LoadModelData(const char* name, const MeshSelection& selection, LoadedModel& out, const LoadProgress* progress)
+{
+	out.Release();
+	out.m_name = name;
+	out.m_selection = selection;
+
+	std::string filePath = GetModelSourcePath(name);
+	std::string cookedPath = GetCookedModelPath(name, selection);
+	CookedAssetKey cookedKey = AssetCache::MakeKey(filePath.c_str());
+
+	// map cooked mesh, vertex data stays in the view
+	if (USE_COOKED_ASSETS && out.m_cookedMesh.Open(cookedPath, cookedKey))
+	{
+		out.m_mesh = new SkeletalMesh();
+		if (!ReadCookedMesh(out.m_cookedMesh, *out.m_mesh, out.m_morphs, out.m_streams, out.m_submeshes, out.m_lodSet.m_lods))
+		{
+			delete out.m_mesh;
+			out.m_mesh = nullptr;
+			out.m_cookedMesh.Close();
+		}
+		else if (!out.m_cookedMesh.IsCurrentVersion() || !HasCookedLods(out.m_cookedMesh))
+		{
+			// older container or cooked before the current lods, take the streams out of the mapping and rewrite it in the current layout
+			if (progress)
+				progress->Set(0.2f);
+			CopyStreamsToMesh(out.m_streams, *out.m_mesh);
+			out.m_cookedMesh.Close();
+			out.m_streams = SkeletalMeshStreams::FromMesh(*out.m_mesh);
+			GenerateModelLods(out);
+			if (progress)
+				progress->Set(0.9f);
+			WriteCookedMesh(cookedPath, cookedKey, *out.m_mesh, out.m_morphs, out.m_submeshes, out.m_lodSet);
+			DebuggerPrintf(Stringf("[COOK] %s: upgraded to container v%u\n", cookedPath.c_str(), COOKED_ASSET_VERSION).c_str());
+		}
+	}
+
+	// cooked asset missing or stale, import and cook
+	if (!out.m_mesh)
+	{
+		out.m_mesh = ImportSkeletalMesh(filePath.c_str(), selection, out.m_morphs, out.m_submeshes, out.m_rejectedMeshes);
+		if (!out.m_mesh)
+			return false;
+
+		// import is the bulk of the step, then lods, then the write
+		if (progress)
+			progress->Set(0.6f);
+		out.m_streams = SkeletalMeshStreams::FromMesh(*out.m_mesh);
+		GenerateModelLods(out);
+		if (progress)
+			progress->Set(0.9f);
+
+		if (USE_COOKED_ASSETS)
+			WriteCookedMesh(cookedPath, cookedKey, *out.m_mesh, out.m_morphs, out.m_submeshes, out.m_lodSet);
+	}
+
+	// identical rigs across files share one skeleton
+	out.m_skeleton = AcquireSkeleton(out.m_mesh->m_skeleton);
+	out.m_mesh->m_skeleton = Skeleton();
+	if (progress)
+		progress->Set(1.0f);
+	return true;
+}
+
+bool LoadSkeletonData(const char* name, SkeletonRef& out, const LoadProgress* progress)
+{
+	out.reset();
+
+	std::string filePath = GetModelSourcePath(name);
+	std::string cookedPath = GetCookedSkeletonPath(name);
+	CookedAssetKey cookedKey = AssetCache::MakeKey(filePath.c_str());
+
+	// the cooked rig, or the meta section of the file's cooked mesh if it was loaded as a model before
+	Skeleton skeleton;
+	bool isCooked = false;
+	if (USE_COOKED_ASSETS)
+	{
+		CookedAssetView view;
+		isCooked = view.Open(cookedPath, cookedKey) && ReadCookedSkeleton(view, skeleton);
+		if (!isCooked && view.Open(GetCookedModelPath(name, MeshSelection()), cookedKey) && ReadCookedSkeleton(view, skeleton))
+			WriteCookedSkeleton(cookedPath, cookedKey, skeleton);
+		isCooked = skeleton.size() > 0;
+	}
+
+	// the engine builds rigs from skinned meshes only, the mesh is converted and dropped, no lods and no mesh asset
+	if (!isCooked)
+	{
+		MorphTargetSet morphs;
+		std::vector<SkeletalSubmesh> submeshes;
+		std::vector<std::string> rejected;
+		SkeletalMesh* mesh = ImportSkeletalMesh(filePath.c_str(), MeshSelection(), morphs, submeshes, rejected);
+		if (!mesh)
+			return false;
+
+		skeleton = mesh->m_skeleton;
+		delete mesh;
+		if (progress)
+			progress->Set(0.9f);
+
+		if (USE_COOKED_ASSETS)
+			WriteCookedSkeleton(cookedPath, cookedKey, skeleton);
+	}
+
+	out = AcquireSkeleton(skeleton);
+	if (progress)
+		progress->Set(1.0f);
+	return true;
+}
+
+bool LoadAnimationData(const char* name, const SkeletonRef& skeleton, LoadedAnimation& out, const LoadProgress* progress)
+{
+	out.Release();
+	out.m_name = name;
+	out.m_skeleton = skeleton;
+
+	// clips are bound to the skeleton at import, so the skeleton is part of the key
+	std::string filePath = GetModelSourcePath(name);
+	std::string cookedPath = GetCookedClipPath(name, skeleton->m_hash);
+	CookedAssetKey cookedKey = AssetCache::MakeKey(filePath.c_str(), skeleton->m_hash);
+
+	// load cooked clip, or import and cook it when the cooked asset is missing or stale
+	out.m_clip = new AnimClip();
+	if (!USE_COOKED_ASSETS || !ReadCookedClip(cookedPath, cookedKey, *out.m_clip))
+	{
+		if (!ImportAnimationClip(filePath.c_str(), skeleton->m_skeleton, *out.m_clip))
+			return false;
+
+		if (progress)
+			progress->Set(0.8f);
+		if (USE_COOKED_ASSETS)
+			WriteCookedClip(cookedPath, cookedKey, *out.m_clip);
+	}
+	if (progress)
+		progress->Set(PLAY_ENGINE_ANIMATION ? 0.9f : 1.0f);
+
+	// the clip is still loaded for partial evaluation, retargeting and the graph
+	if (PLAY_ENGINE_ANIMATION)
+	{
+		out.m_animation = ImportAnimation(filePath.c_str(), skeleton->m_skeleton);
+		if (out.m_animation && TEST_CONV_ANIM_TO_FRAMES)
+		{
+			FrameAnimation* fanim = new FrameAnimation();
+			fanim->m_tps = 60.f;
+			fanim->BakeFrom(*out.m_animation, skeleton->m_skeleton.GetPose());
+			fanim->m_name = out.m_animation->m_name + "_baked_60fps";
+			delete out.m_animation;
+			out.m_animation = fanim;
+		}
+	}
+	return true;
+}
+
+bool IsLibrarySourceUnchanged(const std::string& sourcePath, const SourceStamp& packed)
+{
+	// size and write time settle most checks, a touched but unchanged source costs one hash
+	SourceStamp current;
+	if (!ReadSourceStamp(sourcePath.c_str(), current))
+		return false;
+	if (current.m_size == packed.m_size && current.m_writeTime == packed.m_writeTime)
+		return true;
+	return current.m_size == packed.m_size && HashFileContents(sourcePath.c_str()) == packed.m_hash;
+}
+
+bool LoadClipLibraryData(const char* name, const std::vector<std::string>& clips, const SkeletonRef& skeleton, ClipLibrary& out)
+{
+	out.Clear();
+
+	// the key covers which clips on which skeleton, the member sources are checked against the stamps packed with the library
+	std::vector<std::string> sourcePaths;
+	CookedAssetKey cookedKey;
+	cookedKey.m_contentHash = HashBytes(name, strlen(name), skeleton->m_hash);
+	for (auto& clip : clips)
+	{
+		sourcePaths.push_back(GetModelSourcePath(clip));
+		cookedKey.m_sourcePath += cookedKey.m_sourcePath.empty() ? sourcePaths.back() : "," + sourcePaths.back();
+		cookedKey.m_contentHash = HashBytes(sourcePaths.back().data(), sourcePaths.back().size(), cookedKey.m_contentHash);
+	}
+
+	std::string cookedPath = GetCookedClipLibraryPath(name, skeleton->m_hash);
+	if (USE_COOKED_ASSETS && out.Open(cookedPath, cookedKey))
+	{
+		const std::vector<SourceStamp>& packed = out.GetSources();
+		bool isFresh = packed.size() == sourcePaths.size();
+		for (size_t idx = 0; isFresh && idx < sourcePaths.size(); idx++)
+			isFresh = IsLibrarySourceUnchanged(sourcePaths[idx], packed[idx]);
+		if (isFresh)
+			return true;
+		out.Clear();
+	}
+
+	// stamped before the clips load, a source saved meanwhile then looks changed on the next open
+	std::vector<SourceStamp> sources(clips.size());
+	for (size_t idx = 0; idx < clips.size(); idx++)
+	{
+		if (!ReadSourceStamp(sourcePaths[idx].c_str(), sources[idx]))
+			return false;
+		sources[idx].m_hash = HashFileContents(sourcePaths[idx].c_str());
+	}
+
+	std::vector<LoadedAnimation> loaded(clips.size());
+	std::vector<const AnimClip*> members;
+	for (size_t idx = 0; idx < clips.size(); idx++)
+	{
+		if (!LoadAnimationData(clips[idx].c_str(), skeleton, loaded[idx]))
+			return false;
+		members.push_back(loaded[idx].m_clip);
+	}
+
+	out.Build(members, clips, skeleton->m_hash);
+	out.SetSources(sources);
+	if (USE_COOKED_ASSETS)
+		out.Write(cookedPath, cookedKey);
+	return true;
+}
+
+AsyncLoadRequest::AsyncLoadRequest(const std::string& model, const MeshSelection& meshes, const std::string& animation, const SkeletonRef& skeleton, float blendTime, bool retarget)
+	: m_modelName(model)
+	, m_meshSelection(meshes)
+	, m_animationName(animation)
+	, m_loadModel(skeleton == nullptr)
+	, m_blendTime(blendTime)
+	, m_retarget(retarget)
+	, m_skeleton(skeleton)
+{
+}
+
+AsyncLoadRequest::~AsyncLoadRequest()
+{
+	Cancel();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void AsyncLoadRequest::Start()
+{
+	m_thread = std::thread([this]() { Run(); });
+}
+
+const char* AsyncLoadRequest::GetStageName() const
+{
+	switch (m_stage)
+	{
+	case LOAD_STAGE_QUEUED:          return "queued";
+	case LOAD_STAGE_MODEL:           return "loading model";
+	case LOAD_STAGE_SOURCE_SKELETON: return "loading source skeleton";
+	case LOAD_STAGE_ANIMATION:       return "loading animation";
+	default:                         return "done";
+	}
+}
+
+LoadProgress AsyncLoadRequest::BeginStep(int stage)
+{
+	// every step gets an equal share of the bar, the loaders move it along inside their share
+	float begin = (float)m_stepIdx / (float)m_stepCount;
+	float end = (float)(m_stepIdx + 1) / (float)m_stepCount;
+	m_stepIdx++;
+	m_stage = stage;
+	m_progress = begin;
+	return LoadProgress(m_progress, begin, end);
+}
+
+void AsyncLoadRequest::Run()
+{
+	// imports are not interruptible, cancellation is checked between stages
+	m_stepCount = 1 + (m_loadModel ? 1 : 0) + (m_retarget ? 1 : 0);
+	if (m_loadModel && !m_isCancelled)
+	{
+		LoadProgress progress = BeginStep(LOAD_STAGE_MODEL);
+		if (LoadModelData(m_modelName.c_str(), m_meshSelection, m_model, &progress))
+			m_skeleton = m_model.m_skeleton;
+		else
+			m_error = Stringf("No mesh in model file %s!", m_modelName.c_str());
+	}
+
+	// a file without a skinned mesh has no rig of its own, its clip is then bound to the model's skeleton by bone name
+	if (m_retarget && m_error.empty() && !m_isCancelled)
+	{
+		LoadProgress progress = BeginStep(LOAD_STAGE_SOURCE_SKELETON);
+		if (!LoadSkeletonData(m_animationName.c_str(), m_sourceSkeleton, &progress))
+			DebuggerPrintf(Stringf("[LOAD] %s: no skinned mesh to take a rig from, not retargeted\n", m_animationName.c_str()).c_str());
+	}
+
+	if (m_error.empty() && !m_isCancelled)
+	{
+		LoadProgress progress = BeginStep(LOAD_STAGE_ANIMATION);
+		if (!LoadAnimationData(m_animationName.c_str(), m_sourceSkeleton ? m_sourceSkeleton : m_skeleton, m_animation, &progress))
+			m_error = Stringf("No animation in model file %s!", m_animationName.c_str());
+		else if (m_sourceSkeleton)
+			m_retargetMap.Build(m_sourceSkeleton->m_skeleton, m_skeleton->m_skeleton);
+	}
+
+	m_stage = LOAD_STAGE_DONE;
+	m_progress = 1.0f;
+	m_isDone = true;
+}
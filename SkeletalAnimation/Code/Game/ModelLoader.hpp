@@ -0,0 +1,141 @@
+#pragma once
+
+#include "AssetCooker.hpp"
+#include "ClipLibrary.hpp"
+#include "CookedAsset.hpp"
+#include "MorphTarget.hpp"
+#include "RetargetMap.hpp"
+#include "SkeletonAsset.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+class AnimClip;
+class Animation;
+class SkeletalMesh;
+
+// cpu side of a model, filled off the main thread and moved into the scene at a frame boundary
+struct LoadedModel
+{
+public:
+	LoadedModel() = default;
+	LoadedModel(const LoadedModel& copyFrom) = delete;
+	~LoadedModel();
+
+	void Release();
+
+public:
+	std::string         m_name;
+	MeshSelection       m_selection;
+	SkeletalMesh*       m_mesh = nullptr;
+	CookedAssetView     m_cookedMesh; // owns the vertex streams, mapped in place or decompressed
+	SkeletalMeshStreams m_streams;
+	MorphTargetSet      m_morphs;
+	std::vector<SkeletalSubmesh> m_submeshes;
+	SkeletalMeshLodSet  m_lodSet; // indices only set when generated here, otherwise they stay in the cooked view
+	SkeletonRef         m_skeleton; // the mesh's own copy is dropped once interned
+	std::vector<std::string> m_rejectedMeshes; // import only, see ImportSkeletalMesh
+};
+
+struct LoadedAnimation
+{
+public:
+	LoadedAnimation() = default;
+	LoadedAnimation(const LoadedAnimation& copyFrom) = delete;
+	~LoadedAnimation();
+
+	void Release();
+
+public:
+	std::string m_name;
+	Animation*  m_animation = nullptr; // only with PLAY_ENGINE_ANIMATION
+	AnimClip*   m_clip      = nullptr;
+	SkeletonRef m_skeleton; // the one the clip is bound to
+};
+
+// where a model's source and cooked files live, used by the loader and the hot reload watcher
+std::string GetModelSourcePath(const std::string& name);
+std::string GetCookedModelPath(const std::string& name, const MeshSelection& selection);
+std::string GetCookedSkeletonPath(const std::string& name);
+std::string GetCookedClipPath(const std::string& name, uint64_t skeletonHash);
+std::string GetCookedClipLibraryPath(const std::string& name, uint64_t skeletonHash);
+
+// a vertex animation bakes an animation file's clip onto a model's whole mesh, usually a model's own clip
+std::string    GetCookedVertexAnimationPath(const std::string& model, const std::string& animation);
+CookedAssetKey MakeVertexAnimationKey(const std::string& model, const std::string& animation, uint64_t skeletonHash);
+
+// maps a load step's own 0..1 onto its share of a request's progress bar
+struct LoadProgress
+{
+public:
+	LoadProgress(std::atomic<float>& value, float begin, float end) : m_value(value), m_begin(begin), m_end(end) {}
+
+	void Set(float fraction) const { m_value = m_begin + (m_end - m_begin) * fraction; }
+
+private:
+	std::atomic<float>& m_value;
+	float m_begin = 0.0f;
+	float m_end   = 1.0f;
+};
+
+// read cooked asset or import and cook, touches no gpu or scene state so it is safe on any thread
+bool LoadModelData(const char* name, const MeshSelection& selection, LoadedModel& out, const LoadProgress* progress = nullptr);
+bool LoadAnimationData(const char* name, const SkeletonRef& skeleton, LoadedAnimation& out, const LoadProgress* progress = nullptr);
+
+// only the rig of a file, for retargeting from an animation file, never builds or writes its mesh
+bool LoadSkeletonData(const char* name, SkeletonRef& out, const LoadProgress* progress = nullptr);
+
+// maps the cooked library if every listed clip's source is unchanged, otherwise loads the clips and packs a new one
+bool LoadClipLibraryData(const char* name, const std::vector<std::string>& clips, const SkeletonRef& skeleton, ClipLibrary& out);
+
+// background model/animation load, the scene polls it every frame and swaps the result in once done
+// only the cpu side loads here, the scene creates and fills the gpu buffers on the main thread in the frame it swaps the result in
+class AsyncLoadRequest
+{
+public:
+	// pass a skeleton to load the animation only, otherwise the model is loaded first and the animation bound to it
+	// retargeted clips bind to the animation file's own skeleton and come with a map onto the model's
+	AsyncLoadRequest(const std::string& model, const MeshSelection& meshes, const std::string& animation, const SkeletonRef& skeleton, float blendTime, bool retarget = false);
+	AsyncLoadRequest(const AsyncLoadRequest& copyFrom) = delete;
+	~AsyncLoadRequest();
+
+	void  Start();
+	void  Cancel()            { m_isCancelled = true; }
+	bool  IsCancelled() const { return m_isCancelled; }
+	bool  IsDone() const      { return m_isDone; }
+	bool  HasFailed() const   { return m_isDone && !m_error.empty(); }
+	float GetProgress() const { return m_progress; }
+	const char* GetStageName() const;
+
+public:
+	const std::string m_modelName;
+	const MeshSelection m_meshSelection;
+	const std::string m_animationName;
+	const bool        m_loadModel;
+	const float       m_blendTime;
+	const bool        m_retarget;
+
+	// results, only valid on the main thread once IsDone()
+	LoadedModel       m_model;
+	LoadedAnimation   m_animation;
+	SkeletonRef       m_sourceSkeleton; // retarget only, empty if the animation file had no rig and its clip is bound to the model's
+	RetargetMap       m_retargetMap;
+	std::string       m_error;
+
+private:
+	void Run();
+	LoadProgress BeginStep(int stage);
+
+private:
+	SkeletonRef       m_skeleton; // keeps the rig alive if the scene swaps models while this runs
+	std::thread       m_thread;
+	std::atomic<int>  m_stage       = 0;
+	int               m_stepIdx     = 0;
+	int               m_stepCount   = 1;
+	std::atomic<float> m_progress   = 0.0f;
+	std::atomic<bool> m_isCancelled = false;
+	std::atomic<bool> m_isDone      = false;
+};
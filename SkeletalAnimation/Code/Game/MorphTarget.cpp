@@ -0,0 +1,271 @@
+#include "MorphTarget.hpp"
+#include "CookedAsset.hpp"
+#include "ParallelFor.hpp"
+
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include "ThirdParty/assimp/scene.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define MORPH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+constexpr float        MORPH_DELTA_EPSILON = 1e-5f;
+constexpr float        MORPH_MATCH_EPSILON = 1e-3f;
+
+static bool IsMatchingVertex(const aiVector3D& aiVert, const Vec3& vert)
+{
+	return fabsf(aiVert.x - vert.x) < MORPH_MATCH_EPSILON
+		&& fabsf(aiVert.y - vert.y) < MORPH_MATCH_EPSILON
+		&& fabsf(aiVert.z - vert.z) < MORPH_MATCH_EPSILON;
+}
+
+static bool IsSameNameIgnoringCase(const std::string& a, const char* b)
+{
+	size_t size = strlen(b);
+	return a.size() == size && std::equal(a.begin(), a.end(), b, [](char ca, char cb) { return tolower((unsigned char)ca) == tolower((unsigned char)cb); });
+}
+
+// targets of one source mesh, indices already offset into the merged streams
+static void ImportSubmeshTargets(const aiMesh& aiMeshSrc, const SkeletalMesh& mesh, const SkeletalSubmesh& submesh, std::vector<MorphTarget>& outTargets)
+{
+	// vertex streams must line up one to one, otherwise the sparse indices are meaningless
+	// every vertex is compared, a reordered middle would otherwise slip through with matching ends
+	unsigned int vertexCount = aiMeshSrc.mNumVertices;
+	const Vec3* vertices = &mesh.m_vertices[submesh.m_vertexStart];
+	bool isMatching = vertexCount == (unsigned int)submesh.m_vertexCount;
+	for (unsigned int vertIdx = 0; isMatching && vertIdx < vertexCount; vertIdx++)
+		isMatching = IsMatchingVertex(aiMeshSrc.mVertices[vertIdx], vertices[vertIdx]);
+	if (!isMatching)
+	{
+		DebuggerPrintf(Stringf("[MORPH] Vertex layout of %s/%s does not match loaded mesh, morph targets skipped\n", mesh.m_name.c_str(), submesh.m_name.c_str()).c_str());
+		return;
+	}
+
+	for (unsigned int animIdx = 0; animIdx < aiMeshSrc.mNumAnimMeshes; animIdx++)
+	{
+		const aiAnimMesh* animMesh = aiMeshSrc.mAnimMeshes[animIdx];
+		if (!animMesh->HasPositions() || animMesh->mNumVertices != vertexCount)
+			continue;
+
+		MorphTarget& target = outTargets.emplace_back();
+		target.m_name = animMesh->mName.length > 0 ? animMesh->mName.C_Str() : Stringf("morph_%u", animIdx);
+
+		for (unsigned int vertIdx = 0; vertIdx < vertexCount; vertIdx++)
+		{
+			// assimp stores absolute shape positions, keep the difference only
+			aiVector3D deltaPos = animMesh->mVertices[vertIdx] - aiMeshSrc.mVertices[vertIdx];
+			aiVector3D deltaNrm;
+			if (animMesh->HasNormals() && aiMeshSrc.HasNormals())
+				deltaNrm = animMesh->mNormals[vertIdx] - aiMeshSrc.mNormals[vertIdx];
+
+			if (deltaPos.SquareLength() < MORPH_DELTA_EPSILON * MORPH_DELTA_EPSILON
+				&& deltaNrm.SquareLength() < MORPH_DELTA_EPSILON * MORPH_DELTA_EPSILON)
+				continue;
+
+			target.m_vertexIndices.push_back(submesh.m_vertexStart + vertIdx);
+			target.m_deltaPositions.push_back(Vec4(deltaPos.x, deltaPos.y, deltaPos.z, 0.0f));
+			target.m_deltaNormals.push_back(Vec4(deltaNrm.x, deltaNrm.y, deltaNrm.z, 0.0f));
+		}
+	}
+}
+
+int MorphTargetSet::Import(const aiScene& scene, const SkeletalMesh& mesh, const std::vector<SkeletalSubmesh>& submeshes, const std::vector<int>& sourceMeshes)
+{
+	Clear();
+	m_vertexCount = (int)mesh.m_vertices.size();
+
+	// submeshes are independent, merged by name afterwards in submesh order so the result does not depend on timing
+	std::vector<std::vector<MorphTarget>> submeshTargets(submeshes.size());
+	ParallelFor((int)submeshes.size(), [&](int submeshIdx)
+	{
+		const aiMesh* aiMeshSrc = scene.mMeshes[sourceMeshes[submeshIdx]];
+		if (aiMeshSrc->mNumAnimMeshes > 0)
+			ImportSubmeshTargets(*aiMeshSrc, mesh, submeshes[submeshIdx], submeshTargets[submeshIdx]);
+	});
+
+	for (auto& targets : submeshTargets)
+	{
+		for (auto& source : targets)
+		{
+			int targetIdx = FindTarget(source.m_name.c_str());
+			if (targetIdx < 0)
+			{
+				m_targets.push_back(std::move(source));
+				continue;
+			}
+
+			MorphTarget& target = m_targets[targetIdx];
+			target.m_vertexIndices.insert(target.m_vertexIndices.end(), source.m_vertexIndices.begin(), source.m_vertexIndices.end());
+			target.m_deltaPositions.insert(target.m_deltaPositions.end(), source.m_deltaPositions.begin(), source.m_deltaPositions.end());
+			target.m_deltaNormals.insert(target.m_deltaNormals.end(), source.m_deltaNormals.begin(), source.m_deltaNormals.end());
+		}
+	}
+
+	m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(), [](const MorphTarget& target) { return target.GetDeltaCount() == 0; }), m_targets.end());
+
+	return (int)m_targets.size();
+}
+
+void MorphTargetSet::Clear()
+{
+	m_targets.clear();
+	m_vertexCount = 0;
+}
+
+void MorphApplyState::Reset()
+{
+	m_scratchPositions.clear();
+	m_scratchNormals.clear();
+	m_vertexMarks.clear();
+	m_movedVertices.clear();
+	m_applyStamp = 0;
+}
+
+void MorphTargetSet::WriteBytes(ByteBuffer* buffer) const
+{
+	int targetCount = (int)m_targets.size();
+	buffer->Write(m_vertexCount);
+	buffer->Write(targetCount);
+	for (auto& target : m_targets)
+	{
+		int deltaCount = (int)target.GetDeltaCount();
+		buffer->WriteString(target.m_name);
+		buffer->Write(deltaCount);
+		buffer->Write(target.m_vertexIndices.size(), target.m_vertexIndices.data());
+		buffer->Write(target.m_deltaPositions.size(), target.m_deltaPositions.data());
+		buffer->Write(target.m_deltaNormals.size(), target.m_deltaNormals.data());
+	}
+}
+
+void MorphTargetSet::ReadBytes(ByteBuffer* buffer)
+{
+	Clear();
+
+	int targetCount = 0;
+	buffer->Read(m_vertexCount);
+	buffer->Read(targetCount);
+	m_targets.resize(targetCount);
+	for (auto& target : m_targets)
+	{
+		int deltaCount = 0;
+		target.m_name = buffer->ReadString();
+		buffer->Read(deltaCount);
+		target.m_vertexIndices.resize(deltaCount);
+		target.m_deltaPositions.resize(deltaCount);
+		target.m_deltaNormals.resize(deltaCount);
+		buffer->Read(target.m_vertexIndices.size(), target.m_vertexIndices.data());
+		buffer->Read(target.m_deltaPositions.size(), target.m_deltaPositions.data());
+		buffer->Read(target.m_deltaNormals.size(), target.m_deltaNormals.data());
+	}
+
+}
+
+int MorphTargetSet::FindTarget(const char* name) const
+{
+	for (int idx = 0; idx < (int)m_targets.size(); idx++)
+	{
+		if (IsSameNameIgnoringCase(m_targets[idx].m_name, name))
+			return idx;
+	}
+	return -1;
+}
+
+bool MorphTargetSet::Apply(const float* weights, MorphApplyState& state, const Vec3* basePositions, const Vec3* baseNormals, Vec3* outPositions, Vec3* outNormals) const
+{
+	if (state.m_vertexMarks.size() != (size_t)m_vertexCount)
+	{
+		state.Reset();
+		state.m_scratchPositions.resize(m_vertexCount);
+		state.m_scratchNormals.resize(m_vertexCount);
+		state.m_vertexMarks.assign(m_vertexCount, 0);
+	}
+
+	// a new stamp marks the vertices the active targets move this call, no pass over the whole mesh
+	if (++state.m_applyStamp == 0)
+	{
+		std::fill(state.m_vertexMarks.begin(), state.m_vertexMarks.end(), 0);
+		state.m_applyStamp = 1;
+	}
+
+	Vec4* scratchPos = state.m_scratchPositions.data();
+	Vec4* scratchNrm = state.m_scratchNormals.data();
+	uint32_t* marks = state.m_vertexMarks.data();
+	uint32_t stamp = state.m_applyStamp;
+	std::vector<unsigned int>& movedVertices = state.m_movedVertices;
+	size_t previousMovedCount = movedVertices.size();
+
+	for (int targetIdx = 0; targetIdx < (int)m_targets.size(); targetIdx++)
+	{
+		float weight = weights[targetIdx];
+		if (weight == 0.0f)
+			continue;
+
+		const MorphTarget& target = m_targets[targetIdx];
+		const unsigned int* indices = target.m_vertexIndices.data();
+		const Vec4* deltaPos = target.m_deltaPositions.data();
+		const Vec4* deltaNrm = target.m_deltaNormals.data();
+		size_t deltaCount = target.GetDeltaCount();
+
+		// first touch of a vertex starts it from the base shape
+		for (size_t deltaIdx = 0; deltaIdx < deltaCount; deltaIdx++)
+		{
+			unsigned int vertIdx = indices[deltaIdx];
+			if (marks[vertIdx] == stamp)
+				continue;
+			marks[vertIdx] = stamp;
+			scratchPos[vertIdx] = Vec4(basePositions[vertIdx].x, basePositions[vertIdx].y, basePositions[vertIdx].z, 0.0f);
+			scratchNrm[vertIdx] = Vec4(baseNormals[vertIdx].x, baseNormals[vertIdx].y, baseNormals[vertIdx].z, 0.0f);
+			movedVertices.push_back(vertIdx);
+		}
+
+#ifdef MORPH_USE_SSE
+		__m128 weightVec = _mm_set1_ps(weight);
+		for (size_t deltaIdx = 0; deltaIdx < deltaCount; deltaIdx++)
+		{
+			float* dstPos = &scratchPos[indices[deltaIdx]].x;
+			float* dstNrm = &scratchNrm[indices[deltaIdx]].x;
+			_mm_storeu_ps(dstPos, _mm_add_ps(_mm_loadu_ps(dstPos), _mm_mul_ps(_mm_loadu_ps(&deltaPos[deltaIdx].x), weightVec)));
+			_mm_storeu_ps(dstNrm, _mm_add_ps(_mm_loadu_ps(dstNrm), _mm_mul_ps(_mm_loadu_ps(&deltaNrm[deltaIdx].x), weightVec)));
+		}
+#else
+		for (size_t deltaIdx = 0; deltaIdx < deltaCount; deltaIdx++)
+		{
+			scratchPos[indices[deltaIdx]] += deltaPos[deltaIdx] * weight;
+			scratchNrm[indices[deltaIdx]] += deltaNrm[deltaIdx] * weight;
+		}
+#endif
+	}
+
+	// vertices moved last call but not this one go back to the base shape
+	for (size_t idx = 0; idx < previousMovedCount; idx++)
+	{
+		unsigned int vertIdx = movedVertices[idx];
+		if (marks[vertIdx] == stamp)
+			continue;
+		outPositions[vertIdx] = basePositions[vertIdx];
+		outNormals[vertIdx] = baseNormals[vertIdx];
+	}
+
+	// summed normal deltas leave the normal off unit length, more so at high weights
+	for (size_t idx = previousMovedCount; idx < movedVertices.size(); idx++)
+	{
+		unsigned int vertIdx = movedVertices[idx];
+		outPositions[vertIdx] = Vec3(scratchPos[vertIdx].x, scratchPos[vertIdx].y, scratchPos[vertIdx].z);
+
+		Vec3 normal(scratchNrm[vertIdx].x, scratchNrm[vertIdx].y, scratchNrm[vertIdx].z);
+		outNormals[vertIdx] = normal.GetLengthSquared() > 0.0f ? normal.GetNormalized() : baseNormals[vertIdx];
+	}
+
+	bool isChanged = !movedVertices.empty();
+	movedVertices.erase(movedVertices.begin(), movedVertices.begin() + previousMovedCount);
+	return isChanged;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class ByteBuffer;
+class SkeletalMesh;
+struct SkeletalSubmesh;
+struct aiScene;
+
+// sparse blend shape, only vertices actually moved by the shape are stored
+// deltas are padded to 4 floats so one vertex is one SSE lane group
+struct MorphTarget
+{
+public:
+	std::string               m_name;
+	std::vector<unsigned int> m_vertexIndices;
+	std::vector<Vec4>         m_deltaPositions;
+	std::vector<Vec4>         m_deltaNormals;
+
+public:
+	size_t GetDeltaCount() const { return m_vertexIndices.size(); }
+};
+
+// one scene's accumulation of a shared target set, sized by the first Apply
+// reset it whenever the output streams are refilled with the base shape
+struct MorphApplyState
+{
+public:
+	void Reset();
+
+public:
+	// float4 scratch streams the sparse deltas are accumulated into, only moved vertices are valid
+	std::vector<Vec4>         m_scratchPositions;
+	std::vector<Vec4>         m_scratchNormals;
+	std::vector<uint32_t>     m_vertexMarks;   // apply stamp of the call that last moved the vertex
+	std::vector<unsigned int> m_movedVertices; // moved by the last call
+	uint32_t                  m_applyStamp = 0;
+};
+
+// immutable once loaded, every scene showing the model applies it with its own state
+class MorphTargetSet
+{
+public:
+	// import every assimp anim mesh of the submeshes' scene meshes, sourceMeshes holds one scene index per submesh
+	// the scene must be the one the mesh was selected on, see ImportSkeletalMesh, returns number of targets loaded
+	// for merged meshes, shapes of the same name on different submeshes become one target
+	int  Import(const aiScene& scene, const SkeletalMesh& mesh, const std::vector<SkeletalSubmesh>& submeshes, const std::vector<int>& sourceMeshes);
+	void Clear();
+
+	void WriteBytes(ByteBuffer* buffer) const;
+	void ReadBytes(ByteBuffer* buffer);
+
+	int   GetTargetCount() const { return (int)m_targets.size(); }
+	int   GetVertexCount() const { return m_vertexCount; }
+	int   FindTarget(const char* name) const;
+	const MorphTarget& GetTarget(int index) const { return m_targets[index]; }
+
+	// accumulate weighted deltas on top of base streams, targets with zero weight are skipped
+	// only vertices the active targets move are written, plus those moved last call which go back to the base,
+	// so the output must hold the base shape wherever no target moved it
+	// returns false if output is unchanged since last call (all weights zero twice in a row)
+	bool Apply(const float* weights, MorphApplyState& state, const Vec3* basePositions, const Vec3* baseNormals, Vec3* outPositions, Vec3* outNormals) const;
+
+private:
+	std::vector<MorphTarget> m_targets;
+	int                      m_vertexCount = 0;
+};
+
+typedef std::shared_ptr<const MorphTargetSet> MorphTargetSetRef;
@@ -0,0 +1,402 @@
+#include "MotionDatabase.hpp"
+#include "AnimClip.hpp"
+#include "RetargetMap.hpp"
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define MOTION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+constexpr float MOTION_PADDING_FEATURE = 1.0e17f; // empty lanes of the last block, never the best match
+
+// root and facing of one frame plus the bones the features are made of, component space
+struct MotionFrame
+{
+public:
+	Vec3 m_origin;
+	Vec3 m_right;
+	Vec3 m_forward;
+	Vec3 m_root;
+	Vec3 m_leftFoot;
+	Vec3 m_rightFoot;
+};
+
+static BoneId FindBareBone(const Skeleton& skeleton, const char* name)
+{
+	for (auto& bone : skeleton)
+	{
+		if (strcmp(StripBoneNamespace(bone.m_name), name) == 0)
+			return bone.m_id;
+	}
+	return INVALID_BONE_ID;
+}
+
+static Vec3 ProjectOnGround(const Vec3& vec, const Vec3& up)
+{
+	return vec - up * DotProduct3D(vec, up);
+}
+
+static Vec3 ToCharacterSpace(const MotionFrame& frame, const Vec3& up, const Vec3& vec)
+{
+	return Vec3(DotProduct3D(vec, frame.m_right), DotProduct3D(vec, frame.m_forward), DotProduct3D(vec, up));
+}
+
+static void WriteFeature(float* out, const Vec3& value)
+{
+	out[0] = value.x;
+	out[1] = value.y;
+	out[2] = value.z;
+}
+
+bool MotionDatabase::Build(const SkeletonAsset& skeleton, const std::vector<const AnimClip*>& clips, const MotionDatabaseConfig& config)
+{
+	Clear();
+
+	const char* boneNames[] = { config.m_rootBone, config.m_leftHipBone, config.m_rightHipBone, config.m_leftFootBone, config.m_rightFootBone };
+	std::vector<BoneId> bones;
+	for (const char* name : boneNames)
+	{
+		bones.push_back(FindBareBone(skeleton.m_skeleton, name));
+		if (bones.back() == INVALID_BONE_ID)
+		{
+			DebuggerPrintf(Stringf("Motion database: skeleton has no bone %s\n", name).c_str());
+			return false;
+		}
+	}
+	BoneId rootBone = bones[0], leftHipBone = bones[1], rightHipBone = bones[2], leftFootBone = bones[3], rightFootBone = bones[4];
+
+	Vec3 up = config.m_up.GetNormalized();
+	BoneQuery query(skeleton.m_skeleton, bones);
+	std::vector<MotionFrame> frames;
+	std::vector<TransformQuat> keys;
+	std::vector<float> raw;
+
+	for (const AnimClip* clip : clips)
+	{
+		int clipIdx = (int)m_clipNames.size();
+		m_clipNames.push_back(clip->m_name);
+		if (clip->m_boneCount != skeleton.GetBoneCount())
+			continue;
+
+		// root, facing and feature bones of every frame, streamed blocks are decoded once for the whole clip
+		clip->CopyKeys(keys);
+		frames.resize(clip->m_frameCount);
+		Vec3 lastRight = Vec3(1.0f, 0.0f, 0.0f);
+		for (int frameIdx = 0; frameIdx < clip->m_frameCount; frameIdx++)
+		{
+			query.EvaluateFrame(*clip, keys.data(), frameIdx);
+			MotionFrame& frame = frames[frameIdx];
+			frame.m_root = query.GetCompTransform(rootBone).m_position;
+			frame.m_leftFoot = query.GetCompTransform(leftFootBone).m_position;
+			frame.m_rightFoot = query.GetCompTransform(rightFootBone).m_position;
+			frame.m_origin = ProjectOnGround(frame.m_root, up);
+
+			Vec3 across = ProjectOnGround(query.GetCompTransform(rightHipBone).m_position - query.GetCompTransform(leftHipBone).m_position, up);
+			frame.m_right = across.GetLengthSquared() > 0.0f ? across.GetNormalized() : lastRight;
+			frame.m_forward = CrossProduct3D(up, frame.m_right);
+			lastRight = frame.m_right;
+		}
+
+		// frames whose trajectory runs past the end of the clip are left out
+		int lookahead[MOTION_TRAJECTORY_POINTS];
+		int maxLookahead = 1;
+		for (int point = 0; point < MOTION_TRAJECTORY_POINTS; point++)
+		{
+			lookahead[point] = std::max(1, (int)roundf(config.m_trajectoryTimes[point] * clip->m_tps));
+			maxLookahead = std::max(maxLookahead, lookahead[point]);
+		}
+
+		for (int frameIdx = 0; frameIdx + maxLookahead < clip->m_frameCount; frameIdx++)
+		{
+			const MotionFrame& frame = frames[frameIdx];
+			const MotionFrame& next = frames[frameIdx + 1];
+			size_t start = raw.size();
+			raw.resize(start + MOTION_FEATURE_COUNT);
+			float* features = &raw[start];
+
+			WriteFeature(features + MOTION_FEATURE_LEFT_FOOT_POSITION, ToCharacterSpace(frame, up, frame.m_leftFoot - frame.m_origin));
+			WriteFeature(features + MOTION_FEATURE_RIGHT_FOOT_POSITION, ToCharacterSpace(frame, up, frame.m_rightFoot - frame.m_origin));
+			WriteFeature(features + MOTION_FEATURE_LEFT_FOOT_VELOCITY, ToCharacterSpace(frame, up, (next.m_leftFoot - frame.m_leftFoot) * clip->m_tps));
+			WriteFeature(features + MOTION_FEATURE_RIGHT_FOOT_VELOCITY, ToCharacterSpace(frame, up, (next.m_rightFoot - frame.m_rightFoot) * clip->m_tps));
+			WriteFeature(features + MOTION_FEATURE_ROOT_VELOCITY, ToCharacterSpace(frame, up, (next.m_root - frame.m_root) * clip->m_tps));
+
+			for (int point = 0; point < MOTION_TRAJECTORY_POINTS; point++)
+			{
+				const MotionFrame& future = frames[frameIdx + lookahead[point]];
+				Vec3 position = ToCharacterSpace(frame, up, future.m_origin - frame.m_origin);
+				Vec3 direction = ToCharacterSpace(frame, up, future.m_forward);
+				features[MOTION_FEATURE_TRAJECTORY_POSITION + point * 2 + 0] = position.x;
+				features[MOTION_FEATURE_TRAJECTORY_POSITION + point * 2 + 1] = position.y;
+				features[MOTION_FEATURE_TRAJECTORY_DIRECTION + point * 2 + 0] = direction.x;
+				features[MOTION_FEATURE_TRAJECTORY_DIRECTION + point * 2 + 1] = direction.y;
+			}
+
+			m_entryClips.push_back(clipIdx);
+			m_entryFrames.push_back(frameIdx);
+		}
+	}
+
+	m_entryCount = (int)m_entryClips.size();
+	if (m_entryCount == 0)
+	{
+		Clear();
+		return false;
+	}
+
+	// each group is scaled by one deviation so its dimensions keep their relative size, then weighted
+	struct FeatureGroup
+	{
+		int   m_first;
+		int   m_count;
+		float m_weight;
+	};
+	FeatureGroup groups[] = {
+		{ MOTION_FEATURE_LEFT_FOOT_POSITION, 6, config.m_footPositionWeight },
+		{ MOTION_FEATURE_LEFT_FOOT_VELOCITY, 6, config.m_footVelocityWeight },
+		{ MOTION_FEATURE_ROOT_VELOCITY, 3, config.m_rootVelocityWeight },
+		{ MOTION_FEATURE_TRAJECTORY_POSITION, 2 * MOTION_TRAJECTORY_POINTS, config.m_trajectoryPositionWeight },
+		{ MOTION_FEATURE_TRAJECTORY_DIRECTION, 2 * MOTION_TRAJECTORY_POINTS, config.m_trajectoryDirectionWeight },
+	};
+
+	m_mean.assign(MOTION_FEATURE_COUNT, 0.0f);
+	m_scale.assign(MOTION_FEATURE_COUNT, 1.0f);
+	std::vector<double> sum(MOTION_FEATURE_COUNT, 0.0);
+	std::vector<double> sumSquared(MOTION_FEATURE_COUNT, 0.0);
+	for (int entry = 0; entry < m_entryCount; entry++)
+	{
+		for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		{
+			double value = raw[(size_t)entry * MOTION_FEATURE_COUNT + feature];
+			sum[feature] += value;
+			sumSquared[feature] += value * value;
+		}
+	}
+	for (auto& group : groups)
+	{
+		double variance = 0.0;
+		for (int feature = group.m_first; feature < group.m_first + group.m_count; feature++)
+		{
+			double mean = sum[feature] / m_entryCount;
+			m_mean[feature] = (float)mean;
+			variance += std::max(0.0, sumSquared[feature] / m_entryCount - mean * mean);
+		}
+		float deviation = (float)sqrt(variance / group.m_count);
+		for (int feature = group.m_first; feature < group.m_first + group.m_count; feature++)
+			m_scale[feature] = group.m_weight / std::max(deviation, 1.0e-6f);
+	}
+
+	m_blockCount = (m_entryCount + MOTION_LANE_COUNT - 1) / MOTION_LANE_COUNT;
+	m_features.assign((size_t)m_blockCount * MOTION_FEATURE_COUNT * MOTION_LANE_COUNT, MOTION_PADDING_FEATURE);
+	float normalized[MOTION_FEATURE_COUNT];
+	for (int entry = 0; entry < m_entryCount; entry++)
+	{
+		NormalizeFeatures(&raw[(size_t)entry * MOTION_FEATURE_COUNT], normalized);
+		float* block = &m_features[(size_t)(entry / MOTION_LANE_COUNT) * MOTION_FEATURE_COUNT * MOTION_LANE_COUNT];
+		for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+			block[feature * MOTION_LANE_COUNT + entry % MOTION_LANE_COUNT] = normalized[feature];
+	}
+
+	BuildBoxes(MOTION_SMALL_BOX_SIZE, m_smallBoxMins, m_smallBoxMaxs);
+	BuildBoxes(MOTION_LARGE_BOX_SIZE, m_largeBoxMins, m_largeBoxMaxs);
+	return true;
+}
+
+void MotionDatabase::Clear()
+{
+	m_entryCount = 0;
+	m_blockCount = 0;
+	m_features.clear();
+	m_mean.clear();
+	m_scale.clear();
+	m_entryClips.clear();
+	m_entryFrames.clear();
+	m_clipNames.clear();
+	m_smallBoxMins.clear();
+	m_smallBoxMaxs.clear();
+	m_largeBoxMins.clear();
+	m_largeBoxMaxs.clear();
+}
+
+void MotionDatabase::BuildBoxes(int boxSize, std::vector<float>& outMins, std::vector<float>& outMaxs) const
+{
+	int boxCount = (m_entryCount + boxSize - 1) / boxSize;
+	outMins.assign((size_t)boxCount * MOTION_FEATURE_COUNT, FLT_MAX);
+	outMaxs.assign((size_t)boxCount * MOTION_FEATURE_COUNT, -FLT_MAX);
+
+	float features[MOTION_FEATURE_COUNT];
+	for (int entry = 0; entry < m_entryCount; entry++)
+	{
+		GetEntryFeatures(entry, features);
+		float* mins = &outMins[(size_t)(entry / boxSize) * MOTION_FEATURE_COUNT];
+		float* maxs = &outMaxs[(size_t)(entry / boxSize) * MOTION_FEATURE_COUNT];
+		for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		{
+			mins[feature] = std::min(mins[feature], features[feature]);
+			maxs[feature] = std::max(maxs[feature], features[feature]);
+		}
+	}
+}
+
+void MotionDatabase::NormalizeFeatures(const float* raw, float* outNormalized) const
+{
+	for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		outNormalized[feature] = (raw[feature] - m_mean[feature]) * m_scale[feature];
+}
+
+void MotionDatabase::GetEntryFeatures(int entry, float* outNormalized) const
+{
+	const float* block = &m_features[(size_t)(entry / MOTION_LANE_COUNT) * MOTION_FEATURE_COUNT * MOTION_LANE_COUNT];
+	for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		outNormalized[feature] = block[feature * MOTION_LANE_COUNT + entry % MOTION_LANE_COUNT];
+}
+
+void MotionDatabase::SetQueryTrajectory(float* query, const Vec2* positions, const Vec2* directions) const
+{
+	for (int point = 0; point < MOTION_TRAJECTORY_POINTS; point++)
+	{
+		int position = MOTION_FEATURE_TRAJECTORY_POSITION + point * 2;
+		int direction = MOTION_FEATURE_TRAJECTORY_DIRECTION + point * 2;
+		query[position + 0] = (positions[point].x - m_mean[position + 0]) * m_scale[position + 0];
+		query[position + 1] = (positions[point].y - m_mean[position + 1]) * m_scale[position + 1];
+		query[direction + 0] = (directions[point].x - m_mean[direction + 0]) * m_scale[direction + 0];
+		query[direction + 1] = (directions[point].y - m_mean[direction + 1]) * m_scale[direction + 1];
+	}
+}
+
+float MotionDatabase::GetBoxDistance(const float* query, const float* mins, const float* maxs, float maxCost) const
+{
+	// squared distance to the nearest point of the box, a lower bound for every entry inside
+	float distance = 0.0f;
+	for (int feature = 0; feature < MOTION_FEATURE_COUNT && distance < maxCost; feature++)
+	{
+		float outside = std::max(0.0f, std::max(mins[feature] - query[feature], query[feature] - maxs[feature]));
+		distance += outside * outside;
+	}
+	return distance;
+}
+
+void MotionDatabase::SearchBlocks(const float* query, int block0, int block1, float& bestCost, int& bestEntry) const
+{
+#ifdef MOTION_USE_SSE
+	__m128 queryVec[MOTION_FEATURE_COUNT];
+	for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		queryVec[feature] = _mm_set1_ps(query[feature]);
+
+	// per lane best, reduced once at the end
+	__m128 best = _mm_set1_ps(bestCost);
+	__m128i bestIdx = _mm_set1_epi32(-1);
+	__m128i entryIdx = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(block0 * MOTION_LANE_COUNT));
+	const __m128i laneStep = _mm_set1_epi32(MOTION_LANE_COUNT);
+	for (int block = block0; block < block1; block++)
+	{
+		const float* features = &m_features[(size_t)block * MOTION_FEATURE_COUNT * MOTION_LANE_COUNT];
+		__m128 cost = _mm_setzero_ps();
+		for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+		{
+			__m128 delta = _mm_sub_ps(_mm_loadu_ps(features + feature * MOTION_LANE_COUNT), queryVec[feature]);
+			cost = _mm_add_ps(cost, _mm_mul_ps(delta, delta));
+		}
+
+		__m128i better = _mm_castps_si128(_mm_cmplt_ps(cost, best));
+		best = _mm_min_ps(cost, best);
+		bestIdx = _mm_or_si128(_mm_and_si128(better, entryIdx), _mm_andnot_si128(better, bestIdx));
+		entryIdx = _mm_add_epi32(entryIdx, laneStep);
+	}
+
+	alignas(16) float laneCost[MOTION_LANE_COUNT];
+	alignas(16) int laneEntry[MOTION_LANE_COUNT];
+	_mm_store_ps(laneCost, best);
+	_mm_store_si128(reinterpret_cast<__m128i*>(laneEntry), bestIdx);
+	for (int lane = 0; lane < MOTION_LANE_COUNT; lane++)
+	{
+		if (laneEntry[lane] >= 0 && laneCost[lane] < bestCost)
+		{
+			bestCost = laneCost[lane];
+			bestEntry = laneEntry[lane];
+		}
+	}
+#else
+	for (int block = block0; block < block1; block++)
+	{
+		const float* features = &m_features[(size_t)block * MOTION_FEATURE_COUNT * MOTION_LANE_COUNT];
+		for (int lane = 0; lane < MOTION_LANE_COUNT; lane++)
+		{
+			float cost = 0.0f;
+			for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+			{
+				float delta = features[feature * MOTION_LANE_COUNT + lane] - query[feature];
+				cost += delta * delta;
+			}
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestEntry = block * MOTION_LANE_COUNT + lane;
+			}
+		}
+	}
+#endif
+}
+
+MotionMatch MotionDatabase::Search(const float* query, MotionSearchMode mode, float maxCost) const
+{
+	float bestCost = maxCost;
+	int bestEntry = -1;
+
+	if (mode == MotionSearchMode::BRUTE_FORCE)
+	{
+		SearchBlocks(query, 0, m_blockCount, bestCost, bestEntry);
+	}
+	else
+	{
+		constexpr int SMALL_PER_LARGE = MOTION_LARGE_BOX_SIZE / MOTION_SMALL_BOX_SIZE;
+		constexpr int BLOCKS_PER_SMALL = MOTION_SMALL_BOX_SIZE / MOTION_LANE_COUNT;
+		int smallCount = (int)(m_smallBoxMins.size() / MOTION_FEATURE_COUNT);
+		int largeCount = (int)(m_largeBoxMins.size() / MOTION_FEATURE_COUNT);
+
+		for (int large = 0; large < largeCount; large++)
+		{
+			size_t largeOffset = (size_t)large * MOTION_FEATURE_COUNT;
+			if (GetBoxDistance(query, &m_largeBoxMins[largeOffset], &m_largeBoxMaxs[largeOffset], bestCost) >= bestCost)
+				continue;
+
+			int smallEnd = std::min((large + 1) * SMALL_PER_LARGE, smallCount);
+			for (int small = large * SMALL_PER_LARGE; small < smallEnd; small++)
+			{
+				size_t smallOffset = (size_t)small * MOTION_FEATURE_COUNT;
+				if (GetBoxDistance(query, &m_smallBoxMins[smallOffset], &m_smallBoxMaxs[smallOffset], bestCost) >= bestCost)
+					continue;
+
+				SearchBlocks(query, small * BLOCKS_PER_SMALL, std::min((small + 1) * BLOCKS_PER_SMALL, m_blockCount), bestCost, bestEntry);
+			}
+		}
+	}
+
+	MotionMatch match;
+	if (bestEntry >= 0 && bestEntry < m_entryCount)
+	{
+		match.m_entry = bestEntry;
+		match.m_clip = m_entryClips[bestEntry];
+		match.m_frame = m_entryFrames[bestEntry];
+		match.m_cost = bestCost;
+	}
+	return match;
+}
+
+size_t MotionDatabase::GetBytes() const
+{
+	size_t bytes = sizeof(MotionDatabase);
+	bytes += (m_features.size() + m_mean.size() + m_scale.size()) * sizeof(float);
+	bytes += (m_smallBoxMins.size() + m_smallBoxMaxs.size() + m_largeBoxMins.size() + m_largeBoxMaxs.size()) * sizeof(float);
+	bytes += (m_entryClips.size() + m_entryFrames.size()) * sizeof(int);
+	for (auto& name : m_clipNames)
+		bytes += sizeof(std::string) + name.capacity();
+	return bytes;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "SkeletonAsset.hpp"
+
+#include "Engine/Math/Vec2.hpp"
+
+#include <float.h>
+#include <string>
+#include <vector>
+
+class AnimClip;
+
+constexpr int MOTION_TRAJECTORY_POINTS = 3;
+constexpr int MOTION_LANE_COUNT        = 4;  // entries per simd block
+constexpr int MOTION_SMALL_BOX_SIZE    = 16; // entries per leaf box
+constexpr int MOTION_LARGE_BOX_SIZE    = 64; // entries per top level box
+
+// one feature vector per frame, positions and velocities in character space
+// character space: origin is the root projected on the ground, y forward, x right, z up
+enum MotionFeature
+{
+	MOTION_FEATURE_LEFT_FOOT_POSITION   = 0,
+	MOTION_FEATURE_RIGHT_FOOT_POSITION  = 3,
+	MOTION_FEATURE_LEFT_FOOT_VELOCITY   = 6,
+	MOTION_FEATURE_RIGHT_FOOT_VELOCITY  = 9,
+	MOTION_FEATURE_ROOT_VELOCITY        = 12,
+	MOTION_FEATURE_TRAJECTORY_POSITION  = 15, // 2d per future point
+	MOTION_FEATURE_TRAJECTORY_DIRECTION = 15 + 2 * MOTION_TRAJECTORY_POINTS,
+	MOTION_FEATURE_COUNT                = 15 + 4 * MOTION_TRAJECTORY_POINTS,
+};
+
+// bone names are matched without the rig namespace, defaults are the Mixamo rig
+struct MotionDatabaseConfig
+{
+public:
+	const char* m_rootBone      = "Hips";
+	const char* m_leftHipBone   = "LeftUpLeg"; // the hips line gives the facing direction
+	const char* m_rightHipBone  = "RightUpLeg";
+	const char* m_leftFootBone  = "LeftFoot";
+	const char* m_rightFootBone = "RightFoot";
+	Vec3        m_up            = Vec3(0.0f, 0.0f, 1.0f);
+	float       m_trajectoryTimes[MOTION_TRAJECTORY_POINTS] = { 0.33f, 0.66f, 1.0f };
+
+	// relative importance of each feature group after normalization
+	float m_footPositionWeight        = 0.75f;
+	float m_footVelocityWeight        = 1.0f;
+	float m_rootVelocityWeight        = 1.0f;
+	float m_trajectoryPositionWeight  = 1.0f;
+	float m_trajectoryDirectionWeight = 1.5f;
+};
+
+enum class MotionSearchMode
+{
+	BRUTE_FORCE, // every entry, four at a time
+	AABB_TREE,   // two levels of boxes, skipped when their nearest point is already worse than the best match
+};
+
+struct MotionMatch
+{
+public:
+	int   m_entry = -1;
+	int   m_clip  = -1;
+	int   m_frame = 0;
+	float m_cost  = FLT_MAX;
+};
+
+// normalized features of every frame of a clip set bound to one skeleton, built once and searched per character
+// features are stored structure of arrays in blocks of MOTION_LANE_COUNT entries, [block][feature][lane]
+// searching is const and allocation free, so any number of characters can search in parallel
+class MotionDatabase
+{
+public:
+	bool Build(const SkeletonAsset& skeleton, const std::vector<const AnimClip*>& clips, const MotionDatabaseConfig& config = MotionDatabaseConfig());
+	void Clear();
+
+	// raw feature vectors to the normalized space the database is stored in
+	void NormalizeFeatures(const float* raw, float* outNormalized) const;
+	void GetEntryFeatures(int entry, float* outNormalized) const;
+
+	// replaces the trajectory part of a normalized query, points and facing directions in character space
+	void SetQueryTrajectory(float* query, const Vec2* positions, const Vec2* directions) const;
+
+	MotionMatch Search(const float* query, MotionSearchMode mode = MotionSearchMode::AABB_TREE, float maxCost = FLT_MAX) const;
+
+	int                GetEntryCount() const          { return m_entryCount; }
+	int                GetClipCount() const           { return (int)m_clipNames.size(); }
+	int                GetEntryClip(int entry) const  { return m_entryClips[entry]; }
+	int                GetEntryFrame(int entry) const { return m_entryFrames[entry]; }
+	const std::string& GetClipName(int clip) const    { return m_clipNames[clip]; }
+	size_t             GetBytes() const;
+
+private:
+	void  SearchBlocks(const float* query, int block0, int block1, float& bestCost, int& bestEntry) const;
+	float GetBoxDistance(const float* query, const float* mins, const float* maxs, float maxCost) const;
+	void  BuildBoxes(int boxSize, std::vector<float>& outMins, std::vector<float>& outMaxs) const;
+
+private:
+	int                      m_entryCount = 0;
+	int                      m_blockCount = 0;
+	std::vector<float>       m_features;     // [block][feature][lane]
+	std::vector<float>       m_mean;         // per feature
+	std::vector<float>       m_scale;        // group weight over group deviation
+	std::vector<int>         m_entryClips;
+	std::vector<int>         m_entryFrames;
+	std::vector<std::string> m_clipNames;    // in build order
+
+	// [box][feature], boxes never mix lanes of different blocks
+	std::vector<float>       m_smallBoxMins;
+	std::vector<float>       m_smallBoxMaxs;
+	std::vector<float>       m_largeBoxMins;
+	std::vector<float>       m_largeBoxMaxs;
+};
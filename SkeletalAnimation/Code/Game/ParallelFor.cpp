@@ -0,0 +1,110 @@
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct ParallelBatch
+{
+public:
+	const std::function<void(int)>* m_job = nullptr; // only touched by an index below m_count
+	int                             m_count = 0;
+	std::atomic<int>                m_next = 0;
+	std::atomic<int>                m_done = 0;
+};
+
+std::mutex g_parallelMutex;
+std::condition_variable g_parallelWake;
+std::condition_variable g_parallelDone;
+std::deque<std::shared_ptr<ParallelBatch>> g_parallelQueue;
+std::vector<std::thread> g_parallelThreads;
+bool g_parallelQuit = false;
+
+void RunParallelBatch(ParallelBatch& batch)
+{
+	for (int idx = batch.m_next++; idx < batch.m_count; idx = batch.m_next++)
+	{
+		(*batch.m_job)(idx);
+		if (++batch.m_done == batch.m_count)
+		{
+			std::lock_guard<std::mutex> lock(g_parallelMutex);
+			g_parallelDone.notify_all();
+		}
+	}
+}
+
+void RunParallelWorker()
+{
+	for (;;)
+	{
+		std::shared_ptr<ParallelBatch> batch;
+		{
+			std::unique_lock<std::mutex> lock(g_parallelMutex);
+			g_parallelWake.wait(lock, []() { return g_parallelQuit || !g_parallelQueue.empty(); });
+			if (g_parallelQuit)
+				return;
+
+			// a batch stays queued until every index is taken, so idle workers all join the oldest one
+			batch = g_parallelQueue.front();
+			if (batch->m_next >= batch->m_count)
+			{
+				g_parallelQueue.pop_front();
+				continue;
+			}
+		}
+		RunParallelBatch(*batch);
+	}
+}
+
+void ParallelFor(int count, const std::function<void(int)>& job)
+{
+	int threadCount = std::min(count, (int)std::thread::hardware_concurrency());
+	if (threadCount <= 1)
+	{
+		for (int idx = 0; idx < count; idx++)
+			job(idx);
+		return;
+	}
+
+	// workers start on first use and live until ShutdownParallelFor
+	std::shared_ptr<ParallelBatch> batch = std::make_shared<ParallelBatch>();
+	batch->m_job = &job;
+	batch->m_count = count;
+	{
+		std::lock_guard<std::mutex> lock(g_parallelMutex);
+		if (g_parallelThreads.empty())
+		{
+			g_parallelQuit = false;
+			int workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+			for (int threadIdx = 0; threadIdx < workerCount; threadIdx++)
+				g_parallelThreads.emplace_back(RunParallelWorker);
+		}
+		g_parallelQueue.push_back(batch);
+	}
+	g_parallelWake.notify_all();
+
+	// the calling thread takes part, so a nested call from a worker still finishes when every worker is busy
+	RunParallelBatch(*batch);
+
+	std::unique_lock<std::mutex> lock(g_parallelMutex);
+	g_parallelDone.wait(lock, [&batch]() { return batch->m_done == batch->m_count; });
+	auto queued = std::find(g_parallelQueue.begin(), g_parallelQueue.end(), batch);
+	if (queued != g_parallelQueue.end())
+		g_parallelQueue.erase(queued);
+}
+
+void ShutdownParallelFor()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_parallelMutex);
+		g_parallelQuit = true;
+	}
+	g_parallelWake.notify_all();
+	for (auto& thread : g_parallelThreads)
+		thread.join();
+	g_parallelThreads.clear();
+}
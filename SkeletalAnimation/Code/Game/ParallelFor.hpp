@@ -0,0 +1,7 @@
+#pragma once
+
+#include <functional>
+
+// run job(0..count-1) on a persistent pool of one thread per core, the calling thread takes part
+void ParallelFor(int count, const std::function<void(int)>& job);
+void ShutdownParallelFor();
@@ -0,0 +1,98 @@
+#include "PoseBaker.hpp"
+
+#include "AnimUtils.hpp"
+#include "SkeletonAsset.hpp"
+
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+// whole matrices covering the constant buffer, the renderer copies sizeof(SkeletonConstants) from the palette
+constexpr size_t SKINNING_PALETTE_SIZE = (sizeof(SkeletonConstants) + sizeof(Mat4x4) - 1) / sizeof(Mat4x4);
+
+void PoseBaker::Initialize(const SkeletonAsset& skeleton)
+{
+	m_skeleton = &skeleton;
+	m_dirty.assign(skeleton.GetBoneCount(), 0);
+	m_bakedLocal.assign(skeleton.GetBoneCount(), TransformQuat());
+	m_skinning.assign(SKINNING_PALETTE_SIZE, Mat4x4());
+
+	// bones past the palette still get their comp transform, they just cannot skin anything
+	m_skinnedBoneCount = std::min(skeleton.GetBoneCount(), (int)SKINNING_PALETTE_SIZE);
+	if (m_skinnedBoneCount < skeleton.GetBoneCount())
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("skeleton has %d bones, only the first %d fit the skinning palette",
+			skeleton.GetBoneCount(), m_skinnedBoneCount));
+	}
+	MarkAllDirty();
+}
+
+void PoseBaker::MarkDirty(BoneId boneId)
+{
+	if (m_dirty[boneId])
+		return;
+	m_dirty[boneId] = 1;
+	m_dirtyCount++;
+}
+
+void PoseBaker::MarkDirtyChain(BoneId rootBone, BoneId tipBone)
+{
+	for (BoneId boneId = tipBone; boneId != INVALID_BONE_ID; boneId = m_skeleton->m_parents[boneId])
+	{
+		MarkDirty(boneId);
+		if (boneId == rootBone)
+			break;
+	}
+}
+
+void PoseBaker::MarkAllDirty()
+{
+	std::fill(m_dirty.begin(), m_dirty.end(), (unsigned char)1);
+	m_dirtyCount = (int)m_dirty.size();
+}
+
+int PoseBaker::MarkChanged(const Pose& pose)
+{
+	// bitwise, a transform that only differs in the sign of a zero is baked again for nothing
+	int changedCount = 0;
+	for (int boneIdx = 0; boneIdx < (int)m_bakedLocal.size(); boneIdx++)
+	{
+		if (memcmp(&pose.m_boneLocalPose[boneIdx], &m_bakedLocal[boneIdx], sizeof(TransformQuat)) == 0)
+			continue;
+		MarkDirty((BoneId)boneIdx);
+		changedCount++;
+	}
+	return changedCount;
+}
+
+int PoseBaker::Bake(Pose& pose)
+{
+	if (m_dirtyCount == 0)
+		return 0;
+
+	int bakedCount = 0;
+
+	// dirty flags are pushed down the tree while walking in parent first order
+	for (BoneId boneId : m_skeleton->m_bakeOrder)
+	{
+		BoneId parentId = m_skeleton->m_parents[boneId];
+		if (parentId != INVALID_BONE_ID && m_dirty[parentId])
+			m_dirty[boneId] = 1;
+
+		if (!m_dirty[boneId])
+			continue;
+
+		const TransformQuat& local = pose.m_boneLocalPose[boneId];
+		m_bakedLocal[boneId] = local;
+		pose.m_boneCompPose[boneId] = parentId == INVALID_BONE_ID ? local : CombineTransform(pose.m_boneCompPose[parentId], local);
+		if (boneId < m_skinnedBoneCount)
+			m_skinning[boneId] = GetTransformMatrix(pose.m_boneCompPose[boneId]) * m_skeleton->m_inverseBindPose[boneId];
+		bakedCount++;
+	}
+
+	std::fill(m_dirty.begin(), m_dirty.end(), (unsigned char)0);
+	m_dirtyCount = 0;
+	return bakedCount;
+}
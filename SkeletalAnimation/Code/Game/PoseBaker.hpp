@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Engine/Animation/Skeleton.hpp"
+#include "Engine/Math/Mat4x4.hpp"
+
+#include <vector>
+
+class SkeletonAsset;
+
+// incremental local -> comp -> skinning bake, for sampled poses and procedural edits (IK, look-at, ...) alike
+// only bones flagged dirty and their descendants are re-evaluated
+// parents, bake order and inverse bind matrices come from the shared skeleton, the dirty flags, the locals
+// they were last baked from and the skinning palette are ours
+class PoseBaker
+{
+public:
+	void Initialize(const SkeletonAsset& skeleton); // keeps a pointer, the skeleton must outlive the baker or the next Initialize
+
+	void MarkDirty(BoneId boneId);
+	void MarkDirtyChain(BoneId rootBone, BoneId tipBone); // tip up to and including root
+	void MarkAllDirty();
+	int  MarkChanged(const Pose& pose); // bones whose local transform is not the one last baked, e.g. after sampling
+	bool IsDirty(BoneId boneId) const { return m_dirty[boneId] != 0; }
+
+	// returns number of bones re-baked, everything is dirty after Initialize so the first bake is a full one
+	int Bake(Pose& pose);
+
+	// laid out like SkeletonConstants, uploaded as is
+	const Mat4x4* GetSkinningMatrices() const { return m_skinning.data(); }
+
+private:
+	const SkeletonAsset*       m_skeleton = nullptr;
+	std::vector<unsigned char> m_dirty;
+	std::vector<TransformQuat> m_bakedLocal;
+	std::vector<Mat4x4>        m_skinning;
+	int                        m_dirtyCount = 0;
+	int                        m_skinnedBoneCount = 0; // bones that have a palette slot
+};
@@ -0,0 +1,176 @@
+#include "ResourceManager.hpp"
+
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+ResourceManager::ResourceManager(size_t budgetBytes)
+	: m_budgetBytes(budgetBytes)
+{
+}
+
+ResourceManager::~ResourceManager()
+{
+	// handles must not outlive the manager, scenes are destroyed first
+	for (auto& pair : m_entries)
+	{
+		if (pair.second->m_refCount > 0)
+			DebuggerPrintf(Stringf("[RESOURCE] %s still referenced at shutdown\n", pair.first.c_str()).c_str());
+	}
+	m_entries.clear();
+}
+
+ResourceEntry* ResourceManager::FindEntry(const std::string& id) const
+{
+	auto found = m_entries.find(id);
+	return found != m_entries.end() ? found->second.get() : nullptr;
+}
+
+ResourceEntry* ResourceManager::AddEntry(const std::string& id, Resource* resource)
+{
+	if (ResourceEntry* existing = FindEntry(id))
+	{
+		delete resource;
+		return existing;
+	}
+
+	std::unique_ptr<ResourceEntry>& entry = m_entries[id];
+	entry.reset(new ResourceEntry());
+	entry->m_id = id;
+	entry->m_resource.reset(resource);
+	entry->m_owner = this;
+	entry->m_lastUsed = ++m_tick;
+	return entry.get();
+}
+
+void ResourceManager::OnAcquire(ResourceEntry* entry)
+{
+	entry->m_refCount++;
+	entry->m_lastUsed = ++m_tick;
+}
+
+void ResourceManager::OnRelease(ResourceEntry* entry)
+{
+	entry->m_refCount--;
+	entry->m_lastUsed = ++m_tick;
+}
+
+size_t ResourceManager::GetUsedBytes() const
+{
+	size_t bytes = 0;
+	for (auto& pair : m_entries)
+		bytes += pair.second->m_resource->GetCpuBytes() + pair.second->m_resource->GetGpuBytes();
+	return bytes;
+}
+
+void ResourceManager::Evict(ResourceEntry* entry)
+{
+	m_evictedCount++;
+	std::string id = entry->m_id; // the key lives in the entry being destroyed
+	m_entries.erase(id);
+}
+
+bool ResourceManager::Replace(const std::string& id, Resource* resource)
+{
+	ResourceEntry* entry = FindEntry(id);
+	if (!entry)
+	{
+		delete resource;
+		return false;
+	}
+
+	entry->m_resource.reset(resource);
+	entry->m_version++;
+	return true;
+}
+
+bool ResourceManager::Remove(const std::string& id)
+{
+	ResourceEntry* entry = FindEntry(id);
+	if (!entry || entry->m_refCount > 0)
+		return false;
+
+	Evict(entry);
+	return true;
+}
+
+void ResourceManager::SetBudget(size_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+	EvictToBudget();
+}
+
+int ResourceManager::EvictToBudget()
+{
+	// entry count is small, a linear scan for the oldest per eviction beats keeping a list in sync
+	int evicted = 0;
+	size_t usedBytes = GetUsedBytes();
+	while (usedBytes > m_budgetBytes)
+	{
+		ResourceEntry* oldest = nullptr;
+		for (auto& pair : m_entries)
+		{
+			ResourceEntry* entry = pair.second.get();
+			if (entry->m_refCount == 0 && (!oldest || entry->m_lastUsed < oldest->m_lastUsed))
+				oldest = entry;
+		}
+
+		if (!oldest)
+			break; // everything left is in use, over budget until something is released
+
+		usedBytes -= oldest->m_resource->GetCpuBytes() + oldest->m_resource->GetGpuBytes();
+		Evict(oldest);
+		evicted++;
+	}
+	return evicted;
+}
+
+int ResourceManager::EvictUnreferenced()
+{
+	int evicted = 0;
+	for (auto iter = m_entries.begin(); iter != m_entries.end();)
+	{
+		if (iter->second->m_refCount == 0)
+		{
+			iter = m_entries.erase(iter);
+			m_evictedCount++;
+			evicted++;
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	return evicted;
+}
+
+ResourceStats ResourceManager::GetStats() const
+{
+	ResourceStats stats;
+	stats.m_budgetBytes = m_budgetBytes;
+	stats.m_evictedCount = m_evictedCount;
+	for (auto& pair : m_entries)
+	{
+		stats.m_resourceCount++;
+		if (pair.second->m_refCount > 0)
+			stats.m_referencedCount++;
+		stats.m_cpuBytes += pair.second->m_resource->GetCpuBytes();
+		stats.m_gpuBytes += pair.second->m_resource->GetGpuBytes();
+	}
+	return stats;
+}
+
+void ResourceManager::PrintStats() const
+{
+	for (auto& pair : m_entries)
+	{
+		const ResourceEntry& entry = *pair.second;
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("  %-40s refs %d, cpu %d KB, gpu %d KB", entry.m_id.c_str(), entry.m_refCount,
+			(int)(entry.m_resource->GetCpuBytes() / 1024), (int)(entry.m_resource->GetGpuBytes() / 1024)));
+	}
+
+	ResourceStats stats = GetStats();
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("%d resources (%d referenced), cpu %.1f MB, gpu %.1f MB, budget %.1f MB, %d evicted",
+		stats.m_resourceCount, stats.m_referencedCount, (float)stats.m_cpuBytes / (1024.0f * 1024.0f), (float)stats.m_gpuBytes / (1024.0f * 1024.0f),
+		(float)stats.m_budgetBytes / (1024.0f * 1024.0f), stats.m_evictedCount));
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ResourceManager;
+
+// anything the manager owns, sizes are queried live since streamed resources grow and shrink
+class Resource
+{
+public:
+	virtual ~Resource() = default;
+
+	virtual size_t GetCpuBytes() const = 0;
+	virtual size_t GetGpuBytes() const = 0;
+};
+
+struct ResourceEntry
+{
+public:
+	std::string               m_id;
+	std::unique_ptr<Resource> m_resource;
+	int                       m_refCount = 0;
+	uint64_t                  m_lastUsed = 0; // manager tick of the last acquire or release
+	int                       m_version  = 0; // bumped on hot reload, holders compare it to rebuild derived state
+	ResourceManager*          m_owner    = nullptr;
+};
+
+// shared reference to a managed resource, unreferenced resources stay cached until evicted
+// handles are main thread only, the count is not atomic
+template<typename T>
+class ResourceHandle
+{
+public:
+	ResourceHandle() = default;
+	explicit ResourceHandle(ResourceEntry* entry) : m_entry(entry) { AddRef(); }
+	ResourceHandle(const ResourceHandle& copyFrom) : m_entry(copyFrom.m_entry) { AddRef(); }
+	ResourceHandle(ResourceHandle&& moveFrom) noexcept : m_entry(moveFrom.m_entry) { moveFrom.m_entry = nullptr; }
+	~ResourceHandle() { Reset(); }
+
+	ResourceHandle& operator=(const ResourceHandle& copyFrom)
+	{
+		if (m_entry != copyFrom.m_entry)
+		{
+			Reset();
+			m_entry = copyFrom.m_entry;
+			AddRef();
+		}
+		return *this;
+	}
+
+	ResourceHandle& operator=(ResourceHandle&& moveFrom) noexcept
+	{
+		if (this != &moveFrom)
+		{
+			Reset();
+			m_entry = moveFrom.m_entry;
+			moveFrom.m_entry = nullptr;
+		}
+		return *this;
+	}
+
+	void Reset();
+
+	T*   Get() const         { return m_entry ? static_cast<T*>(m_entry->m_resource.get()) : nullptr; }
+	T*   operator->() const  { return Get(); }
+	T&   operator*() const   { return *Get(); }
+	bool IsValid() const     { return m_entry != nullptr; }
+	explicit operator bool() const { return IsValid(); }
+	bool operator==(const ResourceHandle& other) const { return m_entry == other.m_entry; }
+	bool operator!=(const ResourceHandle& other) const { return m_entry != other.m_entry; }
+
+	const std::string& GetId() const { return m_entry->m_id; }
+	int  GetVersion() const  { return m_entry ? m_entry->m_version : 0; }
+	int  GetRefCount() const { return m_entry ? m_entry->m_refCount : 0; }
+
+private:
+	void AddRef();
+
+private:
+	ResourceEntry* m_entry = nullptr;
+};
+
+struct ResourceStats
+{
+public:
+	int    m_resourceCount   = 0;
+	int    m_referencedCount = 0;
+	size_t m_cpuBytes        = 0;
+	size_t m_gpuBytes        = 0;
+	size_t m_budgetBytes     = 0;
+	int    m_evictedCount    = 0; // over the whole session
+};
+
+// assets keyed by id, shared by every scene holding a handle
+// once cpu + gpu bytes exceed the budget, unreferenced assets are destroyed oldest release first
+// checked on add, on budget change and once per frame by the game, never inside a handle's release
+class ResourceManager
+{
+public:
+	explicit ResourceManager(size_t budgetBytes);
+	ResourceManager(const ResourceManager& copyFrom) = delete;
+	~ResourceManager();
+
+	template<typename T>
+	ResourceHandle<T> Find(const std::string& id)
+	{
+		ResourceEntry* entry = FindEntry(id);
+		if (!entry || !dynamic_cast<T*>(entry->m_resource.get()))
+			return ResourceHandle<T>();
+		return ResourceHandle<T>(entry);
+	}
+
+	// takes ownership, if the id got added meanwhile the new resource is dropped in favor of the existing one
+	template<typename T>
+	ResourceHandle<T> Add(const std::string& id, T* resource)
+	{
+		ResourceHandle<T> handle(AddEntry(id, resource));
+		EvictToBudget();
+		return handle;
+	}
+
+	// every live resource of a type, e.g. to find the ones built from a changed file
+	template<typename T>
+	void CollectResources(std::vector<ResourceHandle<T>>& outHandles)
+	{
+		for (auto& pair : m_entries)
+		{
+			if (dynamic_cast<T*>(pair.second->m_resource.get()))
+				outHandles.emplace_back(pair.second.get());
+		}
+	}
+
+	// swap in a new version under the same id, handles stay valid and see the new resource
+	// the old one is destroyed right away, so this only runs at a frame boundary
+	bool Replace(const std::string& id, Resource* resource);
+	bool Remove(const std::string& id); // only if unreferenced
+
+	void   SetBudget(size_t budgetBytes);
+	size_t GetBudget() const { return m_budgetBytes; }
+	int    EvictToBudget(); // the game calls it once per frame after the scene update
+	int    EvictUnreferenced(); // everything not held by a handle, e.g. on scene change
+
+	ResourceStats GetStats() const;
+	void PrintStats() const;
+
+	// called by ResourceHandle
+	void OnAcquire(ResourceEntry* entry);
+	void OnRelease(ResourceEntry* entry);
+
+private:
+	ResourceEntry* FindEntry(const std::string& id) const;
+	ResourceEntry* AddEntry(const std::string& id, Resource* resource);
+	size_t GetUsedBytes() const;
+	void   Evict(ResourceEntry* entry);
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<ResourceEntry>> m_entries;
+	size_t   m_budgetBytes  = 0;
+	uint64_t m_tick         = 0;
+	int      m_evictedCount = 0;
+};
+
+template<typename T>
+void ResourceHandle<T>::Reset()
+{
+	if (m_entry)
+		m_entry->m_owner->OnRelease(m_entry);
+	m_entry = nullptr;
+}
+
+template<typename T>
+void ResourceHandle<T>::AddRef()
+{
+	if (m_entry)
+		m_entry->m_owner->OnAcquire(m_entry);
+}
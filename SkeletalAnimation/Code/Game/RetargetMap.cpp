@@ -0,0 +1,149 @@
+#include "RetargetMap.hpp"
+#include "AnimClip.hpp"
+#include "AnimUtils.hpp"
+#include "AssetCache.hpp"
+
+#include <unordered_map>
+
+const std::vector<BoneNameAlias>& GetMixamoToMannequinAliases()
+{
+	static const std::vector<BoneNameAlias> aliases = []()
+	{
+		std::vector<BoneNameAlias> table = {
+			{ "Hips", "pelvis" },
+			{ "Spine", "spine_01" },
+			{ "Spine1", "spine_02" },
+			{ "Spine2", "spine_03" },
+			{ "Neck", "neck_01" },
+			{ "Head", "head" },
+		};
+
+		// sides and finger chains follow the same pattern on both rigs
+		static const char* SIDES[2][2] = { { "Left", "l" }, { "Right", "r" } };
+		static const char* LIMBS[][2] = {
+			{ "Shoulder", "clavicle" }, { "Arm", "upperarm" }, { "ForeArm", "lowerarm" }, { "Hand", "hand" },
+			{ "UpLeg", "thigh" }, { "Leg", "calf" }, { "Foot", "foot" }, { "ToeBase", "ball" },
+		};
+		static const char* FINGERS[][2] = { { "Thumb", "thumb" }, { "Index", "index" }, { "Middle", "middle" }, { "Ring", "ring" }, { "Pinky", "pinky" } };
+
+		for (auto& side : SIDES)
+		{
+			for (auto& limb : LIMBS)
+				table.push_back({ std::string(side[0]) + limb[0], std::string(limb[1]) + "_" + side[1] });
+			for (auto& finger : FINGERS)
+			{
+				for (int joint = 1; joint <= 3; joint++)
+					table.push_back({ std::string(side[0]) + "Hand" + finger[0] + std::to_string(joint), std::string(finger[1]) + "_0" + std::to_string(joint) + "_" + side[1] });
+			}
+		}
+		return table;
+	}();
+	return aliases;
+}
+
+const char* StripBoneNamespace(const std::string& name)
+{
+	size_t colon = name.rfind(':');
+	return colon == std::string::npos ? name.c_str() : name.c_str() + colon + 1;
+}
+
+TransformQuat GetBindCompTransform(const Skeleton& skeleton, const Pose& bindPose, BoneId boneId)
+{
+	TransformQuat comp = bindPose.m_boneLocalPose[boneId];
+	for (BoneId parentId = skeleton.FindBone(boneId)->m_parentId; parentId != INVALID_BONE_ID; parentId = skeleton.FindBone(parentId)->m_parentId)
+		comp = CombineTransform(bindPose.m_boneLocalPose[parentId], comp);
+	return comp;
+}
+
+Quaternion GetBindParentRotation(const Skeleton& skeleton, const Pose& bindPose, BoneId boneId)
+{
+	BoneId parentId = skeleton.FindBone(boneId)->m_parentId;
+	return parentId != INVALID_BONE_ID ? GetBindCompTransform(skeleton, bindPose, parentId).m_rotation : Quaternion();
+}
+
+void RetargetMap::Build(const Skeleton& source, const Skeleton& target, const std::vector<BoneNameAlias>& aliases)
+{
+	m_sourceBoneCount = (int)source.size();
+	m_sourceHash = HashSkeleton(source);
+	m_targetHash = HashSkeleton(target);
+	m_mappedCount = 0;
+	m_rootScale = 1.0f;
+	m_bones.assign(target.size(), RetargetBone());
+
+	// source bones by bare name hash, plus the same bones under their alias on the target rig
+	std::unordered_map<BoneNameHash, BoneId> sourceBones;
+	for (auto& bone : source)
+		sourceBones.emplace(HashBoneName(StripBoneNamespace(bone.m_name)), bone.m_id);
+	for (auto& alias : aliases)
+	{
+		auto found = sourceBones.find(HashBoneName(alias.m_source.c_str()));
+		if (found != sourceBones.end())
+			sourceBones.emplace(HashBoneName(alias.m_target.c_str()), found->second);
+	}
+
+	Pose sourceBind = source.GetPose();
+	Pose targetBind = target.GetPose();
+	for (auto& bone : target)
+	{
+		RetargetBone& mapped = m_bones[bone.m_id];
+		mapped.m_targetBind = targetBind.m_boneLocalPose[bone.m_id];
+
+		auto found = sourceBones.find(HashBoneName(StripBoneNamespace(bone.m_name)));
+		if (found == sourceBones.end())
+			continue;
+
+		const TransformQuat& sourceLocal = sourceBind.m_boneLocalPose[found->second];
+		Quaternion sourceParent = GetBindParentRotation(source, sourceBind, found->second);
+		Quaternion targetParent = GetBindParentRotation(target, targetBind, bone.m_id);
+		mapped.m_sourceBone = found->second;
+		mapped.m_parentRotation = MultiplyQuaternions(GetConjugate(targetParent), sourceParent);
+		mapped.m_rotationOffset = MultiplyQuaternions(GetConjugate(sourceLocal.m_rotation), MultiplyQuaternions(GetConjugate(mapped.m_parentRotation), mapped.m_targetBind.m_rotation));
+		mapped.m_sourceBindPosition = sourceLocal.m_position;
+		m_mappedCount++;
+	}
+
+	// the root is the first mapped bone without a mapped ancestor, normally pelvis
+	for (auto& bone : target)
+	{
+		if (m_bones[bone.m_id].m_sourceBone == INVALID_BONE_ID)
+			continue;
+
+		bool hasMappedAncestor = false;
+		for (BoneId parentId = bone.m_parentId; parentId != INVALID_BONE_ID && !hasMappedAncestor; parentId = target.FindBone(parentId)->m_parentId)
+			hasMappedAncestor = m_bones[parentId].m_sourceBone != INVALID_BONE_ID;
+		if (hasMappedAncestor)
+			continue;
+
+		m_bones[bone.m_id].m_isRoot = true;
+		float sourceHeight = GetBindCompTransform(source, sourceBind, m_bones[bone.m_id].m_sourceBone).m_position.GetLength();
+		float targetHeight = GetBindCompTransform(target, targetBind, bone.m_id).m_position.GetLength();
+		m_rootScale = sourceHeight > 0.0f ? targetHeight / sourceHeight : 1.0f;
+		break;
+	}
+}
+
+void RetargetMap::SamplePose(const AnimClip& sourceClip, float time, Pose& targetPose, AnimClipPlayback& playback) const
+{
+	AnimClipCursor cursor = sourceClip.GetCursor(time);
+
+	TransformQuat sourceLocal;
+	for (int boneIdx = 0; boneIdx < (int)m_bones.size(); boneIdx++)
+	{
+		const RetargetBone& mapped = m_bones[boneIdx];
+		TransformQuat& out = targetPose.m_boneLocalPose[boneIdx];
+		if (mapped.m_sourceBone == INVALID_BONE_ID)
+		{
+			out = mapped.m_targetBind;
+			continue;
+		}
+
+		sourceClip.SampleBone(mapped.m_sourceBone, cursor, sourceLocal, playback);
+		out.m_rotation = MultiplyQuaternions(mapped.m_parentRotation, MultiplyQuaternions(sourceLocal.m_rotation, mapped.m_rotationOffset));
+		out.m_position = mapped.m_targetBind.m_position;
+		if (mapped.m_isRoot)
+			out.m_position += RotateVector(mapped.m_parentRotation, sourceLocal.m_position - mapped.m_sourceBindPosition) * m_rootScale;
+		out.m_scale = mapped.m_targetBind.m_scale;
+	}
+
+	sourceClip.TrimResidentBlocks(cursor, playback);
+}
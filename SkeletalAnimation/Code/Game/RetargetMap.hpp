@@ -0,0 +1,67 @@
+#pragma once
+
+#include "BoneNames.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class AnimClip;
+class AnimClipPlayback;
+struct AnimClipCursor;
+
+// source bone name to target bone name, for rigs that do not share a naming convention
+struct BoneNameAlias
+{
+public:
+	std::string m_source;
+	std::string m_target;
+};
+
+// Mixamo rig to the UE mannequin skeleton, names after the "mixamorig:" namespace is stripped
+const std::vector<BoneNameAlias>& GetMixamoToMannequinAliases();
+
+// "mixamorig:Hips" -> "Hips", rigs exported with a namespace match on the bare name
+const char* StripBoneNamespace(const std::string& name);
+
+// plays clips bound to one skeleton on another, computed once per source/target pair
+// every target bone maps to one source bone or holds its bind pose
+// the source delta from bind is moved through component space, so rigs whose bind frames differ still agree on it:
+// target = inverse(Pt) * Ps * source * inverse(sourceBind) * inverse(Ps) * Pt * targetBind,
+// with Ps and Pt the component space bind rotations of the source and target parents
+// only the root moves, its translation delta is rotated into the target parent frame the same way
+// and scaled by the ratio of root heights, other bones keep target lengths
+class RetargetMap
+{
+public:
+	void Build(const Skeleton& source, const Skeleton& target, const std::vector<BoneNameAlias>& aliases = GetMixamoToMannequinAliases());
+
+	// same cost as AnimClip::SamplePose plus two quaternion multiplies per mapped bone
+	void SamplePose(const AnimClip& sourceClip, float time, Pose& targetPose, AnimClipPlayback& playback) const;
+
+	int      GetSourceBoneCount() const { return m_sourceBoneCount; }
+	int      GetTargetBoneCount() const { return (int)m_bones.size(); }
+	int      GetMappedBoneCount() const { return m_mappedCount; }
+	uint64_t GetSourceHash() const      { return m_sourceHash; }
+	uint64_t GetTargetHash() const      { return m_targetHash; }
+
+private:
+	struct RetargetBone
+	{
+		BoneId        m_sourceBone = INVALID_BONE_ID;
+		bool          m_isRoot     = false;
+		Quaternion    m_parentRotation;  // inverse(Pt) * Ps, also takes the root translation delta to the target frame
+		Quaternion    m_rotationOffset;  // inverse(sourceBind) * inverse(Ps) * Pt * targetBind
+		Vec3          m_sourceBindPosition;
+		TransformQuat m_targetBind;
+	};
+
+	std::vector<RetargetBone> m_bones; // by target bone id
+	int      m_sourceBoneCount = 0;
+	int      m_mappedCount     = 0;
+	float    m_rootScale       = 1.0f;
+	uint64_t m_sourceHash      = 0;
+	uint64_t m_targetHash      = 0;
+};
@@ -7,6 +7,8 @@
 #include "SoundClip.hpp"
 #include "RenderUtils.hpp"
 #include "Networking.hpp"
+#include "VertexAnimation.hpp"
+#include "MeshSimplifier.hpp"
 
 #include "Engine/Animation/Animation.hpp"
 #include "Engine/Animation/AssetImporter.hpp"
@@ -38,10 +40,10 @@
 #include <vector>
 
 
-constexpr bool TEST_CONV_ANIM_TO_FRAMES = false;
-constexpr bool TEST_MODEL_SERIALIZATION = true;
 
 
+constexpr float WORLD_CAMERA_FOV_DEGREES = 60.0f;
+
 std::vector<VertexFormat> g_SkeletalShaderLayout;
 Shader* g_SkeletalShader;
 
@@ -55,18 +57,239 @@ bool Command_Load(EventArgs& args)
 	}
 
 	std::string model = args.GetValue("model", "Swimming");
+	std::string meshes = args.GetValue("meshes", "");
 	std::string animation = args.GetValue("animation", model.c_str());
+	float blendTime = args.GetValue("blend", 0.3f);
+	bool retarget = args.GetValue("retarget", false);
+
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loading %s/%s in background...", model.c_str(), animation.c_str()));
+	scene->RequestLoad(model, meshes, animation, blendTime, retarget);
+	return true;
+}
+
+bool Command_CancelLoad(EventArgs& args)
+{
+	UNUSED(args);
+
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene || !scene->CancelLoad())
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "No load in progress!");
+	return true;
+}
+
+bool Command_ClipLibrary(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot load a clip library in current scene!");
+		return true;
+	}
 
-	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loading model file %s...", model.c_str()));
-	scene->LoadModel(model.c_str());
-	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loading animation file %s...", animation.c_str()));
-	scene->LoadAnimation(animation.c_str());
+	std::string name = args.GetValue("name", "Library");
+	std::string clips = args.GetValue("clips", scene->GetModelName().c_str());
+	scene->LoadClipLibrary(name, SplitStringOnDelimiter(clips, ','));
+	return true;
+}
+
+bool Command_Morph(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot set morph in current scene!");
+		return true;
+	}
+
+	std::string target = args.GetValue("target", "");
+	float weight = args.GetValue("weight", 1.0f);
+
+	if (!scene->SetMorphWeight(target.c_str(), weight))
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Morph target %s not found!", target.c_str()));
+	return true;
+}
+
+bool Command_BakeVertexAnimation(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot bake in current scene!");
+		return true;
+	}
+
+	float tps = args.GetValue("tps", VAT_BAKE_TPS);
+	scene->BakeVertexAnimation(tps);
+	return true;
+}
+
+bool Command_PlayVertexAnimation(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot play vertex animation in current scene!");
+		return true;
+	}
+
+	scene->PlayVertexAnimation(args.GetValue("enable", true));
+	return true;
+}
+
+bool Command_ModelLod(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot set lod in current scene!");
+		return true;
+	}
+
+	// lod=-1 goes back to picking by screen size
+	scene->SetForcedLod(args.GetValue("lod", -1));
+	return true;
+}
+
+bool Command_QueryBone(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene || !scene->GetClip())
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot query bones in current scene!");
+		return true;
+	}
+
+	std::string boneName = args.GetValue("bone", "head");
+	BoneId boneId = scene->GetBoneLookup().Find(boneName.c_str());
+	if (boneId == INVALID_BONE_ID)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Bone %s not found!", boneName.c_str()));
+		return true;
+	}
+
+	BoneQuery query(scene->GetSkeleton(), { boneId });
+	query.Evaluate(*scene->GetClip(), scene->GetLifeTime());
+
+	Vec3 position = query.GetCompTransform(boneId).m_position;
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("%s: (%.2f, %.2f, %.2f), %d bones evaluated", boneName.c_str(), position.x, position.y, position.z, query.GetEvaluatedBoneCount()));
+	return true;
+}
+
+bool Command_MotionDatabase(EventArgs& args)
+{
+	UNUSED(args);
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot build a motion database in current scene!");
+		return true;
+	}
+
+	scene->BuildMotionDatabase();
+	return true;
+}
+
+bool Command_MotionSearch(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot search motion in current scene!");
+		return true;
+	}
+
+	scene->BenchmarkMotionSearch(args.GetValue("queries", 1000));
+	return true;
+}
+
+bool Command_AnimGraph(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot load an anim graph in current scene!");
+		return true;
+	}
+
+	// an empty file goes back to playing the clip
+	scene->LoadAnimGraph(args.GetValue("file", ""));
+	return true;
+}
+
+bool Command_AnimParam(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot set anim graph parameters in current scene!");
+		return true;
+	}
+
+	std::string name = args.GetValue("name", "");
+	float value = args.GetValue("value", 0.0f);
+	if (!scene->SetAnimGraphParameter(name.c_str(), value))
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Anim graph parameter %s not found!", name.c_str()));
+	return true;
+}
+
+bool Command_AnimGraphBench(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot run anim graphs in current scene!");
+		return true;
+	}
+
+	scene->BenchmarkAnimGraph(args.GetValue("instances", 1000), args.GetValue("frames", 10));
+	return true;
+}
+
+bool Command_AnimCrowd(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot spawn a crowd in current scene!");
+		return true;
+	}
+
+	// count=0 removes the crowd
+	if (!scene->SpawnCrowd(args.GetValue("count", 100), args.GetValue("radius", 2000.0f)))
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "A crowd needs an anim graph, load one first");
+	return true;
+}
+
+bool Command_AnimBudget(EventArgs& args)
+{
+	SceneSkelAnim* scene = dynamic_cast<SceneSkelAnim*>(g_theGame->GetCurrentScene());
+	if (!scene)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Cannot set the animation budget in current scene!");
+		return true;
+	}
+
+	scene->SetAnimBudget(args.GetValue("ms", 2.0f));
 	return true;
 }
 
 bool InitializeModelCommands()
 {
 	g_theEventSystem->SubscribeEventCallbackFunction("LoadModel", Command_Load);
+	g_theEventSystem->SubscribeEventCallbackFunction("CancelLoad", Command_CancelLoad);
+	g_theEventSystem->SubscribeEventCallbackFunction("ClipLibrary", Command_ClipLibrary);
+	g_theEventSystem->SubscribeEventCallbackFunction("Morph", Command_Morph);
+	g_theEventSystem->SubscribeEventCallbackFunction("BakeVertexAnimation", Command_BakeVertexAnimation);
+	g_theEventSystem->SubscribeEventCallbackFunction("PlayVertexAnimation", Command_PlayVertexAnimation);
+	g_theEventSystem->SubscribeEventCallbackFunction("QueryBone", Command_QueryBone);
+	g_theEventSystem->SubscribeEventCallbackFunction("ModelLod", Command_ModelLod);
+	g_theEventSystem->SubscribeEventCallbackFunction("MotionDatabase", Command_MotionDatabase);
+	g_theEventSystem->SubscribeEventCallbackFunction("MotionSearch", Command_MotionSearch);
+	g_theEventSystem->SubscribeEventCallbackFunction("AnimGraph", Command_AnimGraph);
+	g_theEventSystem->SubscribeEventCallbackFunction("AnimParam", Command_AnimParam);
+	g_theEventSystem->SubscribeEventCallbackFunction("AnimGraphBench", Command_AnimGraphBench);
+	g_theEventSystem->SubscribeEventCallbackFunction("AnimCrowd", Command_AnimCrowd);
+	g_theEventSystem->SubscribeEventCallbackFunction("AnimBudget", Command_AnimBudget);
 
 	return true;
 }
@@ -106,15 +329,28 @@ SceneSkelAnim::SceneSkelAnim(Game* game) : Scene(game)
 
 SceneSkelAnim::~SceneSkelAnim()
 {
-	delete m_animation;
-	m_animation = nullptr;
-	delete m_mesh;
-	m_mesh = nullptr;
-	for (auto* vbo : m_vbos)
-		delete vbo;
-	m_vbos.clear();
-	delete m_ibo;
-	m_ibo = nullptr;
+	delete m_pendingLoad;
+	m_pendingLoad = nullptr;
+	for (auto* request : m_retiredLoads)
+		delete request;
+	m_retiredLoads.clear();
+	m_animScheduler.Clear();
+	m_crowd.clear();
+	delete m_animGraph;
+	m_animGraph = nullptr;
+
+	// resources stay cached in the manager for the next scene
+	m_pendingModel.Reset();
+	m_clip.Reset();
+	m_clipPlayback.Reset();
+	m_retarget.Reset();
+	m_model.Reset();
+	delete m_vertexAnimation;
+	m_vertexAnimation = nullptr;
+	ReleaseMorphBuffers();
+	delete m_pose;
+	m_pose = nullptr;
+	m_skeleton.reset();
 }
 
 void SceneSkelAnim::Initialize()
@@ -142,8 +378,30 @@ void SceneSkelAnim::Update()
 		HandleInput();
 	}
 
+	// frame boundary, nothing of the previous assets is referenced past this point
+	UpdatePendingLoad();
+	UpdateReloadedResources();
+	if (!m_crowd.empty())
+		UpdateCrowd((float)m_clock.GetDeltaTime());
+
+	if (m_vertexAnimation)
+	{
+		m_vertexAnimation->Sample(GetLifeTime(), m_morphPositions.data(), m_morphNormals.data());
+		g_theRenderer->CopyCPUToGPU(m_morphPositions.data(), m_morphPositions.size() * sizeof(Vec3), m_morphVbos[0]);
+		g_theRenderer->CopyCPUToGPU(m_morphNormals.data(), m_morphNormals.size() * sizeof(Vec3), m_morphVbos[1]);
+	}
+	else if (m_morphs && m_morphs->GetTargetCount() > 0)
+	{
+		const SkeletalMeshStreams& streams = m_model->m_streams;
+		if (m_morphs->Apply(m_morphWeights.data(), m_morphState, streams.m_positions, streams.m_normals, m_morphPositions.data(), m_morphNormals.data()))
+		{
+			g_theRenderer->CopyCPUToGPU(m_morphPositions.data(), m_morphPositions.size() * sizeof(Vec3), m_morphVbos[0]);
+			g_theRenderer->CopyCPUToGPU(m_morphNormals.data(), m_morphNormals.size() * sizeof(Vec3), m_morphVbos[1]);
+		}
+	}
+
 	auto& pose = *m_pose;
-	pose = m_mesh->m_skeleton.GetPose();
+	pose.m_boneLocalPose = m_skeleton->m_bindPose;
 // 	{
 // 		BoneId boneId = mesh->m_skeleton.FindBone("spine_01");
 // 		pose.m_boneLocalPose[boneId].m_orientation.m_pitchDegrees = cosf(GetLifeTime() * 5.0f) * 3.0f * 1.0f;
@@ -165,15 +423,53 @@ void SceneSkelAnim::Update()
 // 		pose.m_boneLocalPose[boneId].m_orientation.m_pitchDegrees = cosf(GetLifeTime() * 5.0f) * 3.0f * 5.0f;
 // 	}
 
-	AnimationFrame frame = m_animation->Sample(GetLifeTime(), pose);
-	frame.Apply(pose);
-	pose.BakeLocalToComp();
-	pose.BakeFromComp();
+	// a reloaded skeleton leaves the clip unbound until it is reloaded against the new one
+	float deltaSeconds = (float)m_clock.GetDeltaTime();
+	if (m_vertexAnimation)
+	{
+		// positions are already skinned, the bind pose keeps every skinning matrix at identity
+	}
+	else if (m_animGraph && m_animGraph->GetProgram()->GetSkeletonHash() == m_skeleton->m_hash)
+	{
+		m_graphEvaluator.Evaluate(*m_animGraph, deltaSeconds, pose.m_boneLocalPose);
+	}
+	else if (IsClipBound())
+	{
+		if (m_retarget)
+		{
+			m_retarget->m_map.SamplePose(*m_clip->m_clip, GetLifeTime(), pose, m_clipPlayback);
+		}
+		else if (m_clip->m_animation)
+		{
+			AnimationFrame frame = m_clip->m_animation->Sample(GetLifeTime(), pose);
+			frame.Apply(pose);
+		}
+		else
+		{
+			m_clip->m_clip->SamplePose(GetLifeTime(), pose, m_clipPlayback);
+		}
+	}
+
+	// only the target clip is sampled, the source clip survives as a decaying offset
+	if (m_transitionTime > 0.0f)
+	{
+		if (m_poseHistory[1].size() == pose.m_boneLocalPose.size())
+			m_inertializer.Begin(m_poseHistory[0], m_poseHistory[1], pose.m_boneLocalPose, deltaSeconds, m_transitionTime);
+		m_transitionTime = 0.0f;
+	}
+	m_inertializer.Apply(deltaSeconds, pose.m_boneLocalPose);
+	m_poseHistory[1].swap(m_poseHistory[0]);
+	m_poseHistory[0] = pose.m_boneLocalPose;
+
+	// a playing clip changes nearly every bone, a paused one or the bind pose bakes nothing
+	// last frame's IK edits differ from the new locals, so the solved chain is restored here too
+	m_baker.MarkChanged(pose);
+	m_baker.Bake(pose);
 }
 
 void SceneSkelAnim::UpdateCamera()
 {
-	m_worldCamera[0].SetPerspectiveView(float(g_theWindow->GetClientDimensions().x) / float(g_theWindow->GetClientDimensions().y), 60.0f, 0.1f, 10000.0f);
+	m_worldCamera[0].SetPerspectiveView(float(g_theWindow->GetClientDimensions().x) / float(g_theWindow->GetClientDimensions().y), WORLD_CAMERA_FOV_DEGREES, 0.1f, 10000.0f);
 
 	// transform game conventions(x in y left z up) to dx conventions(x right y up z in)
 	// dx.x = -game.y, dx.y = game.z, dx.z = game.x
@@ -232,19 +528,23 @@ void SceneSkelAnim::RenderWorld() const
 
 	if (m_ikHead)
 	{
-		solver.m_rootBone = pose.m_skeleton->FindBone("spine_01");
-		solver.m_targetBone = pose.m_skeleton->FindBone("head");
+		solver.m_rootBone = m_skeleton->m_boneLookup.Find(BONE("spine_01"));
+		solver.m_targetBone = m_skeleton->m_boneLookup.Find(BONE("head"));
 	}
 	else
 	{
-		solver.m_rootBone = pose.m_skeleton->FindBone("lowerarm_r");
-		solver.m_targetBone = pose.m_skeleton->FindBone("index_01_r");
+		solver.m_rootBone = m_skeleton->m_boneLookup.Find(BONE("lowerarm_r"));
+		solver.m_targetBone = m_skeleton->m_boneLookup.Find(BONE("index_01_r"));
 	}
 
 	std::deque<FABRIKNode> nodesInitial;
 	std::deque<FABRIKNode> nodesAfter;
 	solver.Solve(pose, &nodesInitial, &nodesAfter);
 
+	// re-bake only the solved chain and what hangs below it
+	m_baker.MarkDirtyChain(solver.m_rootBone, solver.m_targetBone);
+	m_baker.Bake(pose);
+
 	g_theRenderer->SetModelMatrix(trans.GetMatrix() * conv);
 	g_theRenderer->SetFillMode(FillMode::SOLID);
 	g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
@@ -255,8 +555,9 @@ void SceneSkelAnim::RenderWorld() const
 
 	g_theRenderer->BindShader(g_SkeletalShader);
 	g_theRenderer->BindTexture(nullptr);
-	g_theRenderer->SetCustomConstantBuffer(4, pose.m_bakedPose.GetBuffer());
-	g_theRenderer->DrawIndexedVertexBuffer(m_ibo, (int)m_vbos.size(), (VertexBuffer**)m_vbos.data(), (int)m_mesh->m_indices.size());
+	g_theRenderer->SetCustomConstantBuffer(4, m_baker.GetSkinningMatrices());
+	m_lod = SelectLod(trans.GetMatrix() * conv);
+	g_theRenderer->DrawIndexedVertexBuffer(m_model->GetLodIbo(m_lod), (int)m_drawVbos.size(), (VertexBuffer**)m_drawVbos.data(), m_model->GetLodIndexCount(m_lod));
 	g_theRenderer->BindShader(nullptr);
 
 	{
@@ -273,7 +574,7 @@ void SceneSkelAnim::RenderWorld() const
 		verts3.clear();
 		AddVertsForXCone(verts3, Vec3(), 1.0f, 1.0f, Rgba8(255, 255, 255, 60));
 
-		auto& skel = m_mesh->m_skeleton;
+		auto& skel = m_skeleton->m_skeleton;
 
 		for (auto& bone : skel)
 		{
@@ -334,12 +635,44 @@ void SceneSkelAnim::RenderWorld() const
 
 	DebugAddMessage("WASD/QE = move camera, IJKL/UO = move IK effector, R = slow, F/G = change bone highlight, H = change IK target bone", 0.0f, Rgba8::WHITE, Rgba8::WHITE);
 
-	auto* hlBone = m_mesh->m_skeleton.FindBone(m_highlightBone);
-	auto* ikRoot = m_mesh->m_skeleton.FindBone(solver.m_rootBone);
-	auto* ikBone = m_mesh->m_skeleton.FindBone(solver.m_targetBone);
+	auto* hlBone = m_skeleton->m_skeleton.FindBone(m_highlightBone);
+	auto* ikRoot = m_skeleton->m_skeleton.FindBone(solver.m_rootBone);
+	auto* ikBone = m_skeleton->m_skeleton.FindBone(solver.m_targetBone);
 
 	std::string msg = Stringf("Current bone: %s, Current IK target: %s -> %s", hlBone->m_name.c_str(), ikRoot->m_name.c_str(), ikBone->m_name.c_str());
 	DebugAddMessage(msg, 0.0f, Rgba8::WHITE, Rgba8::WHITE);
+
+	msg = Stringf("LOD %d%s: %d triangles, screen size %.2f", m_lod, m_forcedLod >= 0 ? " (forced)" : "", m_model->GetLodIndexCount(m_lod) / 3, m_screenSize);
+	DebugAddMessage(msg, 0.0f, Rgba8::WHITE, Rgba8::WHITE);
+
+	if (!m_crowd.empty())
+	{
+		const AnimSchedulerStats& stats = m_animScheduler.GetStats();
+		msg = Stringf("Crowd of %d: %d updated, %d deferred, %.2f of %.2f ms, oldest waiting %.0f ms", (int)m_crowd.size(), stats.m_ranCount, stats.m_deferredCount,
+			stats.m_usedMilliseconds, m_animScheduler.GetConfig().m_budgetMilliseconds, stats.m_maxPendingSeconds * 1000.0f);
+		DebugAddMessage(msg, 0.0f, Rgba8::WHITE, Rgba8::WHITE);
+	}
+}
+
+int SceneSkelAnim::SelectLod(const Mat4x4& modelMatrix) const
+{
+	// bounding sphere diameter over the visible height at its distance
+	Vec3 center = modelMatrix.TransformPosition3D(m_model->m_boundsCenter);
+	float distance = (center - m_cameraPos.m_position).GetLength();
+	float halfHeight = distance * tanf(ConvertDegreesToRadians(WORLD_CAMERA_FOV_DEGREES * 0.5f));
+	m_screenSize = halfHeight > 0.0f ? m_model->m_boundsRadius / halfHeight : 1.0f;
+
+	int lodCount = m_model->GetLodCount();
+	if (m_forcedLod >= 0)
+		return std::min(m_forcedLod, lodCount - 1);
+
+	// move from the current lod, coarser only well below the switch size and finer only well above it
+	int lod = std::max(0, std::min(m_lod, std::min(lodCount, MESH_LOD_COUNT) - 1));
+	while (lod + 1 < lodCount && lod + 1 < MESH_LOD_COUNT && m_screenSize < MESH_LOD_SCREEN_SIZES[lod + 1] * (1.0f - MESH_LOD_HYSTERESIS))
+		lod++;
+	while (lod > 0 && m_screenSize > MESH_LOD_SCREEN_SIZES[lod] * (1.0f + MESH_LOD_HYSTERESIS))
+		lod--;
+	return lod;
 }
 
 void SceneSkelAnim::RenderUI() const
@@ -353,6 +686,14 @@ void SceneSkelAnim::RenderUI() const
 
 	RenderUILogoText();
 
+	if (m_pendingLoad)
+	{
+		std::vector<Vertex_PCU> verts;
+		std::string text = Stringf("%s: %s %d%%", m_pendingLoad->m_animationName.c_str(), m_pendingLoad->GetStageName(), (int)(m_pendingLoad->GetProgress() * 100.0f));
+		AddVertsForText(verts, text.c_str(), 1.0f, 0.5f);
+		RenderFontVertices((int)verts.size(), &verts[0], g_theRenderer->GetViewport().GetPointAtUV(Vec2(0.5f, 0.1f)), Rgba8(), 20.0f, true);
+	}
+
 	DebugRenderScreen(GetScreenCamera());
 }
 
@@ -429,7 +770,7 @@ void SceneSkelAnim::HandleInput()
 
 	if (g_theInput->WasKeyJustPressed(KEYCODE_F))
 	{
-		hlBone += (int)m_mesh->m_skeleton.size() - 1;
+		hlBone += (int)m_skeleton->m_skeleton.size() - 1;
 	}
 
 	if (g_theInput->WasKeyJustPressed(KEYCODE_G))
@@ -442,7 +783,7 @@ void SceneSkelAnim::HandleInput()
 		m_ikHead = !m_ikHead;
 	}
 
-	m_highlightBone = (BoneId)(hlBone % (int)m_mesh->m_skeleton.size());
+	m_highlightBone = (BoneId)(hlBone % (int)m_skeleton->m_skeleton.size());
 
 	float deltaSeconds = (float)m_clock.GetDeltaTime();
 
@@ -520,147 +861,528 @@ void SceneSkelAnim::HandleInput()
 	g_theInput->SetMouseMode(true, true, true);
 }
 
-void SceneSkelAnim::LoadModel(const char* name)
+bool SceneSkelAnim::SetMorphWeight(const char* target, float weight)
 {
+	int targetIdx = m_morphs ? m_morphs->FindTarget(target) : -1;
+	if (targetIdx < 0)
+		return false;
+
+	m_morphWeights[targetIdx] = weight;
+	return true;
+}
+
+const Skeleton& SceneSkelAnim::GetSkeleton() const
+{
+	return m_skeleton->m_skeleton;
+}
+
+void SceneSkelAnim::BakeVertexAnimation(float tps)
+{
+	if (m_retarget || m_clip->m_library)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Only a clip loaded from its own file on this skeleton can be baked!");
+		return;
+	}
+
+	// loaded meshes carry neither streams nor skeleton, build a temporary one for the cpu bake
+	SkeletalMesh mesh;
+	mesh.m_name = m_model->m_mesh->m_name;
+	mesh.m_skeleton = m_skeleton->m_skeleton;
+	CopyStreamsToMesh(m_model->m_streams, mesh);
+
+	VertexAnimation vat;
+	vat.BakeFrom(mesh, *m_clip->m_clip, tps);
+
+	// the same asset the cooker writes with -vat, PlayVertexAnimation reads it back
+	std::string cookedPath = GetCookedVertexAnimationPath(m_model->m_name, m_clip->m_name);
+	if (!WriteCookedVertexAnimation(cookedPath, MakeVertexAnimationKey(m_model->m_name, m_clip->m_name, m_skeleton->m_hash), vat))
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Could not write %s!", cookedPath.c_str()));
+		return;
+	}
+
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Baked %s: %d frames, %d KB", vat.m_name.c_str(), vat.m_frameCount, (int)(vat.GetFrameBytes() * vat.m_frameCount / 1024)));
+}
+
+bool SceneSkelAnim::PlayVertexAnimation(bool enable)
+{
+	StopVertexAnimation();
+	if (!enable)
+		return true;
+
+	VertexAnimation* vat = new VertexAnimation();
+	std::string cookedPath = GetCookedVertexAnimationPath(m_model->m_name, m_clip->m_name);
+	if (!ReadCookedVertexAnimation(cookedPath, MakeVertexAnimationKey(m_model->m_name, m_clip->m_name, m_skeleton->m_hash), *vat) || vat->m_vertexCount != (int)m_model->m_streams.m_vertexCount)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("No vertex animation of %s on %s, run BakeVertexAnimation or cook with -vat!", m_clip->m_name.c_str(), m_model->m_name.c_str()));
+		delete vat;
+		return false;
+	}
+
+	// written through the morph buffers, a model without blend shapes gets them here
 	auto& layout = g_SkeletalShaderLayout;
+	size_t vertexCount = m_model->m_streams.m_vertexCount;
+	m_morphPositions.resize(vertexCount);
+	m_morphNormals.resize(vertexCount);
+	for (int slot = 0; slot < 2; slot++)
+	{
+		if (!m_morphVbos[slot])
+			m_morphVbos[slot] = g_theRenderer->CreateVertexBuffer(vertexCount * layout[slot].GetVertexStride(), &layout[slot]);
+		m_drawVbos[slot] = m_morphVbos[slot];
+	}
 
-	AssimpRes aiRes(Stringf("Data/Models/%s.FBX", name).c_str());
-	aiRes.SetSpaceConventions(Mat4x4(Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3::ZERO)); // no conversion
+	m_vertexAnimation = vat;
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Playing %s, %d frames at %.0f fps", vat->m_name.c_str(), vat->m_frameCount, vat->m_tps));
+	return true;
+}
 
-	// load mesh
+void SceneSkelAnim::StopVertexAnimation()
+{
+	if (!m_vertexAnimation)
+		return;
+
+	delete m_vertexAnimation;
+	m_vertexAnimation = nullptr;
+
+	// back to the bind streams, blend shapes apply on top of them again from the next frame
+	const SkeletalMeshStreams& streams = m_model->m_streams;
+	if (m_morphs && m_morphs->GetTargetCount() > 0)
+	{
+		m_morphState.Reset();
+		m_morphPositions.assign(streams.m_positions, streams.m_positions + streams.m_vertexCount);
+		m_morphNormals.assign(streams.m_normals, streams.m_normals + streams.m_vertexCount);
+		g_theRenderer->CopyCPUToGPU(m_morphPositions.data(), m_morphPositions.size() * sizeof(Vec3), m_morphVbos[0]);
+		g_theRenderer->CopyCPUToGPU(m_morphNormals.data(), m_morphNormals.size() * sizeof(Vec3), m_morphVbos[1]);
+	}
+	else
 	{
-		delete m_mesh;
-		delete m_pose;
+		ReleaseMorphBuffers();
+		m_drawVbos = m_model->m_vbos;
+		m_morphPositions.clear();
+		m_morphNormals.clear();
+	}
+}
 
-		auto meshes = aiRes.LoadMesh();
-		ASSERT_OR_DIE(meshes.size(), "No mesh in model file!");
+void SceneSkelAnim::LoadModel(const char* name)
+{
+	MeshSelection selection;
+	std::string id = MakeModelResourceId(name, selection);
+	ResourceHandle<ModelResource> model = g_theResources->Find<ModelResource>(id);
+	if (!model)
+	{
+		LoadedModel loaded;
+		bool isLoaded = LoadModelData(name, selection, loaded);
+		ASSERT_OR_DIE(isLoaded, "No mesh in model file!");
+		model = g_theResources->Add(id, new ModelResource(loaded));
+	}
+	ApplyModel(model);
+}
+
+void SceneSkelAnim::LoadAnimation(const char* name, float blendTime)
+{
+	const SkeletonRef& skeleton = m_skeleton;
+	std::string id = MakeClipResourceId(name, *skeleton);
+	ResourceHandle<ClipResource> clip = g_theResources->Find<ClipResource>(id);
+	if (!clip)
+	{
+		LoadedAnimation loaded;
+		bool isLoaded = LoadAnimationData(name, skeleton, loaded);
+		ASSERT_OR_DIE(isLoaded, "No animation in model file!");
+		clip = g_theResources->Add(id, new ClipResource(loaded));
+	}
+	ApplyAnimation(clip, blendTime);
+}
+
+void SceneSkelAnim::RequestLoad(const std::string& model, const std::string& meshes, const std::string& animation, float blendTime, bool retarget)
+{
+	CancelLoad();
 
-		m_mesh = meshes[0];
-		m_pose = new Pose(m_mesh->m_skeleton.GetPose());
+	// same model keeps the pose alive so the clip change can be inertialized
+	MeshSelection selection(meshes);
+	bool loadModel = model != m_model->m_name || meshes != m_model->m_selection.GetSource();
+	m_pendingModel = loadModel ? g_theResources->Find<ModelResource>(MakeModelResourceId(model, selection)) : m_model;
 
-		for (auto& mesh : meshes)
+	// both cached, nothing to wait for
+	if (m_pendingModel)
+	{
+		// retargeted clips are cached under the animation file's skeleton, which the map remembers
+		const SkeletonAsset& skeleton = *m_pendingModel->m_skeleton;
+		ResourceHandle<RetargetResource> map = retarget ? g_theResources->Find<RetargetResource>(MakeRetargetResourceId(animation, skeleton)) : ResourceHandle<RetargetResource>();
+		ResourceHandle<ClipResource> clip;
+		if (!retarget || map)
+			clip = g_theResources->Find<ClipResource>(MakeClipResourceId(animation, map ? *map->m_sourceSkeleton : skeleton));
+		if (!clip && !retarget)
+			clip = FindLibraryClip(animation, m_pendingModel->m_skeleton);
+		if (clip)
 		{
-			if (mesh != m_mesh)
-				delete mesh;
+			if (m_pendingModel != m_model)
+				ApplyModel(m_pendingModel);
+			ApplyAnimation(clip, blendTime, map);
+			m_pendingModel.Reset();
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loaded %s/%s from cache", model.c_str(), animation.c_str()));
+			return;
 		}
 	}
-	
-	if (TEST_MODEL_SERIALIZATION)
+
+	SkeletonRef skeleton = m_pendingModel ? m_pendingModel->m_skeleton : SkeletonRef();
+	m_pendingLoad = new AsyncLoadRequest(model, selection, animation, skeleton, blendTime, retarget);
+	m_pendingLoad->Start();
+}
+
+bool SceneSkelAnim::LoadClipLibrary(const std::string& name, const std::vector<std::string>& clips)
+{
+	double startTime = GetCurrentTimeSeconds();
+	std::shared_ptr<ClipLibrary> library = std::make_shared<ClipLibrary>();
+	if (!LoadClipLibraryData(name.c_str(), clips, m_skeleton, *library))
 	{
-		ByteBuffer buffer;
-		uint64_t endian = 0x01020304CAFEBADEULL;
-		buffer.Write(endian); // endianness identifier
-		m_mesh->WriteBytes(&buffer);
-		FileWriteFromBuffer(buffer, Stringf("Content/Cooked/Assets/SKEL_%s.asset", m_mesh->m_name.c_str()));
-		buffer.ResetRead();
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Clip library %s failed, every clip needs a source bound to %s", name.c_str(), m_model->m_name.c_str()));
+		return false;
+	}
 
-		auto* nmesh = new SkeletalMesh();
-		buffer.Read(endian);
-		nmesh->ReadBytes(&buffer);
+	m_clipLibrary = library;
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Clip library %s: %d clips, %.1f MB of keys, %s in %.1f ms", name.c_str(), library->GetClipCount(),
+		(float)library->GetArenaBytes() / (1024.0f * 1024.0f), library->IsMapped() ? "mapped" : "packed", (GetCurrentTimeSeconds() - startTime) * 1000.0));
+	return true;
+}
+
+bool SceneSkelAnim::LoadAnimGraph(const std::string& filePath)
+{
+	delete m_animGraph;
+	m_animGraph = nullptr;
+	if (filePath.empty())
+		return false;
 
-		delete m_mesh;
-		delete m_pose;
-		m_mesh = nmesh;
-		m_pose = new Pose(m_mesh->m_skeleton.GetPose());
+	AnimGraphDesc desc;
+	if (!desc.LoadFromFile(filePath.c_str()))
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Anim graph %s could not be read", filePath.c_str()));
+		return false;
 	}
 
-	// load mesh into GPU
+	std::string error;
+	std::shared_ptr<AnimGraphProgram> program = std::make_shared<AnimGraphProgram>();
+	if (!program->Compile(desc, m_clipLibrary, m_skeleton->m_hash, error))
 	{
-		delete m_ibo;
-		for (auto& vbo : m_vbos)
-			delete vbo;
-		m_vbos.clear();
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Anim graph %s: %s", filePath.c_str(), error.c_str()));
+		return false;
+	}
 
-		auto& mesh = m_mesh;
-		auto& vboList = m_vbos;
-		VertexBuffer* vbo;
+	m_animGraph = new AnimGraphInstance(program);
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Anim graph %s: %d states, %d instructions, %d pose slots, %d bytes", filePath.c_str(),
+		program->GetStateCount(), program->GetInstructionCount(), program->GetSlotCount(), (int)program->GetBytes()));
+	return true;
+}
 
-		// vbo position
-		vbo = g_theRenderer->CreateVertexBuffer(mesh->m_vertices.size() * layout[0].GetVertexStride(), &layout[0]);
-		g_theRenderer->CopyCPUToGPU(mesh->m_vertices.data(), mesh->m_vertices.size() * layout[0].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+bool SceneSkelAnim::SetAnimGraphParameter(const char* name, float value)
+{
+	return m_animGraph && m_animGraph->SetParameter(name, value);
+}
 
-		// vbo normal
-		vbo = g_theRenderer->CreateVertexBuffer(mesh->m_normals.size() * layout[1].GetVertexStride(), &layout[1]);
-		g_theRenderer->CopyCPUToGPU(mesh->m_normals.data(), mesh->m_normals.size() * layout[1].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+void SceneSkelAnim::BenchmarkAnimGraph(int instanceCount, int frameCount) const
+{
+	if (!m_animGraph || instanceCount <= 0 || frameCount <= 0)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "No anim graph loaded");
+		return;
+	}
 
-		// vbo color
-		std::vector<Rgba8> colors;
-		colors.resize(mesh->m_vertices.size());
-		vbo = g_theRenderer->CreateVertexBuffer(colors.size() * layout[2].GetVertexStride(), &layout[2]);
-		g_theRenderer->CopyCPUToGPU(colors.data(), colors.size() * layout[2].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+	// a crowd sharing the program, each with its own random parameter block
+	const AnimGraphRef& program = m_animGraph->GetProgram();
+	std::vector<AnimGraphInstance> instances(instanceCount, AnimGraphInstance(program));
+	for (auto& instance : instances)
+	{
+		for (int parameter = 0; parameter < program->GetParameterCount(); parameter++)
+			instance.SetParameter(parameter, g_theGame->m_rng->RollRandomFloatInRange(0.0f, 1.0f));
+	}
 
-		// vbo texcoords
-		vbo = g_theRenderer->CreateVertexBuffer(mesh->m_uvs[0].size() * layout[3].GetVertexStride(), &layout[3]);
-		g_theRenderer->CopyCPUToGPU(mesh->m_uvs[0].data(), mesh->m_uvs[0].size() * layout[3].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+	AnimGraphEvaluator evaluator;
+	std::vector<TransformQuat> pose;
+	double startTime = GetCurrentTimeSeconds();
+	for (int frameIdx = 0; frameIdx < frameCount; frameIdx++)
+	{
+		for (auto& instance : instances)
+			evaluator.Evaluate(instance, 1.0f / 60.0f, pose);
+	}
+	double instanceTime = (GetCurrentTimeSeconds() - startTime) * 1000000.0 / ((double)instanceCount * frameCount);
 
-		// vbo boneIds
-		vbo = g_theRenderer->CreateVertexBuffer(mesh->m_boneIndices.size() * layout[4].GetVertexStride(), &layout[4]);
-		g_theRenderer->CopyCPUToGPU(mesh->m_boneIndices.data(), mesh->m_boneIndices.size() * layout[4].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Anim graph: %d instances x %d frames, %.2f us per instance, %d bytes of parameters each",
+		instanceCount, frameCount, instanceTime, program->GetParameterCount() * (int)sizeof(float)));
+}
 
-		// vbo boneWeights
-		vbo = g_theRenderer->CreateVertexBuffer(mesh->m_boneWeights.size() * layout[5].GetVertexStride(), &layout[5]);
-		g_theRenderer->CopyCPUToGPU(mesh->m_boneWeights.data(), mesh->m_boneWeights.size() * layout[5].GetVertexStride(), vbo);
-		vboList.push_back(vbo);
+bool SceneSkelAnim::SpawnCrowd(int count, float radius)
+{
+	m_animScheduler.Clear();
+	m_crowd.clear();
+	if (count <= 0)
+		return true;
+	if (!m_animGraph)
+		return false;
 
-		// ibo
-		m_ibo = g_theRenderer->CreateIndexBuffer(sizeof(int) * mesh->m_indices.size());
-		g_theRenderer->CopyCPUToGPU(mesh->m_indices.data(), sizeof(int) * mesh->m_indices.size(), m_ibo);
+	// updates find their agent by index, so the vector is never resized while they are registered
+	m_crowd.reserve(count);
+	for (int agentIdx = 0; agentIdx < count; agentIdx++)
+	{
+		m_crowd.emplace_back(m_animGraph->GetProgram());
+		CrowdAgent& agent = m_crowd.back();
+		agent.m_position = Vec3(g_theGame->m_rng->RollRandomFloatInRange(-radius, radius), g_theGame->m_rng->RollRandomFloatInRange(-radius, radius), 0.0f);
+		for (int parameter = 0; parameter < agent.m_graph.GetProgram()->GetParameterCount(); parameter++)
+			agent.m_graph.SetParameter(parameter, g_theGame->m_rng->RollRandomFloatInRange(0.0f, 1.0f));
+
+		agent.m_task = m_animScheduler.Register([this, agentIdx](float deltaSeconds)
+		{
+			CrowdAgent& updated = m_crowd[agentIdx];
+			m_graphEvaluator.Evaluate(updated.m_graph, deltaSeconds, updated.m_pose);
+		});
 	}
+	return true;
 }
 
-void SceneSkelAnim::LoadAnimation(const char* name)
+void SceneSkelAnim::SetAnimBudget(float milliseconds)
 {
-	AssimpRes aiRes(Stringf("Data/Models/%s.FBX", name).c_str());
-	aiRes.SetSpaceConventions(Mat4x4(Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3::ZERO)); // no conversion
+	AnimSchedulerConfig config = m_animScheduler.GetConfig();
+	config.m_budgetMilliseconds = milliseconds;
+	m_animScheduler.SetConfig(config);
+}
 
-	// load mesh
+void SceneSkelAnim::UpdateCrowd(float deltaSeconds)
+{
+	// visible inside a cone about as wide as the horizontal view of a wide screen
+	Vec3 forward = m_cameraPos.m_orientation.GetMatrix_XFwd_YLeft_ZUp().TransformVectorQuantity3D(Vec3(1.0f, 0.0f, 0.0f));
+	float cosVisible = cosf(ConvertDegreesToRadians(WORLD_CAMERA_FOV_DEGREES));
+	for (auto& agent : m_crowd)
 	{
-		delete m_animation;
-
-		auto animations = aiRes.LoadAnimation(m_mesh->m_skeleton);
-		ASSERT_OR_DIE(animations.size(), "No animation in model file!");
-		m_animation = animations[0];
+		Vec3 toAgent = agent.m_position - m_cameraPos.m_position;
+		float distance = toAgent.GetLength();
+		bool isVisible = distance <= 0.0f || DotProduct3D(toAgent, forward) >= cosVisible * distance;
+		m_animScheduler.SetPriorityInputs(agent.m_task, distance, isVisible);
+	}
+	m_animScheduler.RunFrame(deltaSeconds);
+}
 
-		for (auto& anim : animations)
+bool SceneSkelAnim::BuildMotionDatabase()
+{
+	std::vector<const AnimClip*> clips;
+	if (m_clipLibrary && m_clipLibrary->GetClipCount() > 0)
+	{
+		for (int clipId = 0; clipId < m_clipLibrary->GetClipCount(); clipId++)
 		{
-			if (anim != m_animation)
-				delete anim;
+			if (m_clipLibrary->GetEntry(clipId).m_skeletonHash == m_skeleton->m_hash)
+				clips.push_back(&m_clipLibrary->GetClip(clipId));
 		}
 	}
+	else if (GetClip())
+	{
+		clips.push_back(GetClip());
+	}
+
+	double startTime = GetCurrentTimeSeconds();
+	if (clips.empty() || !m_motionDatabase.Build(*m_skeleton, clips))
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Motion database failed, needs clips bound to %s with feet and hips", m_model->m_name.c_str()));
+		return false;
+	}
+
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Motion database: %d frames of %d clips, %.2f MB in %.1f ms", m_motionDatabase.GetEntryCount(), m_motionDatabase.GetClipCount(),
+		(float)m_motionDatabase.GetBytes() / (1024.0f * 1024.0f), (GetCurrentTimeSeconds() - startTime) * 1000.0));
+	return true;
+}
+
+void SceneSkelAnim::BenchmarkMotionSearch(int queryCount) const
+{
+	if (m_motionDatabase.GetEntryCount() == 0 || queryCount <= 0)
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, "Motion database is empty, build it first");
+		return;
+	}
+
+	// database frames with noise on every feature, so the answer is near but rarely exact
+	std::vector<float> queries((size_t)queryCount * MOTION_FEATURE_COUNT);
+	for (int queryIdx = 0; queryIdx < queryCount; queryIdx++)
+	{
+		float* query = &queries[(size_t)queryIdx * MOTION_FEATURE_COUNT];
+		m_motionDatabase.GetEntryFeatures(g_theGame->m_rng->RollRandomIntInRange(0, m_motionDatabase.GetEntryCount() - 1), query);
+		for (int feature = 0; feature < MOTION_FEATURE_COUNT; feature++)
+			query[feature] += g_theGame->m_rng->RollRandomFloatInRange(-0.25f, 0.25f);
+	}
+
+	std::vector<MotionMatch> matches[2];
+	double queryTimes[2];
+	MotionSearchMode modes[2] = { MotionSearchMode::BRUTE_FORCE, MotionSearchMode::AABB_TREE };
+	for (int modeIdx = 0; modeIdx < 2; modeIdx++)
+	{
+		matches[modeIdx].resize(queryCount);
+		double startTime = GetCurrentTimeSeconds();
+		for (int queryIdx = 0; queryIdx < queryCount; queryIdx++)
+			matches[modeIdx][queryIdx] = m_motionDatabase.Search(&queries[(size_t)queryIdx * MOTION_FEATURE_COUNT], modes[modeIdx]);
+		queryTimes[modeIdx] = (GetCurrentTimeSeconds() - startTime) * 1000000.0 / queryCount;
+	}
+
+	int agreeCount = 0;
+	for (int queryIdx = 0; queryIdx < queryCount; queryIdx++)
+	{
+		if (matches[0][queryIdx].m_cost == matches[1][queryIdx].m_cost)
+			agreeCount++;
+	}
+
+	const MotionMatch& last = matches[1].back();
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Motion search over %d frames: brute force %.1f us, box tree %.1f us per query, %d of %d agree",
+		m_motionDatabase.GetEntryCount(), queryTimes[0], queryTimes[1], agreeCount, queryCount));
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("last match: %s frame %d, cost %.3f", m_motionDatabase.GetClipName(last.m_clip).c_str(), last.m_frame, last.m_cost));
+}
+
+ResourceHandle<ClipResource> SceneSkelAnim::FindLibraryClip(const std::string& name, const SkeletonRef& skeleton) const
+{
+	int clipId = m_clipLibrary ? m_clipLibrary->FindClip(name) : -1;
+	if (clipId < 0 || m_clipLibrary->GetEntry(clipId).m_skeletonHash != skeleton->m_hash)
+		return ResourceHandle<ClipResource>();
 
-	if (TEST_MODEL_SERIALIZATION)
+	return g_theResources->Add(MakeClipResourceId(name, *skeleton), new ClipResource(m_clipLibrary, clipId, name, skeleton));
+}
+
+bool SceneSkelAnim::CancelLoad()
+{
+	if (!m_pendingLoad)
+		return false;
+
+	m_pendingLoad->Cancel();
+	m_retiredLoads.push_back(m_pendingLoad);
+	m_pendingLoad = nullptr;
+	m_pendingModel.Reset();
+	return true;
+}
+
+void SceneSkelAnim::UpdatePendingLoad()
+{
+	for (size_t idx = 0; idx < m_retiredLoads.size();)
 	{
-		ByteBuffer buffer;
-		uint64_t endian = 0x01020304CAFEBADEULL;
-		buffer.Write(endian); // endianness identifier
-		m_animation->WriteBytes(&buffer);
-		FileWriteFromBuffer(buffer, Stringf("Content/Cooked/Assets/ANIM_%s.asset", m_animation->m_name.c_str()));
-		buffer.ResetRead();
+		if (m_retiredLoads[idx]->IsDone())
+		{
+			delete m_retiredLoads[idx];
+			m_retiredLoads.erase(m_retiredLoads.begin() + idx);
+		}
+		else
+		{
+			idx++;
+		}
+	}
 
-		Animation* nanim = new CurveAnimation();
-		buffer.Read(endian);
-		nanim->ReadBytes(&buffer);
+	if (!m_pendingLoad || !m_pendingLoad->IsDone())
+		return;
 
-		delete m_animation;
-		m_animation = nanim;
+	AsyncLoadRequest* request = m_pendingLoad;
+	ResourceHandle<ModelResource> model = std::move(m_pendingModel);
+	m_pendingLoad = nullptr;
+
+	if (request->HasFailed())
+	{
+		g_theConsole->AddLine(DevConsole::LOG_INFO, request->m_error);
 	}
+	else
+	{
+		// results become shared resources here, on the main thread
+		for (auto& rejected : request->m_model.m_rejectedMeshes)
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("%s: %s", request->m_modelName.c_str(), rejected.c_str()));
+		if (request->m_loadModel)
+			model = g_theResources->Add(MakeModelResourceId(request->m_modelName, request->m_meshSelection), new ModelResource(request->m_model));
+		const SkeletonAsset& skeleton = *model->m_skeleton;
+		ResourceHandle<RetargetResource> map;
+		if (request->m_sourceSkeleton)
+			map = g_theResources->Add(MakeRetargetResourceId(request->m_animationName, skeleton), new RetargetResource(request->m_sourceSkeleton, request->m_retargetMap));
+		ResourceHandle<ClipResource> clip = g_theResources->Add(MakeClipResourceId(request->m_animationName, map ? *map->m_sourceSkeleton : skeleton), new ClipResource(request->m_animation));
+
+		if (model != m_model)
+			ApplyModel(model);
+		ApplyAnimation(clip, request->m_blendTime, map);
+		g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loaded %s/%s", request->m_modelName.c_str(), request->m_animationName.c_str()));
+		if (map)
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Retargeted %d of %d bones", map->m_map.GetMappedBoneCount(), map->m_map.GetTargetBoneCount()));
+	}
+
+	delete request;
+}
 
-	// load animation
+void SceneSkelAnim::ApplyModel(const ResourceHandle<ModelResource>& model)
+{
+	auto& layout = g_SkeletalShaderLayout;
 
-	if (TEST_CONV_ANIM_TO_FRAMES)
+	// old model is released here, the manager keeps it cached until the budget needs the memory
+	m_model = model;
+	m_appliedModelVersion = m_model.GetVersion();
+	m_skeleton = m_model->m_skeleton;
+
+	delete m_pose;
+	m_pose = new Pose(m_skeleton->m_skeleton.GetPose());
+	m_baker.Initialize(*m_skeleton);
+	m_inertializer.Reset();
+	m_poseHistory[0].clear();
+	m_poseHistory[1].clear();
+
+	const SkeletalMeshStreams& streams = m_model->m_streams;
+	size_t vertexCount = streams.m_vertexCount;
+	delete m_vertexAnimation;
+	m_vertexAnimation = nullptr;
+	m_drawVbos = m_model->m_vbos;
+	ReleaseMorphBuffers();
+
+	// blend shapes, morphed positions and normals go to our own buffers so the model stays shareable
 	{
-		FrameAnimation* fanim = new FrameAnimation();
-		fanim->m_tps = 60.f;
-		fanim->BakeFrom(*m_animation, m_mesh->m_skeleton.GetPose());
-		fanim->m_name = m_animation->m_name + "_baked_60fps";
-		delete m_animation;
-		m_animation = fanim;
+		m_morphs = m_model->m_morphs;
+		m_morphState.Reset();
+		int morphCount = m_morphs->GetTargetCount();
+		m_morphWeights.assign(morphCount, 0.0f);
+		m_morphPositions.clear();
+		m_morphNormals.clear();
+		if (morphCount > 0)
+		{
+			// only morphing models need their own copy of the streams, the others draw the model's buffers
+			m_morphPositions.assign(streams.m_positions, streams.m_positions + vertexCount);
+			m_morphNormals.assign(streams.m_normals, streams.m_normals + vertexCount);
+			for (int slot = 0; slot < 2; slot++)
+			{
+				m_morphVbos[slot] = g_theRenderer->CreateVertexBuffer(vertexCount * layout[slot].GetVertexStride(), &layout[slot]);
+				g_theRenderer->CopyCPUToGPU(slot == 0 ? m_morphPositions.data() : m_morphNormals.data(), vertexCount * layout[slot].GetVertexStride(), m_morphVbos[slot]);
+				m_drawVbos[slot] = m_morphVbos[slot];
+			}
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Loaded %d morph targets", morphCount));
+		}
+		if (m_model->m_submeshes.size() > 1)
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("Merged %d meshes into one draw", (int)m_model->m_submeshes.size()));
 	}
+}
 
+void SceneSkelAnim::UpdateReloadedResources()
+{
+	// hot reload swaps resources in place, the pose, baker and morph buffers still match the old version
+	if (m_model.GetVersion() == m_appliedModelVersion)
+		return;
+
+	ApplyModel(m_model);
+	if (!IsClipBound())
+		RequestLoad(m_model->m_name, m_model->m_selection.GetSource(), m_clip->m_name, 0.0f, (bool)m_retarget);
 }
 
+void SceneSkelAnim::ApplyAnimation(const ResourceHandle<ClipResource>& clip, float blendTime, const ResourceHandle<RetargetResource>& retarget)
+{
+	m_transitionTime = blendTime;
+	StopVertexAnimation(); // baked from the previous clip
+	m_clip = clip;
+	m_clipPlayback.Reset();
+	m_retarget = retarget;
+}
+
+bool SceneSkelAnim::IsClipBound() const
+{
+	// by hierarchy, rigs with the same bone count can still differ
+	if (m_retarget)
+		return m_retarget->m_map.GetTargetHash() == m_skeleton->m_hash && m_retarget->m_sourceSkeleton->m_hash == m_clip->m_skeleton->m_hash;
+	return m_clip->m_skeleton->m_hash == m_skeleton->m_hash;
+}
+
+void SceneSkelAnim::ReleaseMorphBuffers()
+{
+	for (auto*& vbo : m_morphVbos)
+	{
+		delete vbo;
+		vbo = nullptr;
+	}
+}
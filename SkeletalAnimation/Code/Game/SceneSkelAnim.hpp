@@ -1,4 +1,14 @@
 #include "Scene.hpp"
+#include "MorphTarget.hpp"
+#include "AnimClip.hpp"
+#include "PoseBaker.hpp"
+#include "Inertializer.hpp"
+#include "CookedAsset.hpp"
+#include "ModelLoader.hpp"
+#include "AnimResources.hpp"
+#include "AnimGraph.hpp"
+#include "AnimScheduler.hpp"
+#include "MotionDatabase.hpp"
 
 #include "Engine/Core/Vertex_PCU.hpp"
 #include "Engine/Audio/AudioSystem.hpp"
@@ -10,7 +20,7 @@
 
 class XboxController;
 class SkeletalMesh;
-class Animation;
+class VertexAnimation;
 class VertexBuffer;
 class IndexBuffer;
 
@@ -29,11 +39,39 @@ public:
 
 	// model & animation
 	void LoadModel(const char* name);
-	void LoadAnimation(const char* name);
+	void LoadAnimation(const char* name, float blendTime = 0.0f);
+	void RequestLoad(const std::string& model, const std::string& meshes, const std::string& animation, float blendTime, bool retarget = false);
+	bool CancelLoad();
+	bool LoadClipLibrary(const std::string& name, const std::vector<std::string>& clips);
+	const std::string& GetModelName() const { return m_model->m_name; }
+	bool SetMorphWeight(const char* target, float weight);
+	void BakeVertexAnimation(float tps);
+	bool PlayVertexAnimation(bool enable);
+	const AnimClip* GetClip() const { return m_clip && !m_retarget ? m_clip->m_clip : nullptr; } // bound to GetSkeleton(), none while retargeting
+	const Skeleton& GetSkeleton() const;
+	const BoneLookup& GetBoneLookup() const { return m_skeleton->m_boneLookup; }
+	void SetForcedLod(int lod) { m_forcedLod = lod; }
+	bool BuildMotionDatabase();
+	void BenchmarkMotionSearch(int queryCount) const;
+	bool LoadAnimGraph(const std::string& filePath);
+	bool SetAnimGraphParameter(const char* name, float value);
+	void BenchmarkAnimGraph(int instanceCount, int frameCount) const;
+	bool SpawnCrowd(int count, float radius);
+	void SetAnimBudget(float milliseconds);
 
 private:
 	void RenderUILogoText() const;
 	void HandleInput();
+	void UpdatePendingLoad();
+	void UpdateReloadedResources();
+	void ApplyModel(const ResourceHandle<ModelResource>& model);
+	ResourceHandle<ClipResource> FindLibraryClip(const std::string& name, const SkeletonRef& skeleton) const;
+	void ApplyAnimation(const ResourceHandle<ClipResource>& clip, float blendTime, const ResourceHandle<RetargetResource>& retarget = ResourceHandle<RetargetResource>());
+	bool IsClipBound() const;
+	int SelectLod(const Mat4x4& modelMatrix) const;
+	void UpdateCrowd(float deltaSeconds);
+	void ReleaseMorphBuffers();
+	void StopVertexAnimation();
 
 private:
 	int         m_menuSelectionIdx                  = 0;
@@ -43,12 +81,60 @@ private:
 
 	Transformation m_cameraPos;
 
-	// skeletal mesh & animation
-	SkeletalMesh* m_mesh = nullptr;
-	Animation* m_animation = nullptr;
+	// skeletal mesh & animation, shared through the resource manager
+	ResourceHandle<ModelResource> m_model;
+	ResourceHandle<ClipResource> m_clip;
+	AnimClipPlayback m_clipPlayback; // our decoded blocks of the clip, other scenes playing it keep their own
+	ResourceHandle<RetargetResource> m_retarget; // set while the clip plays through a map onto our skeleton
+	ClipLibraryRef m_clipLibrary; // clips found here play without a load
+	MotionDatabase m_motionDatabase; // library clips, or the playing clip without a library
+	AnimGraphInstance* m_animGraph = nullptr; // drives the pose instead of the clip while it matches our skeleton
+	AnimGraphEvaluator m_graphEvaluator;
+
+	// background characters playing the anim graph, posed under the scheduler's budget but not drawn
+	struct CrowdAgent
+	{
+		explicit CrowdAgent(const AnimGraphRef& program) : m_graph(program) {}
+
+		AnimGraphInstance          m_graph;
+		Vec3                       m_position;
+		std::vector<TransformQuat> m_pose;
+		int                        m_task = -1;
+	};
+	std::vector<CrowdAgent> m_crowd;
+	AnimScheduler m_animScheduler;
+	int m_appliedModelVersion = 0;
+	SkeletonRef m_skeleton; // pose and baker point into it, held until the next model is applied
 	mutable Pose* m_pose = nullptr;
-	std::vector<VertexBuffer*> m_vbos;
-	IndexBuffer* m_ibo = nullptr;
+	mutable PoseBaker m_baker;
+
+	// lods picked by projected size every frame unless forced from the console
+	int m_forcedLod = -1;
+	mutable int m_lod = 0;
+	mutable float m_screenSize = 1.0f;
+
+	// background loads, cancelled requests are kept until their worker exits
+	// a cached model is held here while only its animation is loading
+	AsyncLoadRequest* m_pendingLoad = nullptr;
+	ResourceHandle<ModelResource> m_pendingModel;
+	std::vector<AsyncLoadRequest*> m_retiredLoads;
+
+	// clip transitions, last two output poses feed the inertializer
+	Inertializer m_inertializer;
+	std::vector<TransformQuat> m_poseHistory[2];
+	float m_transitionTime = 0.0f;
+	std::vector<VertexBuffer*> m_drawVbos; // model vbos, position and normal swapped for our own when morphing
+
+	// blend shapes, applied on cpu before gpu skinning into per scene buffers
+	MorphTargetSetRef m_morphs; // the model's, shared with every scene showing it
+	MorphApplyState m_morphState;
+	VertexBuffer* m_morphVbos[2] = {};
+	std::vector<float> m_morphWeights;
+	std::vector<Vec3> m_morphPositions;
+	std::vector<Vec3> m_morphNormals;
+
+	// far crowd tier preview, pre-skinned positions and normals go through the morph buffers over the bind pose
+	VertexAnimation* m_vertexAnimation = nullptr;
 
 	BoneId m_highlightBone = 0;
 	Vec3 m_effector;
@@ -0,0 +1,100 @@
+#include "SkeletonAsset.hpp"
+#include "AnimUtils.hpp"
+#include "AssetCache.hpp"
+
+#include "Engine/Core/DevConsole.hpp"
+#include "Engine/Core/StringUtils.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+std::mutex g_skeletonMutex;
+std::unordered_map<uint64_t, std::weak_ptr<const SkeletonAsset>> g_skeletons;
+int g_skeletonAcquireCount = 0;
+int g_skeletonShareCount   = 0;
+
+SkeletonAsset::SkeletonAsset(const Skeleton& skeleton)
+	: m_skeleton(skeleton)
+{
+	int boneCount = (int)m_skeleton.size();
+	Pose bindPose = m_skeleton.GetPose();
+	m_bindPose = bindPose.m_boneLocalPose;
+	m_hash = HashSkeleton(m_skeleton);
+	m_contentHash = HashBytes(m_bindPose.data(), m_bindPose.size() * sizeof(TransformQuat), m_hash);
+
+	m_parents.assign(boneCount, INVALID_BONE_ID);
+	for (auto& bone : m_skeleton)
+		m_parents[bone.m_id] = bone.m_parentId;
+
+	std::vector<int> depth(boneCount, 0);
+	for (int boneIdx = 0; boneIdx < boneCount; boneIdx++)
+	{
+		for (BoneId parent = m_parents[boneIdx]; parent != INVALID_BONE_ID; parent = m_parents[parent])
+			depth[boneIdx]++;
+		m_bakeOrder.push_back((BoneId)boneIdx);
+	}
+	std::stable_sort(m_bakeOrder.begin(), m_bakeOrder.end(), [&depth](BoneId a, BoneId b) { return depth[a] < depth[b]; });
+
+	bindPose.BakeLocalToComp();
+	m_inverseBindPose.resize(boneCount);
+	for (int boneIdx = 0; boneIdx < boneCount; boneIdx++)
+		m_inverseBindPose[boneIdx] = GetInverseMatrix(GetTransformMatrix(bindPose.m_boneCompPose[boneIdx]));
+
+	m_boneLookup.Build(m_skeleton);
+}
+
+size_t SkeletonAsset::GetBytes() const
+{
+	size_t bytes = sizeof(SkeletonAsset);
+	for (auto& bone : m_skeleton)
+		bytes += sizeof(Bone) + bone.m_name.capacity();
+	bytes += m_bindPose.size() * sizeof(TransformQuat) + (m_parents.size() + m_bakeOrder.size()) * sizeof(BoneId) + m_inverseBindPose.size() * sizeof(Mat4x4);
+
+	// lookup table, about two slots and one hash per bone
+	return bytes + (size_t)GetBoneCount() * 3 * (sizeof(BoneNameHash) + sizeof(BoneId));
+}
+
+SkeletonRef AcquireSkeleton(const Skeleton& skeleton)
+{
+	// built outside the lock, losing a race to an identical rig only wastes the build
+	std::shared_ptr<const SkeletonAsset> built = std::make_shared<const SkeletonAsset>(skeleton);
+
+	std::lock_guard<std::mutex> lock(g_skeletonMutex);
+	g_skeletonAcquireCount++;
+	std::weak_ptr<const SkeletonAsset>& slot = g_skeletons[built->m_contentHash];
+	if (SkeletonRef shared = slot.lock())
+	{
+		g_skeletonShareCount++;
+		return shared;
+	}
+	slot = built;
+
+	// drop entries whose last user is gone
+	for (auto iter = g_skeletons.begin(); iter != g_skeletons.end();)
+	{
+		if (iter->second.expired())
+			iter = g_skeletons.erase(iter);
+		else
+			++iter;
+	}
+	return built;
+}
+
+void PrintSkeletonStats()
+{
+	std::lock_guard<std::mutex> lock(g_skeletonMutex);
+	size_t bytes = 0;
+	int liveCount = 0;
+	for (auto& pair : g_skeletons)
+	{
+		if (SkeletonRef skeleton = pair.second.lock())
+		{
+			g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("  skeleton %016llx: %d bones, %d users, %d KB", (unsigned long long)pair.first,
+				skeleton->GetBoneCount(), (int)skeleton.use_count() - 1, (int)(skeleton->GetBytes() / 1024)));
+			bytes += skeleton->GetBytes();
+			liveCount++;
+		}
+	}
+	g_theConsole->AddLine(DevConsole::LOG_INFO, Stringf("%d skeletons, %d KB, %d of %d loads shared an existing rig", liveCount, (int)(bytes / 1024), g_skeletonShareCount, g_skeletonAcquireCount));
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "BoneNames.hpp"
+
+#include "Engine/Animation/Skeleton.hpp"
+#include "Engine/Math/Mat4x4.hpp"
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+// immutable rig plus everything derived from its bind pose, one instance per distinct skeleton
+// models, clips and retarget maps hold a reference, scenes only own their mutable pose arrays
+class SkeletonAsset
+{
+public:
+	explicit SkeletonAsset(const Skeleton& skeleton);
+	SkeletonAsset(const SkeletonAsset& copyFrom) = delete;
+
+	int    GetBoneCount() const { return (int)m_parents.size(); }
+	size_t GetBytes() const;
+
+public:
+	Skeleton                   m_skeleton;
+	uint64_t                   m_hash        = 0; // names and parents, what clips are bound against
+	uint64_t                   m_contentHash = 0; // plus bind transforms, identity in the registry
+	std::vector<TransformQuat> m_bindPose;        // local, copied over the pose every frame before sampling
+	std::vector<BoneId>        m_parents;
+	std::vector<BoneId>        m_bakeOrder;       // parents before children
+	std::vector<Mat4x4>        m_inverseBindPose; // skinning matrix = comp * inverse bind comp
+	BoneLookup                 m_boneLookup;
+};
+
+// loads run on worker threads, so references are atomically counted rather than resource handles
+typedef std::shared_ptr<const SkeletonAsset> SkeletonRef;
+
+// returns the registered skeleton with the same content, or registers a new one, safe on any thread
+// the registry only holds weak references, a rig goes away with the last model or clip using it
+SkeletonRef AcquireSkeleton(const Skeleton& skeleton);
+
+void PrintSkeletonStats();
@@ -0,0 +1,173 @@
+#include "VertexAnimation.hpp"
+#include "AnimClip.hpp"
+
+#include "AnimUtils.hpp"
+
+#include "Engine/Animation/SkeletalMesh.hpp"
+#include "Engine/Core/ByteBuffer.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+constexpr float QUANTIZE_MAX_U16 = 65535.0f;
+constexpr float QUANTIZE_MAX_S8  = 127.0f;
+
+unsigned short EncodeOctahedralNormal(const Vec3& normal)
+{
+	float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (l1 == 0.0f)
+		return 0;
+
+	float u = normal.x / l1;
+	float v = normal.y / l1;
+	if (normal.z < 0.0f)
+	{
+		float foldU = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float foldV = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = foldU;
+		v = foldV;
+	}
+
+	signed char qu = (signed char)roundf(u * QUANTIZE_MAX_S8);
+	signed char qv = (signed char)roundf(v * QUANTIZE_MAX_S8);
+	return (unsigned short)((unsigned char)qu | ((unsigned char)qv << 8));
+}
+
+Vec3 DecodeOctahedralNormal(unsigned short packed)
+{
+	float u = (float)(signed char)(packed & 0xFF) / QUANTIZE_MAX_S8;
+	float v = (float)(signed char)(packed >> 8) / QUANTIZE_MAX_S8;
+	float z = 1.0f - fabsf(u) - fabsf(v);
+	if (z < 0.0f)
+	{
+		float unfoldU = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		float unfoldV = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = unfoldU;
+		v = unfoldV;
+	}
+	return Vec3(u, v, z);
+}
+
+void VertexAnimation::BakeFrom(const SkeletalMesh& mesh, const AnimClip& clip, float tps)
+{
+	m_name = clip.m_name + "_vat";
+	m_tps = tps;
+	m_duration = clip.m_duration;
+	m_frameCount = (int)floorf(m_duration * m_tps) + 1;
+	m_vertexCount = (int)mesh.m_vertices.size();
+
+	std::vector<Vec3> skinnedPositions;
+	std::vector<Vec3> skinnedNormals;
+	skinnedPositions.resize((size_t)m_frameCount * m_vertexCount);
+	skinnedNormals.resize((size_t)m_frameCount * m_vertexCount);
+
+	// every frame in one sweep over the clip's tracks
+	std::vector<float> times(m_frameCount);
+	for (int frameIdx = 0; frameIdx < m_frameCount; frameIdx++)
+		times[frameIdx] = (float)frameIdx / m_tps;
+	std::vector<TransformQuat> localPoses((size_t)m_frameCount * clip.m_boneCount);
+	clip.SampleBatch(times.data(), m_frameCount, localPoses.data());
+
+	// play the clip through the same skinning path the shader uses
+	Pose pose = mesh.m_skeleton.GetPose();
+	for (int frameIdx = 0; frameIdx < m_frameCount; frameIdx++)
+	{
+		std::copy_n(localPoses.begin() + (size_t)frameIdx * clip.m_boneCount, clip.m_boneCount, pose.m_boneLocalPose.begin());
+		pose.BakeLocalToComp();
+		pose.BakeFromComp();
+
+		size_t frameOffset = (size_t)frameIdx * m_vertexCount;
+		SkinVertices(mesh, pose, mesh.m_vertices.data(), mesh.m_normals.data(), &skinnedPositions[frameOffset], &skinnedNormals[frameOffset]);
+	}
+
+	m_bounds = AABB3(Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	for (const Vec3& pos : skinnedPositions)
+	{
+		m_bounds.m_mins = Vec3(fminf(m_bounds.m_mins.x, pos.x), fminf(m_bounds.m_mins.y, pos.y), fminf(m_bounds.m_mins.z, pos.z));
+		m_bounds.m_maxs = Vec3(fmaxf(m_bounds.m_maxs.x, pos.x), fmaxf(m_bounds.m_maxs.y, pos.y), fmaxf(m_bounds.m_maxs.z, pos.z));
+	}
+
+	Vec3 extent = m_bounds.m_maxs - m_bounds.m_mins;
+	Vec3 scale = Vec3(extent.x > 0.0f ? QUANTIZE_MAX_U16 / extent.x : 0.0f,
+	                  extent.y > 0.0f ? QUANTIZE_MAX_U16 / extent.y : 0.0f,
+	                  extent.z > 0.0f ? QUANTIZE_MAX_U16 / extent.z : 0.0f);
+
+	m_positions.resize(skinnedPositions.size() * 3);
+	m_normals.resize(skinnedNormals.size());
+	for (size_t idx = 0; idx < skinnedPositions.size(); idx++)
+	{
+		Vec3 local = skinnedPositions[idx] - m_bounds.m_mins;
+		m_positions[idx * 3 + 0] = (unsigned short)roundf(local.x * scale.x);
+		m_positions[idx * 3 + 1] = (unsigned short)roundf(local.y * scale.y);
+		m_positions[idx * 3 + 2] = (unsigned short)roundf(local.z * scale.z);
+		m_normals[idx] = EncodeOctahedralNormal(skinnedNormals[idx]);
+	}
+}
+
+void VertexAnimation::Sample(float time, Vec3* outPositions, Vec3* outNormals) const
+{
+	if (m_frameCount == 0)
+		return;
+
+	float localTime = m_duration > 0.0f ? fmodf(time, m_duration) : 0.0f;
+	if (localTime < 0.0f)
+		localTime += m_duration;
+
+	float framePos = localTime * m_tps;
+	int frame0 = (int)framePos < m_frameCount ? (int)framePos : m_frameCount - 1;
+	int frame1 = frame0 + 1 < m_frameCount ? frame0 + 1 : frame0;
+	float alpha = framePos - (float)frame0;
+
+	Vec3 dequant = (m_bounds.m_maxs - m_bounds.m_mins) / QUANTIZE_MAX_U16;
+	const unsigned short* pos0 = &m_positions[(size_t)frame0 * m_vertexCount * 3];
+	const unsigned short* pos1 = &m_positions[(size_t)frame1 * m_vertexCount * 3];
+	const unsigned short* nrm0 = &m_normals[(size_t)frame0 * m_vertexCount];
+	const unsigned short* nrm1 = &m_normals[(size_t)frame1 * m_vertexCount];
+
+	for (int vertIdx = 0; vertIdx < m_vertexCount; vertIdx++)
+	{
+		const unsigned short* p0 = &pos0[vertIdx * 3];
+		const unsigned short* p1 = &pos1[vertIdx * 3];
+		outPositions[vertIdx] = Vec3(
+			m_bounds.m_mins.x + Lerp((float)p0[0], (float)p1[0], alpha) * dequant.x,
+			m_bounds.m_mins.y + Lerp((float)p0[1], (float)p1[1], alpha) * dequant.y,
+			m_bounds.m_mins.z + Lerp((float)p0[2], (float)p1[2], alpha) * dequant.z);
+
+		Vec3 n0 = DecodeOctahedralNormal(nrm0[vertIdx]);
+		Vec3 n1 = DecodeOctahedralNormal(nrm1[vertIdx]);
+		outNormals[vertIdx] = (n0 + (n1 - n0) * alpha).GetNormalized();
+	}
+}
+
+void VertexAnimation::WriteBytes(ByteBuffer* buffer) const
+{
+	buffer->WriteString(m_name);
+	buffer->Write(m_tps);
+	buffer->Write(m_duration);
+	buffer->Write(m_frameCount);
+	buffer->Write(m_vertexCount);
+	buffer->Write(m_bounds);
+	buffer->Write(m_positions.size(), m_positions.data());
+	buffer->Write(m_normals.size(), m_normals.data());
+}
+
+void VertexAnimation::ReadBytes(ByteBuffer* buffer)
+{
+	m_name = buffer->ReadString();
+	buffer->Read(m_tps);
+	buffer->Read(m_duration);
+	buffer->Read(m_frameCount);
+	buffer->Read(m_vertexCount);
+	buffer->Read(m_bounds);
+	m_positions.resize((size_t)m_frameCount * m_vertexCount * 3);
+	m_normals.resize((size_t)m_frameCount * m_vertexCount);
+	buffer->Read(m_positions.size(), m_positions.data());
+	buffer->Read(m_normals.size(), m_normals.data());
+}
+
+size_t VertexAnimation::GetFrameBytes() const
+{
+	return (size_t)m_vertexCount * (sizeof(unsigned short) * 3 + sizeof(unsigned short));
+}
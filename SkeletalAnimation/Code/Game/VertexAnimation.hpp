@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Engine/Math/AABB3.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <string>
+#include <vector>
+
+class AnimClip;
+class ByteBuffer;
+class SkeletalMesh;
+
+// pre-skinned vertex animation for far crowd rendering, no pose evaluation at runtime
+// positions are 16 bit per axis inside m_bounds, normals are 8 bit octahedral pairs
+class VertexAnimation
+{
+public:
+	void BakeFrom(const SkeletalMesh& mesh, const AnimClip& clip, float tps);
+	void Sample(float time, Vec3* outPositions, Vec3* outNormals) const;
+
+	void WriteBytes(ByteBuffer* buffer) const;
+	void ReadBytes(ByteBuffer* buffer);
+
+	size_t GetFrameBytes() const;
+
+public:
+	std::string                 m_name;
+	float                       m_tps         = 30.0f;
+	float                       m_duration    = 0.0f;
+	int                         m_frameCount  = 0;
+	int                         m_vertexCount = 0;
+	AABB3                       m_bounds;
+
+	std::vector<unsigned short> m_positions; // [frame][vertex][xyz]
+	std::vector<unsigned short> m_normals;   // [frame][vertex]
+};